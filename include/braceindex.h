@@ -0,0 +1,318 @@
+#ifndef BRACEINDEX_H
+#define BRACEINDEX_H
+
+#include <QByteArray>
+#include <QVector>
+
+class Buffer;
+
+/**
+ * An index of the brackets of a buffer, which finds matching brackets and
+ * enclosing blocks in logarithmic time. The brackets of each kind are kept in
+ * a treap ordered by position, a balanced binary tree whose nodes know the
+ * nesting depth change of their subtree and the minimum depth before its
+ * brackets. Brackets inside comments and strings, according to the lexer
+ * styles of the language, are ignored.
+ *
+ * The index is maintained from the modification notifications of the buffer.
+ * Inserting or deleting text splits the trees at the modification, offsets
+ * the positions of the brackets after it through a pending addition to the
+ * root of the split tree, and merges the trees back, in logarithmic time.
+ * When brackets move in or out of comments and strings, only the nodes above
+ * them are updated.
+ */
+class BraceIndex {
+public:
+    /**
+     * The depth of a bracket, used for bracket pair colorization.
+     */
+    struct Level {
+        /** The position of the bracket. */
+        qint64 position;
+
+        /** The nesting depth of the bracket, 0 for the outermost pairs. */
+        int depth;
+    };
+
+    /**
+     * Creates an empty index for a buffer.
+     *
+     * @param buffer The buffer.
+     */
+    explicit BraceIndex(Buffer *buffer);
+
+    /**
+     * Discards the index, it is built again from the buffer when needed.
+     */
+    void invalidate();
+
+    /**
+     * Updates the index after text has been inserted into the buffer.
+     *
+     * @param position The position of the inserted text.
+     * @param text The inserted text.
+     */
+    void textInserted(qint64 position, const QByteArray &text);
+
+    /**
+     * Updates the index after text has been deleted from the buffer.
+     *
+     * @param position The position of the deleted text.
+     * @param length The length of the deleted text.
+     */
+    void textDeleted(qint64 position, qint64 length);
+
+    /**
+     * Updates the ignored brackets after the styles of a range have changed.
+     *
+     * @param position The start of the range.
+     * @param length The length of the range.
+     */
+    void styleChanged(qint64 position, qint64 length);
+
+    /**
+     * Finds the bracket that matches the bracket at a position.
+     *
+     * @param position The position of the bracket.
+     * @param match Output parameter, set to the position of the matching
+     * bracket, or -1 if the bracket is not matched.
+     * @return false if there is no indexed bracket at the position, for
+     * example because it is inside a comment.
+     */
+    bool findMatch(qint64 position, qint64 *match);
+
+    /**
+     * Finds the opening bracket of the innermost block that encloses a
+     * position.
+     *
+     * @param position The position.
+     * @return The position of the opening bracket, or -1 if the position is
+     * not inside a block.
+     */
+    qint64 enclosingBrace(qint64 position);
+
+    /**
+     * Returns the depth of the brackets in a range.
+     *
+     * @param start The start of the range.
+     * @param end The end of the range.
+     * @return The depth of each bracket in the range, sorted by position for
+     * each kind of bracket.
+     */
+    QVector<Level> levels(qint64 start, qint64 end);
+
+    /**
+     * Returns a number that changes every time the brackets change.
+     *
+     * @return The revision of the index.
+     */
+    int revision() const;
+
+    /**
+     * Returns the kind of a bracket character.
+     *
+     * @param c The character.
+     * @return The index of the kind, or -1 if the character is not a bracket.
+     */
+    static int kindOf(char c);
+
+private:
+    /**
+     * A bracket, the node of a treap.
+     */
+    struct Node {
+        /** The position, to which the pending offsets of the ancestors must be added. */
+        qint64 position;
+
+        /** The pending offset of the positions of the descendants. */
+        qint64 offset;
+
+        /** The left child, or -1. */
+        int left;
+
+        /** The right child, or -1. */
+        int right;
+
+        /** The priority, higher than the ones of the descendants. */
+        quint32 priority;
+
+        /** The Open and Ignored flags. */
+        quint8 flags;
+
+        /** The number of brackets of the subtree. */
+        int size;
+
+        /** The depth change over the subtree. */
+        int depthChange;
+
+        /** The minimum depth before a bracket of the subtree, relative to its first bracket. */
+        int minDepth;
+    };
+
+    /**
+     * The brackets of a single kind.
+     */
+    struct Brackets {
+        Brackets();
+
+        /** The nodes, including the free ones. */
+        QVector<Node> nodes;
+
+        /** The free nodes. */
+        QVector<int> freeNodes;
+
+        /** The root of the treap, or -1 if there are no brackets. */
+        int root;
+
+        /** The state of the generator of the priorities. */
+        quint32 seed;
+    };
+
+    /** The flags of a bracket. */
+    enum Flags {
+        Open = 1, Ignored = 2
+    };
+
+    /** The number of bracket kinds: (), [] and {}. */
+    static const int KindCount = 3;
+
+    /**
+     * Scans the whole buffer.
+     */
+    void build();
+
+    /**
+     * Makes sure that the index is built.
+     */
+    void prepare();
+
+    /**
+     * Returns true if a bracket at a position is inside a comment or a string.
+     */
+    bool isIgnoredAt(qint64 position) const;
+
+    /**
+     * Updates the Ignored flag of the brackets of a subtree in a range.
+     *
+     * @return true if a flag has changed.
+     */
+    bool updateIgnored(Brackets &brackets, int node, qint64 start, qint64 end);
+
+    /**
+     * Adds a bracket node, which is not in the tree yet.
+     */
+    static int newNode(Brackets &brackets, qint64 position, quint8 flags);
+
+    /**
+     * Frees the nodes of a subtree.
+     */
+    static void freeSubtree(Brackets &brackets, int node);
+
+    /**
+     * Returns the depth change of a bracket.
+     */
+    static int depthChange(quint8 flags);
+
+    /**
+     * Computes the size and the depths of a node from its children.
+     */
+    static void update(Brackets &brackets, int node);
+
+    /**
+     * Computes the sizes and the depths of a whole subtree.
+     */
+    static void updateSubtree(Brackets &brackets, int node);
+
+    /**
+     * Offsets the positions of a subtree.
+     */
+    static void offset(Brackets &brackets, int node, qint64 delta);
+
+    /**
+     * Applies the pending offset of a node to its children.
+     */
+    static void pushDown(Brackets &brackets, int node);
+
+    /**
+     * Splits a subtree into the brackets before a position and the others.
+     */
+    static void split(Brackets &brackets, int node, qint64 position, int *left, int *right);
+
+    /**
+     * Merges two subtrees, the brackets of the left one come first.
+     *
+     * @return The root of the merged tree.
+     */
+    static int merge(Brackets &brackets, int left, int right);
+
+    /**
+     * Returns the number of brackets.
+     */
+    static int count(const Brackets &brackets);
+
+    /**
+     * Returns the node of a bracket, and its position.
+     */
+    static int nodeAt(const Brackets &brackets, int index, qint64 *position);
+
+    /**
+     * Returns the position of a bracket.
+     */
+    static qint64 positionAt(const Brackets &brackets, int index);
+
+    /**
+     * Returns the index of the first bracket at or after a position.
+     */
+    static int lowerBound(const Brackets &brackets, qint64 position);
+
+    /**
+     * Returns the depth before a bracket, or the final depth for the index
+     * after the last bracket.
+     */
+    static int depthAt(const Brackets &brackets, int index);
+
+    /**
+     * Returns the first index at or after from whose depth is at most a
+     * value, including the index after the last bracket.
+     */
+    static int firstAtMost(const Brackets &brackets, int from, int value);
+
+    /**
+     * Returns the first index of a subtree at or after from whose depth is at
+     * most a value. The subtree starts at an index and a depth.
+     */
+    static int firstAtMost(const Brackets &brackets, int node, int index, int depth, int from, int value);
+
+    /**
+     * Returns the last index before a limit whose depth is at most a value.
+     */
+    static int lastAtMost(const Brackets &brackets, int before, int value);
+
+    /**
+     * Returns the last index of a subtree before a limit whose depth is at
+     * most a value. The subtree starts at an index and a depth.
+     */
+    static int lastAtMost(const Brackets &brackets, int node, int index, int depth, int before, int value);
+
+    /**
+     * Adds the levels of the brackets of a subtree in a range. The subtree
+     * starts at a depth, its positions are offset by the pending offsets of
+     * its ancestors.
+     */
+    static void collectLevels(const Brackets &brackets, int node, qint64 offset, int depth, qint64 start,
+            qint64 end, QVector<Level> *levels);
+
+    /** The buffer. */
+    Buffer *m_buffer;
+
+    /** true if the index has been built. */
+    bool m_valid;
+
+    /** The revision, incremented on every change of the brackets. */
+    int m_revision;
+
+    /** The brackets of each kind. */
+    Brackets m_brackets[KindCount];
+};
+
+#endif // BRACEINDEX_H
@@ -4,15 +4,22 @@
 #include "colorscheme.h"
 #include "styleinfo.h"
 #include "encoding.h"
+#include "memoryusage.h"
+#include "textsearch.h"
 
 #include <ScintillaEdit.h>
 
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QList>
+#include <QPair>
 #include <QUrl>
 #include <QWidget>
 
+class BraceIndex;
+class Document;
 class Language;
+class QTimer;
 
 class Buffer : public ScintillaEdit {
     Q_OBJECT
@@ -54,7 +61,7 @@ public:
     };
 
     enum Indicators {
-        MatchBrace = INDIC_CONTAINER
+        MatchBrace = INDIC_CONTAINER, BracePair
     };
 
     /**
@@ -74,6 +81,111 @@ public:
      */
     void clear();
 
+    /**
+     * Returns the document shown in the buffer.
+     *
+     * @return The document.
+     */
+    Document *document() const;
+
+    /**
+     * Creates an empty document, which is shown when it is passed to
+     * setDocument().
+     *
+     * @return The document, owned by the buffer.
+     */
+    Document *newDocument();
+
+    /**
+     * Shows another document in the buffer. The state of the document that was
+     * shown, such as the selection, the scroll position and the folds, is kept
+     * so that it is restored when it is shown again. Switching documents does
+     * not depend on their size.
+     *
+     * @param document The document, created by newDocument().
+     */
+    void setDocument(Document *document);
+
+    /**
+     * Deletes a document, with its text and undo history.
+     *
+     * @param document The document, which must not be shown.
+     */
+    void deleteDocument(Document *document);
+
+    /**
+     * Shows the documents of another buffer, as a second view of them. The
+     * text, styles, markers, undo history and lexer are shared, so that edits
+     * show up in both views at once and the text is lexed once. The file,
+     * encoding and language follow the other buffer, and so does the
+     * document when the other buffer switches to another one.
+     *
+     * @param buffer The buffer whose documents are shown.
+     */
+    void shareDocument(Buffer *buffer);
+
+    /**
+     * Returns the memory used by each document of the buffer.
+     *
+     * @return The usage of each document.
+     */
+    QList<MemoryUsage> memoryUsage();
+
+    /**
+     * Returns all the buffers that exist.
+     *
+     * @return An iterator over the buffers.
+     */
+    static QListIterator<Buffer*> allBuffers();
+
+    /**
+     * Returns true if a document has been modified since it was last saved.
+     *
+     * @param document The document.
+     * @return true if the document has been modified.
+     */
+    bool isModified(Document *document) const;
+
+    /**
+     * Returns true if the shown document has been modified since it was last
+     * saved. Unlike modify(), it takes into account the changes whose undo
+     * steps have been moved out of Scintilla.
+     *
+     * @return true if the shown document has been modified.
+     */
+    bool isModified() const;
+
+    /**
+     * Writes the undo history of a document to the cache, so that it can be
+     * undone the next time the file is opened. It does nothing unless the
+     * undo history is kept, and the document is the unmodified text of a
+     * file.
+     *
+     * @param document The document, which is about to be closed.
+     */
+    void saveUndoHistory(Document *document);
+
+    /**
+     * Undoes the last step. Once Scintilla cannot undo any more, it undoes the
+     * steps moved out of it when the undo history went over its memory
+     * budget, which cannot be redone.
+     */
+    void undo();
+
+    /**
+     * Returns true if undo() has a step to undo, either in Scintilla or in the
+     * stored undo history, including the history saved in a previous session.
+     *
+     * @return true if there is a step to undo.
+     */
+    bool isUndoAvailable() const;
+
+    /**
+     * Empties the undo buffer of Scintilla along with the stored undo history
+     * of the shown document.
+     */
+    void emptyUndoHistory();
+
     /**
      * Reads the contents of a file into the buffer.
      *
@@ -82,6 +194,26 @@ public:
      */
     bool open(const QString& fileName);
 
+    /**
+     * Reads and decodes the contents of a file, without touching any buffer.
+     * It can be called from any thread, so that files are read in parallel.
+     *
+     * @param fileName The name of the file.
+     * @param encoding The system name of the encoding of the file.
+     * @param ok Output parameter, set to true if the file has been read.
+     * @return The contents of the file, in UTF-8.
+     */
+    static QByteArray readFile(const QString& fileName, const QByteArray& encoding, bool *ok);
+
+    /**
+     * Replaces the contents of the buffer with the contents of a file, as read
+     * by readFile().
+     *
+     * @param fileName The name of the file.
+     * @param content The contents of the file, in UTF-8.
+     */
+    void setFileContent(const QString& fileName, const QByteArray& content);
+
     /**
      * Saves the contents of the buffer to a file.
      *
@@ -258,6 +390,44 @@ public:
      */
     bool find(const QString& findText, int flags, bool forward, bool wrap, bool *searchWrapped);
 
+    /**
+     * Finds all the occurances of the provided text. Searches that cannot span
+     * lines are performed in parallel over slices of the document.
+     *
+     * @param findText The text to find.
+     * @param flags The search flags.
+     * @return The matches, in document order.
+     */
+    QVector<TextSearch::Match> findAll(const QString& findText, int flags);
+
+    /**
+     * Selects all the occurances of the provided text, using multiple selections.
+     * Typing edits all the matches until the selection is reduced to one.
+     *
+     * @param findText The text to find.
+     * @param flags The search flags.
+     * @return The number of matches.
+     */
+    int selectMatches(const QString& findText, int flags);
+
+    /**
+     * Replaces all the occurances of the provided text, as a single undo action.
+     *
+     * @param findText The text to find.
+     * @param replaceText The replacement text.
+     * @param flags The search flags.
+     * @return The number of replacements.
+     */
+    int replaceAll(const QString& findText, const QString& replaceText, int flags);
+
+    /**
+     * Returns a counter that is incremented every time text is inserted into
+     * or deleted from the buffer.
+     *
+     * @return The modification counter.
+     */
+    quint64 modificationCounter() const;
+
     /**
      * Toggles a bookmark. If the line number is less than zero, then the
      * bookmark is toggled in the current line.
@@ -273,6 +443,26 @@ public:
      */
     void gotoBookmark(bool next);
 
+    /**
+     * Moves the caret to the opening brace of the innermost block that
+     * encloses it. Calling it again moves to the enclosing blocks in turn.
+     */
+    void gotoEnclosingBrace();
+
+    /**
+     * Returns true if the bracket pairs are colored by nesting level.
+     *
+     * @return true if the bracket pairs are colored.
+     */
+    bool bracePairColorization() const;
+
+    /**
+     * Enables or disables the coloring of the bracket pairs by nesting level.
+     *
+     * @param bracePairColorization if true, color the bracket pairs.
+     */
+    void setBracePairColorization(bool bracePairColorization);
+
     /**
      * Overriden in order to customize the default implementation in the case when urls are dropped into the editor.
      *
@@ -280,6 +470,15 @@ public:
      */
     virtual void dropEvent(QDropEvent *event);
 
+protected:
+    /**
+     * Overriden in order to undo the steps moved out of Scintilla with the
+     * undo key too.
+     *
+     * @param event The key event.
+     */
+    virtual void keyPressEvent(QKeyEvent *event);
+
 signals:
     /**
      * Emitted when the underlying file for this buffer has changed.
@@ -302,6 +501,36 @@ signals:
      */
     void languageChanged(const Language *language);
 
+    /**
+     * Emitted when another document is shown in the buffer, after the file,
+     * encoding and language signals of the document.
+     */
+    void documentChanged();
+
+    /**
+     * Emitted when the shown document becomes modified or unmodified, as
+     * returned by isModified().
+     *
+     * @param modified true if the document is modified.
+     */
+    void modificationChanged(bool modified);
+
+    /**
+     * Emitted when the text of a hibernated document starts and finishes
+     * being read back. The buffer is read only meanwhile.
+     *
+     * @param restoring true if the document is being restored.
+     */
+    void restoringChanged(bool restoring);
+
+    /**
+     * Emitted when the text of a hibernated document cannot be read back. The
+     * document stays hibernated and read-only, and it cannot be saved.
+     *
+     * @param fileName The name of the file that cannot be read.
+     */
+    void restoreFailed(const QString &fileName);
+
     /**
      * Called when a list of URLs have been dropped into the editor.
      *
@@ -334,12 +563,173 @@ public slots:
      */
     void onMarginClicked(int position, int modifiers, int margin);
 
+    /**
+     * Called when the document has been modified.
+     *
+     * @param type The type of the modification.
+     */
+    void onModified(int type, int position, int length, int linesAdded, const QByteArray &text, int line,
+            int foldNow, int foldPrev);
+
+    /**
+     * Called when the definition of a language has been read again, in
+     * order to apply it again if the buffer uses it.
+     *
+     * @param language The language.
+     */
+    void onLanguageReloaded(const Language *language);
+
+    /**
+     * Called when the definition of a color scheme has been read again, in
+     * order to apply it again if the buffer uses it.
+     *
+     * @param colorScheme The color scheme.
+     */
+    void onColorSchemeReloaded(const ColorScheme *colorScheme);
+
+private slots:
+    /**
+     * Called when the buffer whose documents are shown has switched to
+     * another document, in order to show it too.
+     */
+    void onSourceDocumentChanged();
+
+    /**
+     * Called when the file, encoding or language of the buffer whose
+     * documents are shown has changed.
+     */
+    void onSourceStateChanged();
+
+    /**
+     * Called when a setting has been changed, in order to apply it to a buffer
+     * that shows the documents of another one.
+     */
+    void onConfigurationChanged();
+
+    /**
+     * Called when Scintilla reaches or leaves the save point.
+     *
+     * @param dirty true if Scintilla has left the save point.
+     */
+    void onSavePointChanged(bool dirty);
+
+    /**
+     * Moves the undo history of the shown document out of Scintilla, if it
+     * is over the memory budget.
+     */
+    void compactUndoHistory();
+
+    /**
+     * Hibernates the documents that have not been shown for longer than the
+     * hibernation timeout.
+     */
+    void hibernateIdleDocuments();
+
+    /**
+     * Called when the text of the shown document has been read back.
+     */
+    void onRestoreFinished();
+
 private:
     /**
      * Loads the editor preferences from the configuration.
      */
     void loadConfiguration();
 
+    /**
+     * Sets up the lexer, the keywords and the styles of the language.
+     */
+    void applyLanguage();
+
+    /**
+     * Applies the settings of the buffer that Scintilla keeps in the document,
+     * when a new document is first shown.
+     */
+    void setUpDocument();
+
+    /**
+     * Restores the folds, the selection and the scroll position of the shown
+     * document.
+     */
+    void restoreViewState();
+
+    /**
+     * Loads the undo history saved in a previous session for the file of a
+     * document, the first time it is needed. The saved history is discarded if
+     * the file has changed since.
+     *
+     * @param document The document.
+     */
+    void loadUndoHistory(Document *document);
+
+    /**
+     * Returns the text of a document, which does not need to be shown.
+     *
+     * @param document The document.
+     * @param ok Output parameter, false if the text of a hibernated document
+     * cannot be read back.
+     * @return The text, in UTF-8.
+     */
+    QByteArray documentText(Document *document, bool *ok);
+
+    /**
+     * Returns the view used to read the documents that are not shown,
+     * creating it the first time.
+     *
+     * @return The view.
+     */
+    ScintillaEdit *hiddenView();
+
+    /**
+     * Releases the Scintilla document of a document that is not shown, after
+     * keeping what is needed to restore it: the text if it cannot be read
+     * back from the file, the markers and the undo steps.
+     *
+     * @param document The document.
+     */
+    void hibernate(Document *document);
+
+    /**
+     * Starts reading back the text of the shown document, which has been
+     * hibernated.
+     */
+    void startRestore();
+
+    /**
+     * Waits for the text of the shown document to be read back, and puts it
+     * back in the buffer with the markers and the state of the view.
+     */
+    void completeRestore();
+
+    /**
+     * Forgets what has been kept to restore a hibernated document.
+     *
+     * @param document The document.
+     */
+    void endHibernation(Document *document);
+
+    /**
+     * Returns the bytes of the undo history of a document that count against
+     * the memory budget: the history kept by Scintilla, its mirror and the
+     * compressed steps in memory.
+     *
+     * @param document The document.
+     * @return The bytes of the undo history in memory.
+     */
+    static qint64 undoMemoryBytes(Document *document);
+
+    /**
+     * Reads back the text of a hibernated document. It runs on the thread pool.
+     *
+     * @param fileName The name of the file, read if there is no compressed text.
+     * @param encoding The system name of the encoding of the file.
+     * @param compressed The compressed text, or empty.
+     * @param spillFileName The name of the file with the compressed text, or empty.
+     * @return true and the text, in UTF-8, or false if it cannot be read.
+     */
+    static QPair<bool, QByteArray> readHibernated(const QString &fileName, const QByteArray &encoding,
+            const QByteArray &compressed, const QString &spillFileName);
+
     /**
      * Sets the file information of the underlying file.
      *
@@ -368,12 +758,55 @@ private:
     int isBrace(sptr_t character);
 
     /**
-     * Applies the specified style to the buffer.
+     * Applies the specified style to the buffer, sending only the properties
+     * that differ from the style currently applied.
      *
      * @param styleNumber The style number, as defined in the lexer.
      * @param style The style information.
+     * @param previous The style information currently applied.
      */
-    void applyStyle(int styleNumber, const StyleInfo& style);
+    void applyStyle(int styleNumber, const StyleInfo& style, const StyleInfo& previous);
+
+    /**
+     * Counts the lines of the document of a view that have markers.
+     *
+     * @param view The view, this buffer or the hidden view.
+     * @return The number of lines with markers.
+     */
+    static int countMarkers(ScintillaEdit *view);
+
+    /**
+     * Counts the indicator runs of the document of a view.
+     *
+     * @param view The view, this buffer or the hidden view.
+     * @return The number of indicator runs.
+     */
+    static int countIndicators(ScintillaEdit *view);
+
+    /**
+     * Returns the list of all the buffers that exist.
+     */
+    static QList<Buffer*> &buffers();
+
+    /**
+     * Colors the bracket pairs in the visible lines, if the brackets or the
+     * visible lines have changed since the last time.
+     */
+    void colorizeBracePairs();
+
+    /**
+     * Removes the bracket pair colors from the range colored last time.
+     */
+    void clearBracePairColors();
+
+    /** The document shown in the buffer. */
+    Document *m_document;
+
+    /** All the documents of the buffer. */
+    QList<Document*> m_documents;
+
+    /** The buffer whose documents are shown, or null if the buffer shows its own documents. */
+    Buffer *m_source;
 
     /** The underlying file for this buffer. */
     QFileInfo m_fileInfo;
@@ -384,11 +817,51 @@ private:
     /** The language for the buffer. */
     const Language *m_language;
 
+    /** The color scheme currently applied. */
+    const ColorScheme *m_colorScheme;
+
+    /** The style table currently applied, or null if the styles must be cleared. */
+    const StyleTable *m_styleTable;
+
     /** If the the line margin width will be changed automatically in order to accomodate the biggest line number */
     bool m_trackLineWidth;
 
     /** True if the matching brace should be highighted. */
     bool m_braceHighlight;
+
+    /** Incremented every time text is inserted or deleted. */
+    quint64 m_modificationCounter;
+
+    /** The index of the brackets, used for brace matching. */
+    BraceIndex *m_braceIndex;
+
+    /** True if the bracket pairs should be colored by nesting level. */
+    bool m_bracePairColorization;
+
+    /** The number of colors used for the bracket pairs. */
+    int m_bracePairColorCount;
+
+    /** The range of the document where the bracket pairs have been colored. */
+    sptr_t m_colorizedStart;
+    sptr_t m_colorizedEnd;
+
+    /** The revision of the brace index when the bracket pairs were colored. */
+    int m_colorizedRevision;
+
+    /** The modification counter when the bracket pairs were colored. */
+    quint64 m_colorizedModification;
+
+    /** True if the undo history is going to be compacted. */
+    bool m_compactionPending;
+
+    /** Checks for documents to hibernate. */
+    QTimer *m_hibernationTimer;
+
+    /** A view that is never shown, used to read the documents that are not shown, or null. */
+    ScintillaEdit *m_hibernationView;
+
+    /** Reads back the text of the shown document, or null if it is not being restored. */
+    QFutureWatcher<QPair<bool, QByteArray> > *m_restoreWatcher;
 };
 
 #endif // BUFFER_H
@@ -0,0 +1,156 @@
+#ifndef BUILTINTABLES_H
+#define BUILTINTABLES_H
+
+/**
+ * The built-in languages, encodings and color schemes. The tables are
+ * generated at build time from the XML definitions in the resources
+ * directory, so that they are available without parsing anything at startup.
+ * The definitions of the user configuration directory override them.
+ */
+namespace BuiltinTables {
+
+/**
+ * An encoding.
+ */
+struct EncodingEntry {
+    /** The encoding language. */
+    const char *language;
+
+    /** The encoding display name. */
+    const char *displayName;
+
+    /** The encoding system name. */
+    const char *name;
+
+    /** The encoding category. */
+    int category;
+};
+
+/**
+ * A style of a language.
+ */
+struct StyleDescriptionEntry {
+    /** The Scintilla identifier of the style. */
+    int style;
+
+    /** The description of the style. */
+    const char *description;
+
+    /** true if the lexer uses the style for comments or strings. */
+    bool commentOrString;
+};
+
+/**
+ * A language.
+ */
+struct LanguageEntry {
+    /** The language identifier. */
+    const char *id;
+
+    /** The language name. */
+    const char *name;
+
+    /** The lexer for the language. */
+    const char *lexer;
+
+    /** The file patterns, separated by space. */
+    const char *patterns;
+
+    /** The interpreters of the scripts in the language, separated by space. */
+    const char *interpreters;
+
+    /** The keyword sets, indexed by their identifier. */
+    const char *const *keywords;
+
+    /** The number of keyword sets. */
+    int keywordCount;
+
+    /** The styles of the language. */
+    const StyleDescriptionEntry *styles;
+
+    /** The number of styles. */
+    int styleCount;
+};
+
+/**
+ * The style that a color scheme gives to a style of a language.
+ */
+struct StyleEntry {
+    /** The Scintilla identifier of the style. */
+    int style;
+
+    /** The foreground color, in the format expected by Scintilla, or -1. */
+    int foreground;
+
+    /** The background color, in the format expected by Scintilla, or -1. */
+    int background;
+
+    bool bold;
+    bool italic;
+    bool underline;
+    bool eolFilled;
+};
+
+/**
+ * The styles that a color scheme defines for a language.
+ */
+struct LanguageStylesEntry {
+    /** The language identifier. */
+    const char *language;
+
+    /** The styles. */
+    const StyleEntry *styles;
+
+    /** The number of styles. */
+    int styleCount;
+};
+
+/**
+ * A color scheme. The colors are in the format expected by Scintilla, or -1
+ * if they are not set.
+ */
+struct ColorSchemeEntry {
+    /** The name of the color scheme. */
+    const char *name;
+
+    int foreground;
+    int background;
+    int caret;
+    int caretLine;
+    int selection;
+    int whitespace;
+
+    /** The colors of the bracket pairs. */
+    const int *bracePairColors;
+
+    /** The number of bracket pair colors. */
+    int bracePairColorCount;
+
+    /** The styles for each language. */
+    const LanguageStylesEntry *languages;
+
+    /** The number of languages. */
+    int languageCount;
+};
+
+/** The built-in encodings. */
+extern const EncodingEntry encodings[];
+
+/** The number of built-in encodings. */
+extern const int encodingCount;
+
+/** The built-in languages. */
+extern const LanguageEntry languages[];
+
+/** The number of built-in languages. */
+extern const int languageCount;
+
+/** The built-in color schemes. */
+extern const ColorSchemeEntry colorSchemes[];
+
+/** The number of built-in color schemes. */
+extern const int colorSchemeCount;
+
+}
+
+#endif // BUILTINTABLES_H
@@ -7,6 +7,42 @@
 #include <QStringList>
 #include <QXmlStreamReader>
 
+/**
+ * The styles of a color scheme for a language, compiled into a dense table
+ * indexed by the Scintilla style number, so that it can be applied to a
+ * buffer without any lookups.
+ */
+struct StyleTable {
+    /** The number of styles in the table. */
+    static const int StyleCount = 256;
+
+    /**
+     * Creates an empty table.
+     */
+    StyleTable();
+
+    /** The foreground color of the default style, or -1 to keep the current one. */
+    int foreground;
+
+    /** The background color of the default style, or -1 to keep the current one. */
+    int background;
+
+    /** The whitespace foreground color. */
+    int whitespaceForeground;
+
+    /**
+     * true if the whitespace color is set through the lexer whitespace style,
+     * false if it overrides the styles.
+     */
+    bool lexerWhitespace;
+
+    /** true for the styles defined by the color scheme. */
+    bool defined[StyleCount];
+
+    /** The styles, the undefined ones are copied from the default style. */
+    StyleInfo styles[StyleCount];
+};
+
 class ColorScheme {
 public:
     /**
@@ -24,6 +60,35 @@ public:
      */
     static const ColorScheme *getColorScheme(const QString &name);
 
+    /**
+     * Reads the color schemes defined in a file. It can be called from any
+     * thread, the color schemes are not added to the available ones.
+     *
+     * @param fileName The name of the file.
+     * @return The color schemes read by name, which the caller owns. It is
+     * empty if the file cannot be read.
+     */
+    static QHash<QString, ColorScheme*> readColorSchemes(const QString &fileName);
+
+    /**
+     * Adds color schemes to the available ones. A color scheme replaces the
+     * available one with the same name, which is updated in place so that the
+     * pointers to it stay valid. Its style tables are discarded, so the
+     * buffers that use it must apply it again. It must be called from the GUI
+     * thread.
+     *
+     * @param colorSchemes The color schemes by name, as read by
+     * readColorSchemes(). They are owned by the available ones afterwards.
+     * @return The color schemes that have been added or updated.
+     */
+    static QList<const ColorScheme*> update(const QHash<QString, ColorScheme*> &colorSchemes);
+
+    /**
+     * Initializes the available color schemes, if they are not already. They are
+     * otherwise initialized on first use. It can be called from any thread.
+     */
+    static void initialize();
+
     /**
      * Cleans up the static resources.
      */
@@ -73,13 +138,30 @@ public:
      */
     int whitespaceForeground() const;
 
+    /**
+     * Returns the colors of the bracket pairs, one for each nesting level.
+     *
+     * @return The bracket pair colors, possibly empty.
+     */
+    QList<int> bracePairColors() const;
+
     /**
      * Returns the styles for a language.
      *
      * @param lang The language identifier.
      * @return The styles.
      */
-    QHash<int, StyleInfo> stylesForLanguage(const QString& lang) const;
+    const QHash<int, StyleInfo> &stylesForLanguage(const QString& lang) const;
+
+    /**
+     * Returns the style table for a language. The table is compiled the first
+     * time it is requested, and kept for the lifetime of the color scheme.
+     *
+     * @param lang The language identifier, or a null string if the buffer has
+     * no language.
+     * @return The style table.
+     */
+    const StyleTable &styleTable(const QString& lang) const;
 
 private:
     /**
@@ -93,15 +175,31 @@ private:
     ~ColorScheme();
 
     /**
-     * Initializes the available color schemes.
+     * Initializes the available color schemes, the built-in ones and the ones
+     * of the user configuration directory.
      */
     static QHash<QString, ColorScheme*> initializeColorSchemes();
 
     static void processColorSchemeXml(QXmlStreamReader &xml,
             QHash<QString, ColorScheme *> &colorSchemes);
 
-    /** Contains all the color chemes available. */
-    static QHash<QString, ColorScheme*> colorSchemes;
+    /**
+     * Adds color schemes to a hash, replacing the ones with the same name.
+     *
+     * @param schemes The hash.
+     * @param colorSchemes The color schemes to add, owned by the hash
+     * afterwards.
+     * @return The color schemes that have been added or updated.
+     */
+    static QList<const ColorScheme*> merge(QHash<QString, ColorScheme*> &schemes,
+            const QHash<QString, ColorScheme*> &colorSchemes);
+
+    /**
+     * Returns all the color schemes available, initializing them on first use.
+     *
+     * @return The color schemes, by name.
+     */
+    static QHash<QString, ColorScheme*> &colorSchemes();
 
     /** The foreground color. */
     int m_foreground;
@@ -121,8 +219,14 @@ private:
     /** The whitespace foreground color. */
     int m_whitespaceForeground;
 
+    /** The colors of the bracket pairs. */
+    QList<int> m_bracePairColors;
+
     /** The styles for all languages. */
     QHash<QString, QHash<int, StyleInfo> > m_languagesStyles;
+
+    /** The compiled style tables, by language identifier. */
+    mutable QHash<QString, StyleTable*> m_styleTables;
 };
 
 #endif // COLORSCHEME_H
@@ -5,10 +5,23 @@
 #include "language.h"
 #include "styleinfo.h"
 
+#include <QFont>
 #include <QHash>
+#include <QObject>
 #include <QSettings>
+#include <QVariant>
+
+class QTimer;
+
+/**
+ * The application configuration. The settings are read once into a typed
+ * snapshot. Changes update the snapshot immediately and are written back to
+ * the settings in a single batch, shortly after the last change or when the
+ * application quits.
+ */
+class Configuration : public QObject {
+    Q_OBJECT
 
-class Configuration {
 public:
 
     /**
@@ -131,6 +144,20 @@ public:
 
     void setBraceHighlight(bool braceHighlight);
 
+    /**
+     * Returns true if the bracket pairs should be colored by nesting level.
+     *
+     * @return true if the bracket pairs should be colored.
+     */
+    bool bracePairColorization();
+
+    /**
+     * Sets whether the bracket pairs should be colored by nesting level.
+     *
+     * @param bracePairColorization whether the bracket pairs should be colored.
+     */
+    void setBracePairColorization(bool bracePairColorization);
+
     /**
      * Returns the indentation guides mode.
      *
@@ -458,12 +485,153 @@ public:
      */
     void setColorScheme(const QString &name);
 
+    /**
+     * Returns true if the files should be opened as tabs of a single window,
+     * instead of a window for each file.
+     *
+     * @return true if the files should be opened as tabs.
+     */
+    bool tabbedInterface() const;
+
+    /**
+     * Sets whether the files should be opened as tabs of a single window. It
+     * applies to the windows created afterwards.
+     *
+     * @param tabbedInterface true to open the files as tabs.
+     */
+    void setTabbedInterface(bool tabbedInterface);
+
+    /**
+     * Returns the memory that the undo history of a document may use before
+     * its oldest steps are compressed, in megabytes.
+     *
+     * @return The undo memory budget, 0 for no limit.
+     */
+    int undoMemoryBudget() const;
+
+    /**
+     * Sets the memory that the undo history of a document may use before its
+     * oldest steps are compressed, in megabytes.
+     *
+     * @param undoMemoryBudget The undo memory budget, 0 for no limit.
+     */
+    void setUndoMemoryBudget(int undoMemoryBudget);
+
+    /**
+     * Returns the time after which a document that is not shown is
+     * hibernated, in minutes.
+     *
+     * @return The hibernation timeout, 0 to never hibernate documents.
+     */
+    int hibernateTimeout() const;
+
+    /**
+     * Sets the time after which a document that is not shown is hibernated,
+     * in minutes.
+     *
+     * @param hibernateTimeout The hibernation timeout, 0 to never hibernate
+     * documents.
+     */
+    void setHibernateTimeout(int hibernateTimeout);
+
+    /**
+     * Returns true if the undo history of the files is kept when they are
+     * closed, for the next time they are opened.
+     *
+     * @return true if the undo history is kept.
+     */
+    bool persistUndoHistory() const;
+
+    /**
+     * Sets whether the undo history of the files is kept when they are
+     * closed, for the next time they are opened.
+     *
+     * @param persistUndoHistory true to keep the undo history.
+     */
+    void setPersistUndoHistory(bool persistUndoHistory);
+
+public slots:
+    /**
+     * Writes the pending changes to the settings.
+     */
+    void sync();
+
+signals:
+    /**
+     * Emitted when a setting has been changed, so that all the windows can
+     * apply it.
+     *
+     * @param key The key of the setting.
+     */
+    void changed(const QString &key);
+
 private:
     /**
-     * Creates the configuration
+     * The values of all the settings.
+     */
+    struct Snapshot {
+        bool showToolBar;
+        bool showStatusBar;
+        bool fullscreen;
+        bool viewWhitespace;
+        bool viewIndentationWhitespace;
+        bool viewIndentationGuides;
+        bool caretLineVisible;
+        bool braceHighlight;
+        bool bracePairColorization;
+        int indentationGuidesMode;
+        bool longLineIndicator;
+        bool longLineIndicatorLine;
+        int longLineIndicatorColumn;
+        bool viewEndOfLine;
+        bool showLineMargin;
+        int lineMarginWidth;
+        bool trackLineMarginWidth;
+        bool showIconMargin;
+        int iconMarginWidth;
+        bool showFoldMargin;
+        int foldMarginWidth;
+        int foldSymbols;
+        int foldLines;
+        bool wrap;
+        int tabWidth;
+        int indentationWidth;
+        bool useTabs;
+        int scrollWidth;
+        bool scrollWidthTracking;
+        QFont font;
+        QString colorScheme;
+        bool tabbedInterface;
+        int undoMemoryBudget;
+        int hibernateTimeout;
+        bool persistUndoHistory;
+    };
+
+    /**
+     * Creates the configuration and reads the settings.
      */
     Configuration();
 
+    /**
+     * Reads all the settings into the snapshot.
+     */
+    void load();
+
+    /**
+     * Returns the default font for the platform.
+     */
+    static QFont defaultFont();
+
+    /**
+     * Changes a value of the snapshot, and schedules the write of the setting.
+     *
+     * @param key The key of the setting.
+     * @param field The field of the snapshot.
+     * @param value The new value.
+     */
+    template <typename T>
+    void setValue(const QString &key, T &field, const T &value);
+
     /**
      * Private copy constructor to prevent instantiation.
      */
@@ -476,6 +644,15 @@ private:
 
     /** The application settings. */
     QSettings settings;
+
+    /** The current values of the settings. */
+    Snapshot m_snapshot;
+
+    /** The changed settings that have not been written yet. */
+    QHash<QString, QVariant> m_dirty;
+
+    /** Writes the changed settings after a delay. */
+    QTimer *m_syncTimer;
 };
 
 #endif // CONFIGURATION_H
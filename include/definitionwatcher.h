@@ -0,0 +1,99 @@
+#ifndef DEFINITIONWATCHER_H
+#define DEFINITIONWATCHER_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+class ColorScheme;
+class Language;
+class QFileSystemWatcher;
+
+/**
+ * Watches the language and color scheme definitions of the user
+ * configuration directory: the languages.xml file, and the XML files of the
+ * languages and colorschemes directories. When a file changes, only that file
+ * is read again, on a worker thread. The definitions are then updated in
+ * place, and the buffers that use them are notified.
+ *
+ * Definitions whose file is deleted stay available until the editor restarts.
+ */
+class DefinitionWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * Returns the instance of the watcher, which starts watching when it is
+     * first called. It must be called from the GUI thread.
+     *
+     * @return The instance of the watcher.
+     */
+    static DefinitionWatcher* instance();
+
+signals:
+    /**
+     * Emitted when a language has been added or updated.
+     *
+     * @param language The language.
+     */
+    void languageReloaded(const Language *language);
+
+    /**
+     * Emitted when a color scheme has been added or updated.
+     *
+     * @param colorScheme The color scheme.
+     */
+    void colorSchemeReloaded(const ColorScheme *colorScheme);
+
+private slots:
+    /**
+     * Called when a watched file has changed.
+     *
+     * @param path The path of the file.
+     */
+    void onFileChanged(const QString &path);
+
+    /**
+     * Called when a watched directory has changed, to find the new and the
+     * modified files.
+     */
+    void onDirectoryChanged();
+
+    /**
+     * Called when a languages file has been read on the worker thread.
+     */
+    void onLanguagesRead();
+
+    /**
+     * Called when a color scheme file has been read on the worker thread.
+     */
+    void onColorSchemesRead();
+
+private:
+    /**
+     * Private constructor to prevent instantiation.
+     */
+    DefinitionWatcher();
+
+    /**
+     * Watches the directories, and the definition files that exist.
+     */
+    void watch();
+
+    /**
+     * Reads a definition file again, if it has been modified since it was
+     * last read.
+     *
+     * @param path The path of the file.
+     */
+    void reload(const QString &path);
+
+    /** The watcher of the files and directories. */
+    QFileSystemWatcher *watcher;
+
+    /** The modification time of each definition file, when it was last read. */
+    QHash<QString, QDateTime> modified;
+};
+
+#endif // DEFINITIONWATCHER_H
@@ -0,0 +1,123 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include <Scintilla.h>
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFuture>
+#include <QList>
+#include <QPair>
+
+class BraceIndex;
+class Buffer;
+class Encoding;
+class Language;
+class QTemporaryFile;
+class UndoHistory;
+
+/**
+ * A document of a buffer. A buffer shows one document at a time, and can
+ * switch to another one without reading, decoding or lexing it again: each
+ * document keeps its Scintilla document, with its text, styles, markers and
+ * undo history, along with the state of the buffer for it while it is not
+ * shown.
+ *
+ * A document that has not been shown for a while is hibernated: its
+ * Scintilla document is released, and its text is read back from its file,
+ * or from a compressed copy if it has been modified, when it is shown again.
+ *
+ * Documents are created and deleted by their buffer, and are opaque to the
+ * other classes.
+ */
+class Document {
+    friend class Buffer;
+
+private:
+    /**
+     * Creates the state of a document.
+     *
+     * @param pointer The Scintilla document, which the buffer holds a
+     * reference to.
+     * @param braceIndex The index of the brackets of the document.
+     */
+    Document(sptr_t pointer, BraceIndex *braceIndex);
+
+    /**
+     * Destructor for the document, the buffer releases the Scintilla
+     * document.
+     */
+    ~Document();
+
+    /** The Scintilla document. */
+    sptr_t m_pointer;
+
+    /** true if the settings of the buffer have not been applied to the document yet. */
+    bool m_new;
+
+    /** The underlying file for the document. */
+    QFileInfo m_fileInfo;
+
+    /** The encoding for the document. */
+    const Encoding *m_encoding;
+
+    /** The language for the document. */
+    const Language *m_language;
+
+    /** The index of the brackets of the document. */
+    BraceIndex *m_braceIndex;
+
+    /** true if the document was modified when it was last shown. */
+    bool m_modified;
+
+    /** The estimated bytes of the undo history that Scintilla keeps for the document. */
+    qint64 m_undoBytes;
+
+    /** The undo steps moved out of Scintilla. */
+    UndoHistory *m_undoHistory;
+
+    /**
+     * true if the undo steps moved out of Scintilla include changes since
+     * the document was saved, so that the save point of Scintilla cannot
+     * tell whether it is modified.
+     */
+    bool m_modifiedOutsideHistory;
+
+    /** The anchor and the caret position when the document was last shown. */
+    sptr_t m_anchor;
+    sptr_t m_currentPos;
+
+    /** The first visible line and the horizontal scroll offset when the document was last shown. */
+    int m_firstVisibleLine;
+    int m_xOffset;
+
+    /** The fold header lines that were contracted when the document was last shown. */
+    QList<int> m_foldedLines;
+
+    /** Measures the time since the document was last shown. */
+    QElapsedTimer m_idleTimer;
+
+    /** true if the Scintilla document has been released, until the document is restored. */
+    bool m_hibernated;
+
+    /** The compressed text of a modified hibernated document, empty if it is spilled or read from its file. */
+    QByteArray m_hibernatedText;
+
+    /** The file with the compressed text, when it is too large to keep in memory, or null. */
+    QTemporaryFile *m_spillFile;
+
+    /** The last modification time of the file when the document was hibernated. */
+    QDateTime m_fileModified;
+
+    /** The lines with markers and their marker masks, when the document was hibernated. */
+    QList<QPair<int, int> > m_markerLines;
+
+    /** true if the undo history saved in a previous session may be loaded for the file. */
+    bool m_persistedHistory;
+
+    /** The hash of the text read from the file, computed on the thread pool. */
+    QFuture<QByteArray> m_contentHash;
+};
+
+#endif // DOCUMENT_H
@@ -4,6 +4,7 @@
 #include <QByteArray>
 #include <QListIterator>
 #include <QString>
+#include <QXmlStreamReader>
 
 class Encoding {
 public:
@@ -30,6 +31,12 @@ public:
      */
     static const Encoding *fromName(const QByteArray& name);
 
+    /**
+     * Initializes the available encodings, if they are not already. They are
+     * otherwise initialized on first use. It can be called from any thread.
+     */
+    static void initialize();
+
     /**
      * Cleans up the static recources.
      */
@@ -73,12 +80,26 @@ public:
 private:
 
     /**
-     * Initializes the available languages list
+     * Initializes the available encodings list, from the encodings file of
+     * the user configuration directory if there is one, or from the built-in
+     * table.
      */
     static QList<Encoding*> intializeEncodings();
 
-    /** Holds all the available languages. */
-    static QList<Encoding*> availableEncodings;
+    /**
+     * Reads the encodings from an XML file.
+     *
+     * @param xml The XML reader.
+     * @return The encodings read.
+     */
+    static QList<Encoding*> processEncodingsXml(QXmlStreamReader &xml);
+
+    /**
+     * Returns all the available encodings, initializing them on first use.
+     *
+     * @return The available encodings.
+     */
+    static QList<Encoding*> &availableEncodings();
 
     /**
      * Creates the encoding.
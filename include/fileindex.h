@@ -0,0 +1,265 @@
+#ifndef FILEINDEX_H
+#define FILEINDEX_H
+
+#include <QByteArray>
+#include <QDir>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * An in-memory index of all the files under a root directory. The index is
+ * populated by a crawler that runs on a background thread and is kept up to
+ * date with a file system watcher. It is used by the quick open dialog in
+ * order to fuzzy match file paths.
+ */
+class FileIndex : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * A file that matched a query.
+     */
+    struct Match {
+        /** The path of the file, relative to the root path. */
+        QString path;
+
+        /** The match score. Higher is better. */
+        int score;
+    };
+
+    /**
+     * An indexed file.
+     */
+    struct Entry {
+        /** The path of the file, relative to the root path. */
+        QString path;
+
+        /** The lower case UTF-8 representation of the path, used for matching. */
+        QByteArray key;
+
+        /** The offset of the file name in the key. */
+        int fileNameStart;
+
+        /** A bit mask of the characters that appear in the key. */
+        quint64 mask;
+    };
+
+    /**
+     * Returns an instance of the file index.
+     *
+     * @return An instance of the file index.
+     */
+    static FileIndex* instance();
+
+    /**
+     * Returns the project root for a directory. This is the nearest ancestor
+     * that contains a version control directory, or the directory itself if
+     * none is found.
+     *
+     * @param dir The directory.
+     * @return The project root.
+     */
+    static QString projectRoot(const QDir &dir);
+
+    /**
+     * Scores a file against a pattern. The pattern must be a lower case UTF-8
+     * string, as returned by foldKey().
+     *
+     * @param pattern The pattern.
+     * @param patternMask The character mask of the pattern.
+     * @param entry The file entry.
+     * @return The score, or -1 if the pattern does not match the file.
+     */
+    static int score(const QByteArray &pattern, quint64 patternMask, const Entry &entry);
+
+    /**
+     * Converts a string to the representation used for matching.
+     *
+     * @param text The text.
+     * @return The lower case UTF-8 representation of the text, without spaces.
+     */
+    static QByteArray foldKey(const QString &text);
+
+    /**
+     * Returns the character mask for a key.
+     *
+     * @param key The key.
+     * @return The character mask.
+     */
+    static quint64 charMask(const QByteArray &key);
+
+    /**
+     * Returns the root path of the index.
+     *
+     * @return The root path of the index.
+     */
+    QString rootPath() const;
+
+    /**
+     * Sets the root path of the index. If the path is different from the
+     * current one, the index is cleared and a new crawl is started.
+     *
+     * @param rootPath The new root path.
+     */
+    void setRootPath(const QString &rootPath);
+
+    /**
+     * Returns true while the crawler is running.
+     *
+     * @return true while the crawler is running.
+     */
+    bool isCrawling() const;
+
+    /**
+     * Returns the number of files in the index.
+     *
+     * @return The number of files in the index.
+     */
+    int fileCount() const;
+
+    /**
+     * Finds the files that best match a query. The scoring runs in parallel
+     * on all the available cores.
+     *
+     * @param query The query.
+     * @param maxResults The maximum number of results to return.
+     * @return The matching files, best match first.
+     */
+    QList<Match> match(const QString &query, int maxResults) const;
+
+signals:
+    /**
+     * Emitted when files are added to or removed from the index.
+     */
+    void indexChanged();
+
+private slots:
+    /**
+     * Called when a background crawl has finished.
+     */
+    void onCrawlFinished();
+
+    /**
+     * Called when the contents of a watched directory have changed.
+     *
+     * @param path The absolute path of the directory.
+     */
+    void onDirectoryChanged(const QString &path);
+
+private:
+    /**
+     * The result of a crawl.
+     */
+    struct CrawlResult {
+        /** The files of each directory, keyed by the path of the directory relative to the root. */
+        QHash<QString, QVector<Entry> > files;
+
+        /** The subdirectories of each directory that was listed without crawling them. */
+        QHash<QString, QStringList> subdirectories;
+    };
+
+    /**
+     * Private constructor to prevent instantiation.
+     */
+    FileIndex();
+
+    /**
+     * Private copy constructor to prevent instantiation.
+     */
+    FileIndex(const FileIndex&);
+
+    /**
+     * Private equals operator to prevent instantiation.
+     */
+    FileIndex& operator=(const FileIndex&);
+
+    /**
+     * Crawls directories. Runs on a worker thread.
+     *
+     * @param rootPath The root path of the index.
+     * @param directories The directories to crawl, relative to the root path.
+     * @param recursive true to crawl the subdirectories too, false to only
+     * list them.
+     * @return The crawled files.
+     */
+    static CrawlResult crawl(const QString &rootPath, const QStringList &directories, bool recursive);
+
+    /**
+     * Lists the files and the subdirectories of a single directory.
+     *
+     * @param rootPath The root path of the index.
+     * @param directory The directory, relative to the root path.
+     * @param files Output parameter, the files of the directory.
+     * @param subdirectories Output parameter, the subdirectories of the
+     * directory, relative to the root path.
+     */
+    static void listDirectory(const QString &rootPath, const QString &directory,
+            QVector<Entry> *files, QStringList *subdirectories);
+
+    /**
+     * Starts crawling directories on a worker thread. The directories are
+     * pending until the crawl finishes.
+     *
+     * @param directories The directories to crawl, relative to the root path.
+     * @param recursive true to crawl the subdirectories too, false to list the
+     * directories again and only crawl their new subdirectories.
+     */
+    void startCrawl(const QStringList &directories, bool recursive);
+
+    /**
+     * Removes a directory and all its subdirectories from the index.
+     *
+     * @param directory The directory, relative to the root path.
+     */
+    void removeDirectory(const QString &directory);
+
+    /**
+     * Returns the absolute path of a directory of the index.
+     *
+     * @param directory The directory, relative to the root path.
+     * @return The absolute path.
+     */
+    QString absolutePath(const QString &directory) const;
+
+    /**
+     * Returns the flat list of all entries, rebuilding it if needed.
+     *
+     * @return The flat list of all entries.
+     */
+    const QVector<Entry> &entries() const;
+
+    /** The root path of the index. */
+    QString m_rootPath;
+
+    /** Incremented every time the root path changes, to discard stale crawls. */
+    int m_generation;
+
+    /** The number of crawls that are running. */
+    int m_runningCrawls;
+
+    /** The files of each directory, keyed by the relative directory path. */
+    QHash<QString, QVector<Entry> > m_directories;
+
+    /** The directories passed to the running crawls, relative to the root path. */
+    QSet<QString> m_pendingDirectories;
+
+    /** The pending directories that changed, they are listed again when their crawl finishes. */
+    QSet<QString> m_changedDirectories;
+
+    /** The flat list of all entries, used for matching. */
+    mutable QVector<Entry> m_entries;
+
+    /** true if the flat list of entries must be rebuilt. */
+    mutable bool m_entriesDirty;
+
+    /** Watches the indexed directories for changes. */
+    QFileSystemWatcher m_watcher;
+};
+
+#endif // FILEINDEX_H
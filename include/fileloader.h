@@ -0,0 +1,85 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Reads and decodes files concurrently on the global thread pool, and reports
+ * each one as soon as it is ready. The smaller files are started first, so
+ * that they do not wait behind large ones.
+ */
+class FileLoader : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * The result of reading a file.
+     */
+    struct Result {
+        /** The name of the file. */
+        QString fileName;
+
+        /** The contents of the file, in UTF-8. */
+        QByteArray content;
+
+        /** true if the file has been read. */
+        bool ok;
+    };
+
+    /**
+     * Creates the loader.
+     *
+     * @param parent The parent object.
+     */
+    explicit FileLoader(QObject *parent = 0);
+
+    /**
+     * Starts reading files.
+     *
+     * @param fileNames The absolute names of the files.
+     * @param encoding The system name of the encoding of the files.
+     */
+    void load(const QStringList &fileNames, const QByteArray &encoding);
+
+signals:
+    /**
+     * Emitted when a file has been read.
+     *
+     * @param fileName The name of the file.
+     * @param content The contents of the file, in UTF-8.
+     */
+    void fileLoaded(const QString &fileName, const QByteArray &content);
+
+    /**
+     * Emitted when a file cannot be read, for example because it does not
+     * exist.
+     *
+     * @param fileName The name of the file.
+     */
+    void fileFailed(const QString &fileName);
+
+    /**
+     * Emitted when all the files have been reported.
+     */
+    void finished();
+
+private slots:
+    /**
+     * Called when a file has been read on the thread pool.
+     */
+    void onReadFinished();
+
+private:
+    /**
+     * Reads a file, runs on the thread pool.
+     */
+    static Result read(const QString &fileName, const QByteArray &encoding);
+
+    /** The number of files that are still being read. */
+    int m_pending;
+};
+
+#endif // FILELOADER_H
@@ -0,0 +1,143 @@
+#ifndef FILESEARCH_H
+#define FILESEARCH_H
+
+#include "textsearch.h"
+
+#include <QFile>
+#include <QVector>
+
+/**
+ * Searches a file directly, without loading it into a buffer. The file is
+ * mapped into memory and lines are located through a sparse line index, which
+ * stores the number of lines that start before each fixed size block of the
+ * file.
+ */
+class FileSearch {
+public:
+    /**
+     * Creates the search for a file. The file is not opened until open() is
+     * called.
+     *
+     * @param fileName The name of the file.
+     */
+    explicit FileSearch(const QString &fileName);
+
+    /**
+     * Unmaps and closes the file.
+     */
+    ~FileSearch();
+
+    /**
+     * Maps the file into memory and builds the line index.
+     *
+     * @return true if the file has been mapped successfully.
+     */
+    bool open();
+
+    /**
+     * Returns true if the file is mapped.
+     *
+     * @return true if the file is mapped.
+     */
+    bool isOpen() const;
+
+    /**
+     * Returns the size of the file.
+     *
+     * @return The size of the file in bytes.
+     */
+    qint64 size() const;
+
+    /**
+     * Returns the contents of the file.
+     *
+     * @return A pointer to the mapped file.
+     */
+    const char *data() const;
+
+    /**
+     * Returns the number of lines in the file.
+     *
+     * @return The number of lines.
+     */
+    qint64 lineCount() const;
+
+    /**
+     * Returns the line that contains a position.
+     *
+     * @param position The position in the file.
+     * @return The line number, starting from 0.
+     */
+    qint64 lineFromPosition(qint64 position) const;
+
+    /**
+     * Returns the position of the start of a line.
+     *
+     * @param line The line number, starting from 0.
+     * @return The position of the start of the line.
+     */
+    qint64 positionFromLine(qint64 line) const;
+
+    /**
+     * Finds the first match that starts at or after a position.
+     *
+     * @param search The search.
+     * @param from The position where the search starts.
+     * @param match Output parameter, set to the match if one was found.
+     * @return true if a match was found.
+     */
+    bool findNext(const TextSearch &search, qint64 from, TextSearch::Match *match) const;
+
+    /**
+     * Finds the last match that starts before a position and ends at or
+     * before it.
+     *
+     * @param search The search.
+     * @param from The position where the search starts.
+     * @param match Output parameter, set to the match if one was found.
+     * @return true if a match was found.
+     */
+    bool findPrevious(const TextSearch &search, qint64 from, TextSearch::Match *match) const;
+
+    /**
+     * Finds all the matches in the file.
+     *
+     * @param search The search.
+     * @param threadCount The number of threads, or 0 to use one thread per
+     * core.
+     * @return The matches, in file order.
+     */
+    QVector<TextSearch::Match> findAll(const TextSearch &search, int threadCount = 0) const;
+
+private:
+    /**
+     * Counts the lines that start in a range of the file, that is the line
+     * ends in the range.
+     */
+    qint64 countLineStarts(qint64 begin, qint64 end) const;
+
+    /**
+     * Returns the start of the line that contains a position.
+     */
+    qint64 lineStart(qint64 position) const;
+
+    /**
+     * Returns the start of the line that follows the line that contains a
+     * position, or the size of the file if it is the last line.
+     */
+    qint64 nextLineStart(qint64 position) const;
+
+    /** The mapped file. */
+    QFile m_file;
+
+    /** The contents of the file, or null if the file is not mapped. */
+    const char *m_data;
+
+    /** The size of the file. */
+    qint64 m_size;
+
+    /** The number of lines that start before each block of the file. */
+    QVector<qint64> m_blockLines;
+};
+
+#endif // FILESEARCH_H
@@ -51,6 +51,14 @@ signals:
      */
     void find(const QString& findText, int flags, bool forward, bool wrap);
 
+    /**
+     * This signal is emitted when the find all button is pressed.
+     *
+     * @param findText The text to search for.
+     * @param flags The search flags.
+     */
+    void findAll(const QString& findText, int flags);
+
     /**
      * This signal is emitted when the replace button is pressed.
      *
@@ -89,6 +97,11 @@ private slots:
      */
     void on_findPushButton_clicked();
 
+    /**
+     * Called when the find all button is clicked.
+     */
+    void on_findAllPushButton_clicked();
+
     /**
      * Called when the replace button is clicked.
      */
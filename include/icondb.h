@@ -5,7 +5,8 @@
 #include <QMap>
 
 /**
- * A class that holds all the application icons.
+ * A class that holds all the application icons. The icons are created on
+ * first use, it must only be used from the GUI thread.
  */
 class IconDb {
 public:
@@ -49,7 +50,7 @@ private:
      */
     IconDb& operator=(const IconDb&);
 
-    /** The map that stores the various icons. */
+    /** The map that stores the icons created so far. */
     QMap<Icon, QIcon> iconMap;
 };
 
@@ -1,9 +1,16 @@
 #ifndef LANGUAGE_H
 #define LANGUAGE_H
 
+#include <QBitArray>
+#include <QByteArray>
+#include <QFileInfo>
+#include <QHash>
 #include <QList>
+#include <QRegExp>
+#include <QSharedPointer>
 #include <QString>
 #include <QStringList>
+#include <QXmlStreamReader>
 
 #include "styleinfo.h"
 
@@ -38,12 +45,53 @@ public:
 
     /**
      * Returns the language that correspond to the file with the specific name.
+     * When the patterns of several languages match, the first language wins.
      *
-     * @param fileName The file name.
+     * @param fileName The file name, without the directory.
      * @return The corresponding language.
      */
     static const Language* fromFilename(const QString& fileName);
 
+    /**
+     * Returns the language of a file from its contents, for files whose name
+     * does not tell the language. It looks for a shebang line, for emacs and
+     * vim modelines and for a few signatures of the languages. The result is
+     * cached for the path, until the file changes.
+     *
+     * @param fileInfo The file.
+     * @param content The contents of the file, only the start and the end
+     * are examined.
+     * @return The language, or NULL if it is not recognized.
+     */
+    static const Language* fromContent(const QFileInfo& fileInfo, const QByteArray& content);
+
+    /**
+     * Reads the languages defined in a file. It can be called from any
+     * thread, the languages are not added to the available ones.
+     *
+     * @param fileName The name of the file.
+     * @param ok Output parameter, set to true if the file has been read.
+     * @return The languages read, which the caller owns.
+     */
+    static QList<Language*> readLanguages(const QString& fileName, bool *ok = 0);
+
+    /**
+     * Adds languages to the available ones. A language replaces the available
+     * language with the same identifier, which is updated in place so that
+     * the pointers to it stay valid. It must be called from the GUI thread.
+     *
+     * @param languages The languages, as read by readLanguages(). They are
+     * owned by the available languages afterwards.
+     * @return The languages that have been added or updated.
+     */
+    static QList<const Language*> update(const QList<Language*>& languages);
+
+    /**
+     * Initializes the available languages, if they are not already. They are
+     * otherwise initialized on first use. It can be called from any thread.
+     */
+    static void initialize();
+
     /**
      * Cleans up the static recources.
      */
@@ -77,6 +125,14 @@ public:
      */
     QString patterns() const;
 
+    /**
+     * Returns the interpreters of the scripts in the language, which are
+     * recognized in shebang lines.
+     *
+     * @return The interpreter names.
+     */
+    QStringList interpreters() const;
+
     /**
      * Returns the keywords for the language, seperated by space.
      *
@@ -91,6 +147,14 @@ public:
      */
     QList<StyleDescription> styles() const;
 
+    /**
+     * Returns true if the style is used by the lexer for comments or strings.
+     *
+     * @param style The style number.
+     * @return true if the style is used for comments or strings.
+     */
+    bool isCommentOrStringStyle(int style) const;
+
 private:
 
     /**
@@ -114,12 +178,85 @@ private:
     void operator=(Language const&);
 
     /**
-     * Initializes the available languages list
+     * Initializes the available languages list, from the languages file of
+     * the user configuration directory if there is one, or from the built-in
+     * table. The files of the languages directory of the user configuration
+     * directory are added.
      */
     static QList<Language*> intializeLangs();
 
-    /** Holds all the available languages. */
-    static QList<Language*> availableLangs;
+    /**
+     * Creates the built-in languages.
+     *
+     * @return The built-in languages.
+     */
+    static QList<Language*> builtinLanguages();
+
+    /**
+     * Adds languages to a list, replacing the ones with the same identifier.
+     *
+     * @param langs The list.
+     * @param languages The languages to add, owned by the list afterwards.
+     * @return The languages that have been added or updated.
+     */
+    static QList<const Language*> merge(QList<Language*>& langs, const QList<Language*>& languages);
+
+    /**
+     * Reads the languages from an XML file.
+     *
+     * @param xml The XML reader.
+     * @return The languages read.
+     */
+    static QList<Language*> processLanguagesXml(QXmlStreamReader &xml);
+
+    /**
+     * Returns the language whose scripts run with an interpreter.
+     *
+     * @param interpreter The name of the interpreter, with or without version.
+     * @return The language, or NULL if there is none.
+     */
+    static const Language* fromInterpreter(const QString& interpreter);
+
+    /**
+     * Returns the language named in an emacs or vim modeline.
+     *
+     * @param mode The mode or file type of the modeline.
+     * @return The language, or NULL if there is none.
+     */
+    static const Language* fromMode(const QString& mode);
+
+    /**
+     * The file patterns of all the languages, prepared for the lookup of file
+     * names. Each language is stored with its index in the available
+     * languages, so that the first one wins as when the patterns are tried in
+     * order.
+     */
+    struct FilenameIndex {
+        /** The languages by extension, for the *.extension patterns. */
+        QHash<QString, int> extensions;
+
+        /** The languages by file name, for the patterns without wildcards. */
+        QHash<QString, int> names;
+
+        /** The remaining patterns, ordered by language. */
+        QList<QPair<QRegExp, int> > globs;
+    };
+
+    /**
+     * Returns the index of the file patterns, building it on first use.
+     *
+     * @param reset true to discard the index, after the languages have
+     * changed.
+     * @return The index of the file patterns, or null if it was discarded.
+     */
+    static QSharedPointer<const FilenameIndex> filenameIndex(bool reset = false);
+
+    /**
+     * Returns all the available languages, initializing them on first use.
+     *
+     * @return The available languages.
+     */
+    static QList<Language*> &availableLangs();
 
     /** The language identifier */
     QString m_langId;
@@ -133,11 +270,17 @@ private:
     /** The file patterns for the language. */
     QString m_patterns;
 
+    /** The interpreters of the scripts in the language. */
+    QStringList m_interpreters;
+
     /** The keywords for the language, seperated by space. */
     QStringList m_keywords;
 
     /** The list of styles available for this language. */
     QList<StyleDescription> m_styles;
+
+    /** The styles used for comments and strings. */
+    QBitArray m_commentOrStringStyles;
 };
 
 #endif // LANGUAGE_H
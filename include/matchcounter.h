@@ -0,0 +1,146 @@
+#ifndef MATCHCOUNTER_H
+#define MATCHCOUNTER_H
+
+#include "textsearch.h"
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QVector>
+
+class Buffer;
+
+/**
+ * Counts the matches of the last search in a buffer. The matches are found on
+ * a worker thread over a snapshot of the document, so that the count never
+ * delays the search itself, and they are kept up to date incrementally while
+ * the buffer is being edited.
+ */
+class MatchCounter : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * Creates the match counter.
+     *
+     * @param parent The parent object.
+     */
+    explicit MatchCounter(QObject *parent = 0);
+
+    /**
+     * Sets the buffer in which the matches are counted.
+     *
+     * @param buffer The buffer.
+     */
+    void setBuffer(Buffer *buffer);
+
+    /**
+     * Sets the search whose matches are counted. If the search and the buffer
+     * have not changed since the last count, the cached matches are used. The
+     * matches of the searches that might not find the same matches as
+     * Scintilla are not counted.
+     *
+     * @param findText The text to search for.
+     * @param flags The Scintilla search flags.
+     */
+    void setQuery(const QString &findText, int flags);
+
+    /**
+     * Returns true if the matches have been counted.
+     *
+     * @return true if the matches have been counted.
+     */
+    bool isReady() const;
+
+    /**
+     * Returns the number of matches.
+     *
+     * @return The number of matches, or -1 if they have not been counted yet.
+     */
+    int count() const;
+
+    /**
+     * Returns the index of the match that starts at a position.
+     *
+     * @param position The position in the document.
+     * @return The index of the match, or -1 if no match starts at the position.
+     */
+    int indexOf(qint64 position) const;
+
+signals:
+    /**
+     * Emitted when the matches have been counted again.
+     */
+    void countChanged();
+
+private slots:
+    /**
+     * Called when the count on the worker thread has finished.
+     */
+    void onCountFinished();
+
+    /**
+     * Called when the buffer has been modified, in order to update the
+     * matches of the modified lines.
+     */
+    void onModified(int type, int position, int length, int linesAdded,
+            const QByteArray &text, int line, int foldNow, int foldPrev);
+
+    /**
+     * Called when the buffer shows another document, in order to forget the
+     * matches.
+     */
+    void reset();
+
+private:
+    typedef QVector<TextSearch::Match> Matches;
+
+    /**
+     * Finds all the matches in a snapshot of the document.
+     *
+     * @param search The search.
+     * @param text The snapshot of the document.
+     * @return The matches.
+     */
+    static Matches findMatches(QSharedPointer<const TextSearch> search, QByteArray text);
+
+    /**
+     * Starts counting the matches on a worker thread.
+     */
+    void startCount();
+
+    /**
+     * Finds again the matches of the lines affected by an edit.
+     *
+     * @param position The position of the edit.
+     * @param inserted The number of bytes inserted.
+     * @param deleted The number of bytes deleted.
+     * @return false if the matches must be counted again from scratch.
+     */
+    bool updateMatches(qint64 position, qint64 inserted, qint64 deleted);
+
+    /** The buffer in which the matches are counted. */
+    Buffer *m_buffer;
+
+    /** The current search, or null if there is none. */
+    QSharedPointer<const TextSearch> m_search;
+
+    /** The matches of the current search. */
+    Matches m_matches;
+
+    /** true if the matches are up to date. */
+    bool m_ready;
+
+    /** true if a count is running on the worker thread. */
+    bool m_counting;
+
+    /** true if the buffer was modified while the count was running. */
+    bool m_stale;
+
+    /** The modification counter of the buffer the matches correspond to. */
+    quint64 m_modificationCounter;
+
+    /** Incremented for every count, in order to discard outdated results. */
+    int m_generation;
+};
+
+#endif // MATCHCOUNTER_H
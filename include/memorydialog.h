@@ -0,0 +1,67 @@
+#ifndef MEMORYDIALOG_H
+#define MEMORYDIALOG_H
+
+#include <QDialog>
+
+class QTimer;
+
+namespace Ui {
+class MemoryDialog;
+}
+
+/**
+ * Lists the memory used by each document of the open buffers, by category,
+ * along with the totals of the process. The figures are refreshed every
+ * second while the dialog is shown.
+ */
+class MemoryDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    /**
+     * Creates the dialog.
+     *
+     * @param parent The parent widget.
+     */
+    explicit MemoryDialog(QWidget *parent = 0);
+
+    /**
+     * Destroys the dialog.
+     */
+    ~MemoryDialog();
+
+protected:
+    /**
+     * Overriden, in order to refresh the figures and start the timer.
+     *
+     * @param e The show event.
+     */
+    void showEvent(QShowEvent *e);
+
+    /**
+     * Overriden, in order to stop the timer.
+     *
+     * @param e The hide event.
+     */
+    void hideEvent(QHideEvent *e);
+
+private slots:
+    /**
+     * Collects the memory usage again and displays it.
+     */
+    void refresh();
+
+    /**
+     * Called when the close button is clicked.
+     */
+    void on_pushButtonClose_clicked();
+
+private:
+    /** The dialog UI. */
+    Ui::MemoryDialog *ui;
+
+    /** Refreshes the figures while the dialog is shown. */
+    QTimer *m_refreshTimer;
+};
+
+#endif // MEMORYDIALOG_H
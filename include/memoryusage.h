@@ -0,0 +1,70 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QList>
+#include <QString>
+
+/**
+ * The memory used by a document of a buffer. The figures are estimated from
+ * the state that Scintilla and the buffer already keep, without walking the
+ * text, so that they can be collected often. Only the markers and the
+ * indicators are counted, by walking the lines that have markers and the
+ * runs of the indicators.
+ */
+struct MemoryUsage {
+    /**
+     * Creates an empty usage.
+     */
+    MemoryUsage();
+
+    /** The name of the document. */
+    QString name;
+
+    /** true if the document is a second view of the document of another buffer, and is not counted in the totals. */
+    bool shared;
+
+    /** The bytes of the text. */
+    qint64 textBytes;
+
+    /** The bytes of the styles, one for each byte of the text. */
+    qint64 styleBytes;
+
+    /** The bytes of the undo history, including the overhead of each action. */
+    qint64 undoBytes;
+
+    /** The bytes of file contents kept by the buffer outside of Scintilla. */
+    qint64 cachedBytes;
+
+    /** The number of lines with markers, such as bookmarks. */
+    int markers;
+
+    /** The number of indicator runs, such as the bracket pair colors. */
+    int indicators;
+
+    /**
+     * Returns the total number of bytes.
+     *
+     * @return The total number of bytes.
+     */
+    qint64 totalBytes() const;
+
+    /**
+     * Collects the memory used by the documents of all the buffers. It must be
+     * called from the GUI thread, and works without any window, for example
+     * in benchmarks.
+     *
+     * @return The usage of each document.
+     */
+    static QList<MemoryUsage> collect();
+
+    /**
+     * Adds up the usage of documents, by category. The second views of shared
+     * documents are skipped.
+     *
+     * @param usages The usage of each document.
+     * @return The total usage.
+     */
+    static MemoryUsage sum(const QList<MemoryUsage> &usages);
+};
+
+#endif // MEMORYUSAGE_H
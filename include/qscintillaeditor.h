@@ -10,13 +10,22 @@
 
 class AboutDialog;
 class Buffer;
+class Document;
 class Encoding;
 class EncodingDialog;
 class FindReplaceDialog;
 class Language;
 class LanguageDialog;
+class MatchCounter;
+class MemoryDialog;
+class QAction;
 class QLabel;
+class QProgressBar;
+class QuickOpenDialog;
 class QSettings;
+class QSplitter;
+class QTabBar;
+class QTimer;
 
 namespace Ui {
 class QScintillaEditor;
@@ -54,6 +63,14 @@ public:
      */
     void openFile(const QString& fileName);
 
+    /**
+     * Shows a file whose contents have already been read.
+     *
+     * @param fileName The file name.
+     * @param content The contents of the file, as read by Buffer::readFile().
+     */
+    void openFileContent(const QString& fileName, const QByteArray& content);
+
 protected:
     bool eventFilter(QObject *obj, QEvent *event);
 
@@ -68,6 +85,11 @@ private slots:
      */
     void on_actionOpen_triggered();
 
+    /**
+     * Called when the Quick open action is triggered.
+     */
+    void on_actionQuickOpen_triggered();
+
     /**
      * Called when the Reopen action is triggered.
      */
@@ -148,6 +170,11 @@ private slots:
      */
     void on_actionGoTo_triggered();
 
+    /**
+     * Called when the Go to enclosing brace action is triggered.
+     */
+    void on_actionGoToEnclosingBrace_triggered();
+
     /**
      * Called when the Select all action is triggered.
      */
@@ -168,6 +195,23 @@ private slots:
      */
     void on_actionFullscreen_triggered();
 
+    /**
+     * Called when the Split horizontally action is triggered, to show a second
+     * view of the document below the first one.
+     */
+    void on_actionSplitHorizontally_triggered();
+
+    /**
+     * Called when the Split vertically action is triggered, to show a second
+     * view of the document beside the first one.
+     */
+    void on_actionSplitVertically_triggered();
+
+    /**
+     * Called when the Unsplit action is triggered.
+     */
+    void on_actionUnsplit_triggered();
+
     /**
      * Called when the Zoom in action is triggered.
      */
@@ -203,6 +247,11 @@ private slots:
      */
     void on_actionLongLineIndicator_triggered();
 
+    /**
+     * Called when the action to color the bracket pairs is triggered.
+     */
+    void on_actionBracePairColorization_triggered();
+
     /**
      * Called when the View line numbers action is triggered.
      */
@@ -293,6 +342,11 @@ private slots:
      */
     void on_actionClearAllBookmarks_triggered();
 
+    /**
+     * Called when the Memory usage action is triggered.
+     */
+    void on_actionMemoryUsage_triggered();
+
     /**
      * Called when the About action is triggered.
      */
@@ -308,6 +362,14 @@ private slots:
      */
     void find(const QString& findText, int flags, bool forward, bool wrap);
 
+    /**
+     * Called when the user wants to select all occurences of the text.
+     *
+     * @param findText The text to search for.
+     * @param flags The search flags.
+     */
+    void findAll(const QString& findText, int flags);
+
     /**
      * Called when the user wants to replace the found text.
      *
@@ -342,6 +404,12 @@ private slots:
      */
     void updateUi(int updated);
 
+    /**
+     * Updates the actions and labels that depend on the buffer state, once
+     * per event loop iteration for all the updates received in between.
+     */
+    void processUiUpdates();
+
     /**
      * Triggered when the opened file in the editor has changed.
      *
@@ -370,12 +438,68 @@ private slots:
      */
     void onUrlsDropped(const QList<QUrl>& uls);
 
+    /**
+     * Triggered when the matches of the last search have been counted.
+     */
+    void onMatchCountChanged();
+
+    /**
+     * Called when a setting has been changed, possibly from another window.
+     *
+     * @param key The key of the setting.
+     */
+    void onConfigurationChanged(const QString &key);
+
+    /**
+     * Called when the buffer shows another document, in order to update the
+     * window for it.
+     */
+    void onDocumentChanged();
+
+    /**
+     * Called when the buffer starts or finishes restoring a hibernated
+     * document, in order to show the progress.
+     *
+     * @param restoring true if the document is being restored.
+     */
+    void onRestoringChanged(bool restoring);
+
+    /**
+     * Called when the text of a hibernated document cannot be read back, in
+     * order to report it.
+     *
+     * @param fileName The name of the file.
+     */
+    void onRestoreFailed(const QString &fileName);
+
+    /**
+     * Called when another tab has been selected.
+     *
+     * @param index The index of the tab.
+     */
+    void onTabChanged(int index);
+
+    /**
+     * Called when the close button of a tab has been clicked.
+     *
+     * @param index The index of the tab.
+     */
+    void onTabCloseRequested(int index);
+
 private:
     /**
      * Sets up the actions for the window.
      */
     void setUpActions();
 
+    /**
+     * Checks or unchecks an action, triggering it if its state changes.
+     *
+     * @param action The action.
+     * @param checked The new state of the action.
+     */
+    void syncAction(QAction *action, bool checked);
+
     /**
      * Set up the menu bar.
      */
@@ -394,6 +518,34 @@ private:
      */
     void setUpStatusBar();
 
+    /**
+     * Sets up the tab bar of the tabbed interface, above the buffer.
+     */
+    void setUpTabBar();
+
+    /**
+     * Shows a second view of the document, or changes the orientation of the
+     * views if it is already shown.
+     *
+     * @param orientation The orientation of the splitter.
+     */
+    void split(Qt::Orientation orientation);
+
+    /**
+     * Shows a new empty document in a new tab, unless the current document is
+     * an empty untitled one that can be used instead.
+     */
+    void addTab();
+
+    /**
+     * Closes a tab, asking the user to save its document if it is modified.
+     * The last tab is cleared instead.
+     *
+     * @param index The index of the tab.
+     * @return true if the tab was closed, false if the user canceled.
+     */
+    bool closeTab(int index);
+
     /**
      * Sets the window title.
      */
@@ -419,6 +571,13 @@ private:
      */
     void initFindDialog();
 
+    /**
+     * Displays the result of the last search in the status bar, along with the
+     * index of the selected match and the number of matches if they have been
+     * counted.
+     */
+    void updateFindMessage();
+
     /**
      * Called when the user tries to close the application.
      *
@@ -432,6 +591,18 @@ private:
     /** The editor control. */
     Buffer *edit;
 
+    /** The second view of the document, or null if the window is not split. */
+    Buffer *splitEdit;
+
+    /** Holds the editor control and the second view. */
+    QSplitter *splitter;
+
+    /** The tab bar of the tabbed interface, or null if the window shows a single document. */
+    QTabBar *tabBar;
+
+    /** The document of each tab. */
+    QList<Document*> documents;
+
     /** The working directory. */
     QDir workingDir;
 
@@ -447,6 +618,24 @@ private:
     /** The status bar label that displays the current position. */
     QLabel *positionLabel;
 
+    /** The status bar indicator shown while a hibernated document is restored. */
+    QProgressBar *restoreProgress;
+
+    /** Coalesces the UI updates into a single pass per event loop iteration. */
+    QTimer *uiUpdateTimer;
+
+    /** The SC_UPDATE_* flags received since the last pass. */
+    int pendingUiUpdates;
+
+    /** true if the buffer had a selection at the last pass. */
+    bool hadSelection;
+
+    /** The line displayed in the position label. */
+    int displayedLine;
+
+    /** The column displayed in the position label. */
+    int displayedColumn;
+
     /** true if the window was maximized before going full screen. */
     bool wasMaximized;
 
@@ -456,6 +645,15 @@ private:
     /** The last find parameters. */
     FindParams lastFindParams;
 
+    /** true if the last search found a match. */
+    bool lastFindFound;
+
+    /** true if the last search wrapped. */
+    bool lastFindWrapped;
+
+    /** Counts the matches of the last search. */
+    MatchCounter *matchCounter;
+
     /** The about dialog. */
     AboutDialog *aboutDlg;
 
@@ -464,6 +662,12 @@ private:
 
     /** The select language dialog. */
     LanguageDialog *languageDlg;
+
+    /** The quick open dialog. */
+    QuickOpenDialog *quickOpenDlg;
+
+    /** The memory usage dialog. */
+    MemoryDialog *memoryDlg;
 };
 
 #endif // QSCINTILLAEDITOR_H
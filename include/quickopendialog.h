@@ -0,0 +1,94 @@
+#ifndef QUICKOPENDIALOG_H
+#define QUICKOPENDIALOG_H
+
+#include <QDialog>
+
+class QListWidgetItem;
+
+namespace Ui {
+class QuickOpenDialog;
+}
+
+/**
+ * A dialog that opens files by fuzzy matching their paths against the files
+ * of the file index.
+ */
+class QuickOpenDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    /**
+     * Creates the dialog.
+     *
+     * @param parent The parent widget.
+     */
+    explicit QuickOpenDialog(QWidget *parent = 0);
+
+    /**
+     * Destroys the dialog.
+     */
+    ~QuickOpenDialog();
+
+    /**
+     * Returns the absolute path of the selected file.
+     *
+     * @return The absolute path of the selected file, or a null string if no
+     * file is selected.
+     */
+    QString selectedFile() const;
+
+protected:
+    /**
+     * Overriden, in order to make sure that the query is cleared when the
+     * dialog is shown.
+     *
+     * @param e The show event.
+     */
+    virtual void showEvent(QShowEvent *e);
+
+    /**
+     * Overriden, in order to move the selection in the result list while the
+     * query edit has the focus.
+     *
+     * @param obj The watched object.
+     * @param event The event.
+     * @return true if the event was handled.
+     */
+    virtual bool eventFilter(QObject *obj, QEvent *event);
+
+private slots:
+    /**
+     * Called when the query text has changed.
+     *
+     * @param text The new text.
+     */
+    void on_queryEdit_textChanged(const QString &text);
+
+    /**
+     * Called when the return key is pressed in the query edit.
+     */
+    void on_queryEdit_returnPressed();
+
+    /**
+     * Called when an item of the result list is activated.
+     *
+     * @param item The activated item.
+     */
+    void on_resultListWidget_itemActivated(QListWidgetItem *item);
+
+    /**
+     * Called when the file index has changed, in order to refresh the results.
+     */
+    void onIndexChanged();
+
+private:
+    /**
+     * Updates the result list for the current query.
+     */
+    void updateResults();
+
+    /** The dialog UI. */
+    Ui::QuickOpenDialog *ui;
+};
+
+#endif // QUICKOPENDIALOG_H
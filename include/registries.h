@@ -0,0 +1,16 @@
+#ifndef REGISTRIES_H
+#define REGISTRIES_H
+
+/**
+ * Initializes the available encodings, color schemes and languages, in the
+ * order that the first editor window needs them. They are otherwise
+ * initialized on first use. It can be called from any thread.
+ */
+void initializeRegistries();
+
+/**
+ * Cleans up the available encodings, color schemes and languages.
+ */
+void cleanupRegistries();
+
+#endif // REGISTRIES_H
@@ -0,0 +1,94 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+
+/**
+ * Lets a running editor open the files of later launches, so that they do not
+ * pay for a full startup. The running editor listens on a local socket, and a
+ * new launch forwards its files and working directory to it and exits.
+ *
+ * A message is a 32 bit length followed by the working directory and the
+ * file names, serialized with QDataStream. The running editor answers with a
+ * single byte once it has accepted the files.
+ */
+class SingleInstance : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * Creates the single instance server, which does not listen yet.
+     *
+     * @param parent The parent object.
+     */
+    explicit SingleInstance(QObject *parent = 0);
+
+    /**
+     * Returns true if the single instance mode is enabled in the settings,
+     * with the single.instance key. It can be called before the application
+     * is created.
+     *
+     * @return true if the single instance mode is enabled.
+     */
+    static bool enabledInSettings();
+
+    /**
+     * Sends files to the running editor. A QCoreApplication must exist.
+     *
+     * @param fileNames The names of the files to open, relative to the working
+     * directory. If it is empty, the running editor opens an empty window.
+     * @param workingDir The working directory.
+     * @return true if a running editor has accepted the files.
+     */
+    static bool forward(const QStringList &fileNames, const QString &workingDir);
+
+    /**
+     * Starts listening for files sent by later launches.
+     *
+     * @return true if the server listens, false if another editor does.
+     */
+    bool listen();
+
+signals:
+    /**
+     * Emitted when a later launch has sent files to open.
+     *
+     * @param fileNames The names of the files to open, relative to the
+     * working directory.
+     * @param workingDir The working directory of the launch.
+     */
+    void filesReceived(const QStringList &fileNames, const QString &workingDir);
+
+private slots:
+    /**
+     * Called when a later launch connects.
+     */
+    void onNewConnection();
+
+    /**
+     * Called when a connected launch has sent data.
+     */
+    void onReadyRead();
+
+private:
+    /**
+     * Reads the message of a launch once it is complete, and acknowledges it.
+     *
+     * @param socket The connection to the launch.
+     */
+    void readMessage(QLocalSocket *socket);
+
+    /**
+     * Returns the name of the local socket, which is different for each user.
+     */
+    static QString serverName();
+
+    /** The server. */
+    QLocalServer *server;
+};
+
+#endif // SINGLEINSTANCE_H
@@ -135,6 +135,22 @@ public:
      */
     void setEolFilled(bool eolFilled);
 
+    /**
+     * Compares two styles.
+     *
+     * @param other The other style.
+     * @return true if all the properties of the styles are equal.
+     */
+    bool operator==(const StyleInfo &other) const;
+
+    /**
+     * Compares two styles.
+     *
+     * @param other The other style.
+     * @return true if any property of the styles is different.
+     */
+    bool operator!=(const StyleInfo &other) const;
+
 private:
     /** Holds the foreground color. */
     int m_foregroundColor;
@@ -0,0 +1,187 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <regex>
+
+/**
+ * Searches UTF-8 text with the same semantics as the Scintilla search flags,
+ * without going through the editor component. Since it works on plain memory,
+ * it can be used on worker threads over a snapshot of a document. The object
+ * is immutable after construction and can be shared between threads.
+ */
+class TextSearch {
+public:
+    /**
+     * A match, as a range of byte positions.
+     */
+    struct Match {
+        /** The position of the first byte of the match. */
+        qint64 start;
+
+        /** The position after the last byte of the match. */
+        qint64 end;
+    };
+
+    /**
+     * Creates the search.
+     *
+     * @param findText The text to search for.
+     * @param flags The Scintilla search flags.
+     */
+    TextSearch(const QString &findText, int flags);
+
+    /**
+     * Returns the text to search for.
+     *
+     * @return The text to search for.
+     */
+    QString findText() const;
+
+    /**
+     * Returns the Scintilla search flags.
+     *
+     * @return The Scintilla search flags.
+     */
+    int flags() const;
+
+    /**
+     * Returns true if the search can be performed. The search is invalid if
+     * the text is empty or if the regular expression cannot be compiled.
+     *
+     * @return true if the search can be performed.
+     */
+    bool isValid() const;
+
+    /**
+     * Returns true if a match can never span more than one line.
+     *
+     * @return true if a match can never span more than one line.
+     */
+    bool isLineBounded() const;
+
+    /**
+     * Returns true if the search finds exactly the same matches as Scintilla.
+     * This is not the case for case insensitive searches of non ASCII text,
+     * since only ASCII characters are folded, nor for C++11 regular
+     * expressions that can match across lines.
+     *
+     * @return true if the search finds exactly the same matches as Scintilla.
+     */
+    bool isExact() const;
+
+    /**
+     * Finds all the non overlapping matches that start in a range of the
+     * text. Regular expressions are matched line by line, a range that starts
+     * inside a line is searched from there, as the end of the line.
+     *
+     * @param text The text.
+     * @param length The length of the text.
+     * @param begin The position where the search starts.
+     * @param end The position where the search ends.
+     * @return The matches, in document order.
+     */
+    QVector<Match> findAll(const char *text, qint64 length, qint64 begin, qint64 end) const;
+
+    /**
+     * Finds all the non overlapping matches in the text. If matches cannot
+     * span lines, the text is split at line boundaries into one slice per
+     * thread, and the slices are searched in parallel.
+     *
+     * @param text The text.
+     * @param length The length of the text.
+     * @param threadCount The number of threads, or 0 to use one thread per
+     * core.
+     * @return The matches, in document order.
+     */
+    QVector<Match> findAllParallel(const char *text, qint64 length, int threadCount = 0) const;
+
+    /**
+     * Finds the match that starts at a position, the one that a search from
+     * the position would find first. Regular expressions are matched up to
+     * the end of the line.
+     *
+     * @param text The text.
+     * @param length The length of the text.
+     * @param position The position.
+     * @param match Output parameter, set to the match if one was found.
+     * @return true if a match starts at the position.
+     */
+    bool matchAt(const char *text, qint64 length, qint64 position, Match *match) const;
+
+    /**
+     * Expands the tagged regions of a regular expression replacement text for
+     * a match. \\0 is replaced by the whole match, \\1 to \\9 by the tagged
+     * regions, and the escape sequences supported by Scintilla by the
+     * corresponding characters. For literal searches, the text is returned
+     * unchanged.
+     *
+     * @param text The text.
+     * @param length The length of the text.
+     * @param match A match found in the text.
+     * @param replaceText The UTF-8 replacement text.
+     * @return The expanded replacement text.
+     */
+    QByteArray expandReplacement(const char *text, qint64 length, const Match &match,
+            const QByteArray &replaceText) const;
+
+    /**
+     * Converts a regular expression from the Scintilla syntax to the
+     * ECMAScript syntax.
+     *
+     * @param pattern The regular expression.
+     * @param flags The Scintilla search flags.
+     * @return The ECMAScript regular expression.
+     */
+    static QByteArray toEcmaScript(const QByteArray &pattern, int flags);
+
+private:
+    /**
+     * Finds the literal matches in a range of the text.
+     */
+    void findLiteral(const char *text, qint64 length, qint64 begin, qint64 end,
+            QVector<Match> *matches) const;
+
+    /**
+     * Finds the regular expression matches in a single line of the text.
+     */
+    void findInLine(const char *text, qint64 lineStart, qint64 lineEnd,
+            QVector<Match> *matches) const;
+
+    /**
+     * Returns true if the match satisfies the whole word and word start flags.
+     */
+    bool acceptMatch(const char *text, qint64 length, qint64 start, qint64 end) const;
+
+    /** The text to search for. */
+    QString m_findText;
+
+    /** The search flags. */
+    int m_flags;
+
+    /** The UTF-8 pattern. For case insensitive searches it is folded to lower case. */
+    QByteArray m_pattern;
+
+    /** true if the search is valid. */
+    bool m_valid;
+
+    /** true if a match can never span more than one line. */
+    bool m_lineBounded;
+
+    /** true if the search finds exactly the same matches as Scintilla. */
+    bool m_exact;
+
+    /** Maps each byte to the byte it is compared as. */
+    unsigned char m_fold[256];
+
+    /** The Horspool skip table of the literal pattern. */
+    qint64 m_skip[256];
+
+    /** The compiled regular expression. */
+    std::regex m_regex;
+};
+
+#endif // TEXTSEARCH_H
@@ -0,0 +1,115 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef ENABLE_STARTUP_TRACING
+
+#include <QtGlobal>
+
+class QWidget;
+
+/**
+ * Records the startup of the editor, and writes it as a Chrome trace event
+ * file that can be opened in chrome://tracing or Perfetto. Tracing is only
+ * compiled in when the ENABLE_STARTUP_TRACING option is set, and it is only
+ * active when the editor is started with --trace-startup[=file], or when the
+ * EDITOR_TRACE_STARTUP environment variable is set to the file name or to 1.
+ *
+ * The code should use the TRACE_ macros, which compile to nothing when
+ * tracing is disabled.
+ */
+class Trace {
+public:
+    /**
+     * An event that lasts from its construction to its destruction.
+     */
+    class Scope {
+    public:
+        /**
+         * Starts the event.
+         *
+         * @param name The name of the event, which must be a literal.
+         */
+        explicit Scope(const char *name);
+
+        /**
+         * Ends the event.
+         */
+        ~Scope();
+
+    private:
+        /** The name of the event. */
+        const char *m_name;
+
+        /** The start of the event, in microseconds. */
+        qint64 m_start;
+    };
+
+    /**
+     * Activates the tracing if it is requested in the command line or the
+     * environment. The tracing arguments are removed from the command line.
+     *
+     * @param argc The argument count, updated if arguments are removed.
+     * @param argv The arguments.
+     */
+    static void start(int &argc, char *argv[]);
+
+    /**
+     * Records the start of an event that is not bound to a scope.
+     *
+     * @param name The name of the event, which must be a literal.
+     */
+    static void begin(const char *name);
+
+    /**
+     * Records the end of an event started with begin().
+     *
+     * @param name The name of the event, which must be a literal.
+     */
+    static void end(const char *name);
+
+    /**
+     * Records an event without duration.
+     *
+     * @param name The name of the event, which must be a literal.
+     */
+    static void instant(const char *name);
+
+    /**
+     * Records the first time that a widget is painted, and writes the trace
+     * file once the paint is done.
+     *
+     * @param widget The widget.
+     */
+    static void watchFirstPaint(QWidget *widget);
+
+    /**
+     * Writes the trace file, if it has not been written yet. No events are
+     * recorded afterwards.
+     */
+    static void finish();
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#define TRACE_START(argc, argv) Trace::start(argc, argv)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_BEGIN(name) Trace::begin(name)
+#define TRACE_END(name) Trace::end(name)
+#define TRACE_INSTANT(name) Trace::instant(name)
+#define TRACE_FIRST_PAINT(widget) Trace::watchFirstPaint(widget)
+#define TRACE_FINISH() Trace::finish()
+
+#else
+
+#define TRACE_START(argc, argv) ((void) 0)
+#define TRACE_SCOPE(name) ((void) 0)
+#define TRACE_BEGIN(name) ((void) 0)
+#define TRACE_END(name) ((void) 0)
+#define TRACE_INSTANT(name) ((void) 0)
+#define TRACE_FIRST_PAINT(widget) ((void) 0)
+#define TRACE_FINISH() ((void) 0)
+
+#endif // ENABLE_STARTUP_TRACING
+
+#endif // TRACE_H
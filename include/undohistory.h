@@ -0,0 +1,207 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+class QTemporaryFile;
+
+/**
+ * The part of the undo history of a document that has been moved out of
+ * Scintilla, in order to bound the memory it uses.
+ *
+ * Scintilla can only discard its whole undo history, so the steps that can be
+ * undone are mirrored from the modification notifications as they happen.
+ * Only what undo needs is kept: the position and length of the inserted text,
+ * and the deleted text. Consecutive insertions and deletions, such as typing,
+ * are coalesced. When the history of Scintilla, along with this one, goes
+ * over the budget, the mirrored steps are compressed into a block and
+ * Scintilla's history is discarded. When the compressed blocks go over their
+ * share of the budget, the oldest ones are spilled to a temporary file.
+ *
+ * The stored steps are undone in reverse order once Scintilla cannot undo any
+ * more. They cannot be redone.
+ *
+ * The history can be saved to a file, with the content hash of the text it
+ * applies to, and loaded back in a later session.
+ */
+class UndoHistory {
+public:
+    /**
+     * A modification of the document.
+     */
+    struct Action {
+        /** true for an insertion, false for a deletion. */
+        bool insert;
+
+        /** The position of the modification. */
+        qint64 position;
+
+        /** The length of the modification. */
+        qint64 length;
+
+        /** The deleted text, empty for an insertion. */
+        QByteArray text;
+    };
+
+    /** The actions of an undo step, in the order they were performed. */
+    typedef QVector<Action> Step;
+
+    /**
+     * Creates an empty history.
+     */
+    UndoHistory();
+
+    /**
+     * Destructor for the history, removes the temporary file.
+     */
+    ~UndoHistory();
+
+    /**
+     * Records a modification of the document.
+     *
+     * @param type The Scintilla modification flags.
+     * @param position The position of the modification.
+     * @param length The length of the modification.
+     * @param text The inserted or deleted text.
+     */
+    void record(int type, qint64 position, qint64 length, const QByteArray &text);
+
+    /**
+     * Forgets the steps mirrored from Scintilla, when its undo history has
+     * been discarded without compacting it.
+     */
+    void discardRecent();
+
+    /**
+     * Forgets the whole history.
+     */
+    void clear();
+
+    /**
+     * Moves the steps mirrored from Scintilla to the store. The caller then
+     * discards the undo history of Scintilla.
+     *
+     * @param budget The bytes of compressed steps that are kept in memory,
+     * the older ones are spilled to the temporary file.
+     */
+    void compact(qint64 budget);
+
+    /**
+     * Returns true if there are stored steps to undo.
+     *
+     * @return true if there are stored steps to undo.
+     */
+    bool canUndo() const;
+
+    /**
+     * Removes the most recent stored step. It reads and decompresses a block
+     * when needed.
+     *
+     * @return The step, empty if there are none.
+     */
+    Step takeStep();
+
+    /**
+     * Writes all the steps to a file, as a compressed log.
+     *
+     * @param fileName The name of the file.
+     * @param path The path of the document, checked when the file is loaded.
+     * @param contentHash The hash of the text that the steps apply to.
+     * @return true if there were steps and they have been written.
+     */
+    bool save(const QString &fileName, const QString &path, const QByteArray &contentHash);
+
+    /**
+     * Reads the steps written by save(), which come before the steps already
+     * in the history.
+     *
+     * @param fileName The name of the file.
+     * @param path The path of the document.
+     * @param contentHash The hash of the text of the document when it was
+     * read from its file.
+     * @return true if the steps have been read, false if the file cannot be
+     * read, or if it is for another path or another text.
+     */
+    bool load(const QString &fileName, const QString &path, const QByteArray &contentHash);
+
+    /**
+     * Returns the bytes of the history kept in memory.
+     *
+     * @return The bytes kept in memory.
+     */
+    qint64 memoryBytes() const;
+
+    /**
+     * Returns the bytes of the history spilled to the temporary file.
+     *
+     * @return The bytes spilled to the file.
+     */
+    qint64 spilledBytes() const;
+
+private:
+    /**
+     * A group of compressed steps.
+     */
+    struct Block {
+        /** The compressed steps, empty if the block has been spilled. */
+        QByteArray data;
+
+        /** The offset of the block in the temporary file, or -1 if it is in memory. */
+        qint64 offset;
+
+        /** The size of the compressed steps. */
+        qint64 size;
+    };
+
+    /**
+     * Returns the bytes that an action takes in memory.
+     */
+    static qint64 actionBytes(const Action &action);
+
+    /**
+     * Reads and decompresses the steps of a block.
+     *
+     * @param block The block.
+     * @return The steps.
+     */
+    QList<Step> readBlock(const Block &block) const;
+
+    /**
+     * Writes the oldest blocks that are in memory to the temporary file,
+     * until the blocks in memory fit in the budget.
+     *
+     * @param budget The bytes of compressed steps kept in memory.
+     */
+    void spill(qint64 budget);
+
+    /** The steps that Scintilla can undo, in order. */
+    QList<Step> m_recent;
+
+    /** The steps that Scintilla can redo, the last one is redone first. */
+    QList<Step> m_redo;
+
+    /** The bytes of the mirrored steps. */
+    qint64 m_recentBytes;
+
+    /** The stored blocks, from the oldest to the most recent. */
+    QList<Block> m_blocks;
+
+    /** The bytes of the blocks that are in memory. */
+    qint64 m_blockBytes;
+
+    /** The steps of the block being undone. */
+    QList<Step> m_loaded;
+
+    /** The bytes of the steps of the block being undone. */
+    qint64 m_loadedBytes;
+
+    /** The bytes of the blocks in the temporary file, which may also hold the ones already read back. */
+    qint64 m_spilledBytes;
+
+    /** The file of the spilled blocks, created when needed. */
+    QTemporaryFile *m_file;
+};
+
+#endif // UNDOHISTORY_H
@@ -2,6 +2,13 @@
 #define UTIL_H
 
 #include <QColor>
+#include <QLoggingCategory>
+
+/**
+ * The logging category for the time spent handling UI updates. Disabled by
+ * default, enable it with QT_LOGGING_RULES="editor.ui.debug=true".
+ */
+Q_DECLARE_LOGGING_CATEGORY(editorUi)
 
 /**
  * Converts a hexademical representation of a color to the color format
@@ -12,4 +19,22 @@
  */
 int convertColor(const QString& colorStr) ;
 
+/**
+ * Returns the directory that holds the user definitions of languages,
+ * encodings and color schemes, which override the built-in ones. It is
+ * available during static initialization, before the application is created.
+ *
+ * @return The user configuration directory.
+ */
+QString userConfigDir();
+
+/**
+ * Replaces the user configuration directory, so that the registries do not
+ * depend on the definitions of the user, for instance in benchmarks. It must
+ * be called before the registries are initialized.
+ *
+ * @param dir The directory to use instead of the default one.
+ */
+void setUserConfigDir(const QString &dir);
+
 #endif // UTIL_H
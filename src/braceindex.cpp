@@ -0,0 +1,540 @@
+#include "braceindex.h"
+#include "buffer.h"
+#include "language.h"
+
+#include <algorithm>
+
+namespace {
+
+/**
+ * Inserted text larger than this number of bytes makes the index build itself
+ * again from the buffer, when it is next needed.
+ */
+const int MaxIncrementalLength = 1024 * 1024;
+
+}
+
+BraceIndex::Brackets::Brackets() : root(-1), seed(2463534242u) {
+}
+
+BraceIndex::BraceIndex(Buffer *buffer) : m_buffer(buffer), m_valid(false), m_revision(0) {
+}
+
+void BraceIndex::invalidate() {
+    m_valid = false;
+    ++m_revision;
+    for (int kind = 0; kind < KindCount; ++kind) {
+        m_brackets[kind] = Brackets();
+    }
+}
+
+void BraceIndex::textInserted(qint64 position, const QByteArray &text) {
+    if (!m_valid) {
+        return;
+    }
+    if (text.size() > MaxIncrementalLength) {
+        invalidate();
+        return;
+    }
+
+    // Move the brackets after the insertion point
+    int before[KindCount];
+    int after[KindCount];
+    for (int kind = 0; kind < KindCount; ++kind) {
+        split(m_brackets[kind], m_brackets[kind].root, position, &before[kind], &after[kind]);
+        offset(m_brackets[kind], after[kind], text.size());
+    }
+
+    // Add the inserted brackets, in order
+    for (int i = 0; i < text.size(); ++i) {
+        int kind = kindOf(text.at(i));
+        if (kind < 0) {
+            continue;
+        }
+        quint8 flags = (text.at(i) == '(' || text.at(i) == '[' || text.at(i) == '{') ? Open : 0;
+        if (isIgnoredAt(position + i)) {
+            flags |= Ignored;
+        }
+        before[kind] = merge(m_brackets[kind], before[kind], newNode(m_brackets[kind], position + i, flags));
+        ++m_revision;
+    }
+
+    for (int kind = 0; kind < KindCount; ++kind) {
+        m_brackets[kind].root = merge(m_brackets[kind], before[kind], after[kind]);
+    }
+}
+
+void BraceIndex::textDeleted(qint64 position, qint64 length) {
+    if (!m_valid) {
+        return;
+    }
+    for (int kind = 0; kind < KindCount; ++kind) {
+        Brackets &brackets = m_brackets[kind];
+        int before, deleted, after;
+        split(brackets, brackets.root, position, &before, &after);
+        split(brackets, after, position + length, &deleted, &after);
+        if (deleted != -1) {
+            freeSubtree(brackets, deleted);
+            ++m_revision;
+        }
+        offset(brackets, after, -length);
+        brackets.root = merge(brackets, before, after);
+    }
+}
+
+void BraceIndex::styleChanged(qint64 position, qint64 length) {
+    if (!m_valid) {
+        return;
+    }
+    for (int kind = 0; kind < KindCount; ++kind) {
+        updateIgnored(m_brackets[kind], m_brackets[kind].root, position, position + length);
+    }
+}
+
+bool BraceIndex::findMatch(qint64 position, qint64 *match) {
+    int kind = kindOf(m_buffer->charAt(position));
+    if (kind < 0) {
+        return false;
+    }
+    prepare();
+    const Brackets &brackets = m_brackets[kind];
+    int index = lowerBound(brackets, position);
+    if (index == count(brackets)) {
+        return false;
+    }
+    qint64 bracketPosition;
+    quint8 flags = brackets.nodes.at(nodeAt(brackets, index, &bracketPosition)).flags;
+    if (bracketPosition != position || (flags & Ignored)) {
+        return false;
+    }
+
+    if (flags & Open) {
+        // The depth goes back to the depth before the opening bracket right
+        // after the matching closing bracket.
+        int after = firstAtMost(brackets, index + 1, depthAt(brackets, index));
+        *match = after == -1 ? -1 : positionAt(brackets, after - 1);
+    } else {
+        // The matching opening bracket is the last one whose depth is lower
+        int open = lastAtMost(brackets, index, depthAt(brackets, index) - 1);
+        *match = open == -1 ? -1 : positionAt(brackets, open);
+    }
+
+    return true;
+}
+
+qint64 BraceIndex::enclosingBrace(qint64 position) {
+    prepare();
+    qint64 enclosing = -1;
+    for (int kind = 0; kind < KindCount; ++kind) {
+        const Brackets &brackets = m_brackets[kind];
+        int index = lowerBound(brackets, position);
+        int open = lastAtMost(brackets, index, depthAt(brackets, index) - 1);
+        if (open != -1) {
+            enclosing = std::max(enclosing, positionAt(brackets, open));
+        }
+    }
+
+    return enclosing;
+}
+
+QVector<BraceIndex::Level> BraceIndex::levels(qint64 start, qint64 end) {
+    prepare();
+    QVector<Level> result;
+    for (int kind = 0; kind < KindCount; ++kind) {
+        collectLevels(m_brackets[kind], m_brackets[kind].root, 0, 0, start, end, &result);
+    }
+
+    return result;
+}
+
+int BraceIndex::revision() const {
+    return m_revision;
+}
+
+int BraceIndex::kindOf(char c) {
+    switch (c) {
+    case '(':
+    case ')':
+        return 0;
+    case '[':
+    case ']':
+        return 1;
+    case '{':
+    case '}':
+        return 2;
+    default:
+        return -1;
+    }
+}
+
+void BraceIndex::build() {
+    invalidate();
+    const char *text = reinterpret_cast<const char*>(m_buffer->characterPointer());
+    qint64 length = m_buffer->length();
+    for (qint64 i = 0; i < length; ++i) {
+        int kind = kindOf(text[i]);
+        if (kind >= 0) {
+            quint8 flags = (text[i] == '(' || text[i] == '[' || text[i] == '{') ? Open : 0;
+            if (isIgnoredAt(i)) {
+                flags |= Ignored;
+            }
+            newNode(m_brackets[kind], i, flags);
+        }
+    }
+
+    // The nodes are in order, build each treap in linear time: the right
+    // spine of the tree built so far is on the stack.
+    for (int kind = 0; kind < KindCount; ++kind) {
+        Brackets &brackets = m_brackets[kind];
+        QVector<int> spine;
+        for (int node = 0; node < brackets.nodes.size(); ++node) {
+            int last = -1;
+            while (!spine.isEmpty() && brackets.nodes.at(spine.last()).priority < brackets.nodes.at(node).priority) {
+                last = spine.takeLast();
+            }
+            brackets.nodes[node].left = last;
+            if (!spine.isEmpty()) {
+                brackets.nodes[spine.last()].right = node;
+            }
+            spine << node;
+        }
+        brackets.root = spine.isEmpty() ? -1 : spine.first();
+        updateSubtree(brackets, brackets.root);
+    }
+    m_valid = true;
+}
+
+void BraceIndex::prepare() {
+    if (!m_valid) {
+        build();
+    }
+}
+
+bool BraceIndex::isIgnoredAt(qint64 position) const {
+    const Language *language = m_buffer->language();
+
+    return language && language->isCommentOrStringStyle(m_buffer->styleAt(position));
+}
+
+bool BraceIndex::updateIgnored(Brackets &brackets, int node, qint64 start, qint64 end) {
+    if (node == -1) {
+        return false;
+    }
+    pushDown(brackets, node);
+    qint64 position = brackets.nodes.at(node).position;
+    bool changed = false;
+    if (position >= start) {
+        changed = updateIgnored(brackets, brackets.nodes.at(node).left, start, end);
+    }
+    if (position >= start && position < end &&
+            isIgnoredAt(position) != ((brackets.nodes.at(node).flags & Ignored) != 0)) {
+        brackets.nodes[node].flags ^= Ignored;
+        changed = true;
+        ++m_revision;
+    }
+    if (position < end && updateIgnored(brackets, brackets.nodes.at(node).right, start, end)) {
+        changed = true;
+    }
+    if (changed) {
+        update(brackets, node);
+    }
+
+    return changed;
+}
+
+int BraceIndex::newNode(Brackets &brackets, qint64 position, quint8 flags) {
+    // xorshift32, the priorities only need to be spread evenly
+    brackets.seed ^= brackets.seed << 13;
+    brackets.seed ^= brackets.seed >> 17;
+    brackets.seed ^= brackets.seed << 5;
+
+    Node node;
+    node.position = position;
+    node.offset = 0;
+    node.left = -1;
+    node.right = -1;
+    node.priority = brackets.seed;
+    node.flags = flags;
+    node.size = 1;
+    node.depthChange = depthChange(flags);
+    node.minDepth = 0;
+    if (brackets.freeNodes.isEmpty()) {
+        brackets.nodes << node;
+        return brackets.nodes.size() - 1;
+    }
+    int index = brackets.freeNodes.takeLast();
+    brackets.nodes[index] = node;
+
+    return index;
+}
+
+void BraceIndex::freeSubtree(Brackets &brackets, int node) {
+    if (node == -1) {
+        return;
+    }
+    freeSubtree(brackets, brackets.nodes.at(node).left);
+    freeSubtree(brackets, brackets.nodes.at(node).right);
+    brackets.freeNodes << node;
+}
+
+int BraceIndex::depthChange(quint8 flags) {
+    if (flags & Ignored) {
+        return 0;
+    }
+
+    return (flags & Open) ? 1 : -1;
+}
+
+void BraceIndex::update(Brackets &brackets, int node) {
+    Node &n = brackets.nodes[node];
+    int size = 1;
+    int before = 0;
+    int minDepth = 0;
+    if (n.left != -1) {
+        const Node &left = brackets.nodes.at(n.left);
+        size += left.size;
+        before = left.depthChange;
+        minDepth = std::min(left.minDepth, before);
+    }
+    int change = before + depthChange(n.flags);
+    if (n.right != -1) {
+        const Node &right = brackets.nodes.at(n.right);
+        size += right.size;
+        minDepth = std::min(minDepth, change + right.minDepth);
+        change += right.depthChange;
+    }
+    n.size = size;
+    n.depthChange = change;
+    n.minDepth = minDepth;
+}
+
+void BraceIndex::updateSubtree(Brackets &brackets, int node) {
+    if (node == -1) {
+        return;
+    }
+    updateSubtree(brackets, brackets.nodes.at(node).left);
+    updateSubtree(brackets, brackets.nodes.at(node).right);
+    update(brackets, node);
+}
+
+void BraceIndex::offset(Brackets &brackets, int node, qint64 delta) {
+    if (node != -1) {
+        brackets.nodes[node].position += delta;
+        brackets.nodes[node].offset += delta;
+    }
+}
+
+void BraceIndex::pushDown(Brackets &brackets, int node) {
+    qint64 delta = brackets.nodes.at(node).offset;
+    if (delta != 0) {
+        offset(brackets, brackets.nodes.at(node).left, delta);
+        offset(brackets, brackets.nodes.at(node).right, delta);
+        brackets.nodes[node].offset = 0;
+    }
+}
+
+void BraceIndex::split(Brackets &brackets, int node, qint64 position, int *left, int *right) {
+    if (node == -1) {
+        *left = -1;
+        *right = -1;
+        return;
+    }
+    pushDown(brackets, node);
+    int first, second;
+    if (brackets.nodes.at(node).position < position) {
+        split(brackets, brackets.nodes.at(node).right, position, &first, &second);
+        brackets.nodes[node].right = first;
+        *left = node;
+        *right = second;
+    } else {
+        split(brackets, brackets.nodes.at(node).left, position, &first, &second);
+        brackets.nodes[node].left = second;
+        *left = first;
+        *right = node;
+    }
+    update(brackets, node);
+}
+
+int BraceIndex::merge(Brackets &brackets, int left, int right) {
+    if (left == -1) {
+        return right;
+    } else if (right == -1) {
+        return left;
+    }
+
+    if (brackets.nodes.at(left).priority > brackets.nodes.at(right).priority) {
+        pushDown(brackets, left);
+        int merged = merge(brackets, brackets.nodes.at(left).right, right);
+        brackets.nodes[left].right = merged;
+        update(brackets, left);
+        return left;
+    }
+    pushDown(brackets, right);
+    int merged = merge(brackets, left, brackets.nodes.at(right).left);
+    brackets.nodes[right].left = merged;
+    update(brackets, right);
+
+    return right;
+}
+
+int BraceIndex::count(const Brackets &brackets) {
+    return brackets.root == -1 ? 0 : brackets.nodes.at(brackets.root).size;
+}
+
+int BraceIndex::nodeAt(const Brackets &brackets, int index, qint64 *position) {
+    qint64 pending = 0;
+    int node = brackets.root;
+    while (node != -1) {
+        const Node &n = brackets.nodes.at(node);
+        int leftSize = n.left == -1 ? 0 : brackets.nodes.at(n.left).size;
+        if (index == leftSize) {
+            break;
+        }
+        pending += n.offset;
+        if (index < leftSize) {
+            node = n.left;
+        } else {
+            index -= leftSize + 1;
+            node = n.right;
+        }
+    }
+    *position = brackets.nodes.at(node).position + pending;
+
+    return node;
+}
+
+qint64 BraceIndex::positionAt(const Brackets &brackets, int index) {
+    qint64 position;
+    nodeAt(brackets, index, &position);
+
+    return position;
+}
+
+int BraceIndex::lowerBound(const Brackets &brackets, qint64 position) {
+    qint64 pending = 0;
+    int index = 0;
+    int node = brackets.root;
+    while (node != -1) {
+        const Node &n = brackets.nodes.at(node);
+        if (n.position + pending < position) {
+            index += 1 + (n.left == -1 ? 0 : brackets.nodes.at(n.left).size);
+            node = n.right;
+        } else {
+            node = n.left;
+        }
+        pending += n.offset;
+    }
+
+    return index;
+}
+
+int BraceIndex::depthAt(const Brackets &brackets, int index) {
+    int depth = 0;
+    int node = brackets.root;
+    while (node != -1) {
+        const Node &n = brackets.nodes.at(node);
+        int leftSize = 0;
+        int leftChange = 0;
+        if (n.left != -1) {
+            leftSize = brackets.nodes.at(n.left).size;
+            leftChange = brackets.nodes.at(n.left).depthChange;
+        }
+        if (index < leftSize) {
+            node = n.left;
+        } else if (index == leftSize) {
+            return depth + leftChange;
+        } else {
+            depth += leftChange + depthChange(n.flags);
+            index -= leftSize + 1;
+            node = n.right;
+        }
+    }
+
+    return depth;
+}
+
+int BraceIndex::firstAtMost(const Brackets &brackets, int from, int value) {
+    int index = firstAtMost(brackets, brackets.root, 0, 0, from, value);
+    if (index == -1 && from <= count(brackets) && depthAt(brackets, count(brackets)) <= value) {
+        // The final depth
+        index = count(brackets);
+    }
+
+    return index;
+}
+
+int BraceIndex::firstAtMost(const Brackets &brackets, int node, int index, int depth, int from, int value) {
+    if (node == -1) {
+        return -1;
+    }
+    const Node &n = brackets.nodes.at(node);
+    if (index + n.size <= from || depth + n.minDepth > value) {
+        return -1;
+    }
+    int result = firstAtMost(brackets, n.left, index, depth, from, value);
+    if (result != -1) {
+        return result;
+    }
+    if (n.left != -1) {
+        index += brackets.nodes.at(n.left).size;
+        depth += brackets.nodes.at(n.left).depthChange;
+    }
+    if (index >= from && depth <= value) {
+        return index;
+    }
+
+    return firstAtMost(brackets, n.right, index + 1, depth + depthChange(n.flags), from, value);
+}
+
+int BraceIndex::lastAtMost(const Brackets &brackets, int before, int value) {
+    return lastAtMost(brackets, brackets.root, 0, 0, before, value);
+}
+
+int BraceIndex::lastAtMost(const Brackets &brackets, int node, int index, int depth, int before, int value) {
+    if (node == -1) {
+        return -1;
+    }
+    const Node &n = brackets.nodes.at(node);
+    if (index >= before || depth + n.minDepth > value) {
+        return -1;
+    }
+    int nodeIndex = index;
+    int nodeDepth = depth;
+    if (n.left != -1) {
+        nodeIndex += brackets.nodes.at(n.left).size;
+        nodeDepth += brackets.nodes.at(n.left).depthChange;
+    }
+    int result = lastAtMost(brackets, n.right, nodeIndex + 1, nodeDepth + depthChange(n.flags), before, value);
+    if (result != -1) {
+        return result;
+    }
+    if (nodeIndex < before && nodeDepth <= value) {
+        return nodeIndex;
+    }
+
+    return lastAtMost(brackets, n.left, index, depth, before, value);
+}
+
+void BraceIndex::collectLevels(const Brackets &brackets, int node, qint64 offset, int depth, qint64 start,
+        qint64 end, QVector<Level> *levels) {
+    if (node == -1) {
+        return;
+    }
+    const Node &n = brackets.nodes.at(node);
+    qint64 position = n.position + offset;
+    int nodeDepth = depth;
+    if (n.left != -1) {
+        nodeDepth += brackets.nodes.at(n.left).depthChange;
+    }
+    if (position >= start) {
+        collectLevels(brackets, n.left, offset + n.offset, depth, start, end, levels);
+    }
+    if (position >= start && position < end && !(n.flags & Ignored)) {
+        // A closing bracket has the depth after it, the same as its opening one
+        Level level = { position, (n.flags & Open) ? nodeDepth : nodeDepth - 1 };
+        *levels << level;
+    }
+    if (position < end) {
+        collectLevels(brackets, n.right, offset + n.offset, nodeDepth + depthChange(n.flags), start, end, levels);
+    }
+}
@@ -1,26 +1,111 @@
+#include "braceindex.h"
 #include "buffer.h"
 #include "configuration.h"
+#include "definitionwatcher.h"
+#include "document.h"
 #include "icondb.h"
 #include "language.h"
+#include "trace.h"
+#include "undohistory.h"
 #include "util.h"
 
 #include <SciLexer.h>
 
 #include <QBuffer>
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QDropEvent>
+#include <QElapsedTimer>
 #include <QFontDatabase>
+#include <QKeyEvent>
+#include <QStandardPaths>
+#include <QTemporaryFile>
 #include <QTextStream>
+#include <QTimer>
 #include <QUrl>
+#include <QtConcurrentRun>
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
-Buffer::Buffer(QWidget *parent) : ScintillaEdit(parent), m_language(0) {
+namespace {
+
+/** The maximum number of indicators used for the bracket pair colors. */
+const int MaxBracePairColors = 6;
+
+/** The bytes that Scintilla uses for each action of the undo history, besides its text. */
+const int UndoActionOverhead = 40;
+
+/** The interval between the checks for documents to hibernate, in milliseconds. */
+const int HibernationCheckInterval = 60 * 1000;
+
+/** The compressed text of a hibernated document above which it is written to a file, in bytes. */
+const int SpillThreshold = 4 * 1024 * 1024;
+
+/**
+ * Returns the file that keeps the undo history of a file between sessions.
+ *
+ * @param path The absolute path of the file.
+ * @return The name of the undo history file.
+ */
+QString undoHistoryFileName(const QString &path) {
+    QByteArray key = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/undo/" + key + ".undo";
+}
+
+/**
+ * Returns the hash of a text, which tells whether an undo history applies to
+ * it. It can be called from any thread.
+ *
+ * @param content The text.
+ * @return The hash.
+ */
+QByteArray hashContent(const QByteArray &content) {
+    return QCryptographicHash::hash(content, QCryptographicHash::Sha1);
+}
+
+/**
+ * Returns the style that a style table gives to a style number, with the
+ * properties that are not set replaced by the default style.
+ */
+StyleInfo resolveStyle(const StyleTable &table, int styleNumber, const StyleInfo &defaultStyle) {
+    StyleInfo base = defaultStyle;
+    if (styleNumber == 0 && table.lexerWhitespace && table.whitespaceForeground >= 0) {
+        base.setForegroundColor(table.whitespaceForeground);
+    }
+    if (!table.defined[styleNumber]) {
+        return base;
+    }
+    StyleInfo style = table.styles[styleNumber];
+    if (style.foregroundColor() < 0) {
+        style.setForegroundColor(base.foregroundColor());
+    }
+    if (style.backgroundColor() < 0) {
+        style.setBackgroundColor(base.backgroundColor());
+    }
+
+    return style;
+}
+
+}
+
+Buffer::Buffer(QWidget *parent) :
+        ScintillaEdit(parent), m_source(0), m_language(0), m_colorScheme(0), m_styleTable(0), m_modificationCounter(0), m_braceIndex(new BraceIndex(this)),
+        m_bracePairColorization(false), m_bracePairColorCount(0), m_colorizedStart(0), m_colorizedEnd(0),
+        m_colorizedRevision(-1), m_colorizedModification(0), m_compactionPending(false),
+        m_hibernationView(0), m_restoreWatcher(0) {
     // Use Unicode code page
     m_encoding = Encoding::fromName("UTF-8");
     setCodePage(SC_CP_UTF8);
 
+    // Hold a reference to the initial document, so that it survives when
+    // another one is shown
+    m_document = new Document(docPointer(), m_braceIndex);
+    m_document->m_new = false;
+    addRefDocument(m_document->m_pointer);
+    m_documents << m_document;
+
     // Load the initial state from the configuration
     loadConfiguration();
 
@@ -37,40 +122,436 @@ Buffer::Buffer(QWidget *parent) : ScintillaEdit(parent), m_language(0) {
     connect(this, SIGNAL(updateUi(int)), this, SLOT(onUpdateUi(int)));
     connect(this, SIGNAL(linesAdded(int)), this, SLOT(onLinesAdded(int)));
     connect(this, SIGNAL(marginClicked(int,int,int)), this, SLOT(onMarginClicked(int,int,int)));
+    connect(this, SIGNAL(modified(int,int,int,int,QByteArray,int,int,int)),
+            this, SLOT(onModified(int,int,int,int,QByteArray,int,int,int)));
+    connect(this, SIGNAL(savePointChanged(bool)), this, SLOT(onSavePointChanged(bool)));
+
+    // Apply the definitions again when they are edited
+    DefinitionWatcher *definitionWatcher = DefinitionWatcher::instance();
+    connect(definitionWatcher, SIGNAL(languageReloaded(const Language*)),
+            this, SLOT(onLanguageReloaded(const Language*)));
+    connect(definitionWatcher, SIGNAL(colorSchemeReloaded(const ColorScheme*)),
+            this, SLOT(onColorSchemeReloaded(const ColorScheme*)));
+
+    // Hibernate the documents that are not used
+    m_hibernationTimer = new QTimer(this);
+    m_hibernationTimer->setInterval(HibernationCheckInterval);
+    connect(m_hibernationTimer, SIGNAL(timeout()), this, SLOT(hibernateIdleDocuments()));
+    m_hibernationTimer->start();
+
+    buffers() << this;
 }
 
 Buffer::~Buffer() {
+    buffers().removeOne(this);
 
+    // Scintilla releases its own reference to the shown document
+    for (int i = 0; i < m_documents.size(); ++i) {
+        if (m_documents.at(i)->m_pointer) {
+            releaseDocument(m_documents.at(i)->m_pointer);
+        }
+    }
+    qDeleteAll(m_documents);
+    delete m_hibernationView;
 }
 
 void Buffer::clear() {
     // Clear the file name and the editor
     clearAll();
     setFileInfo(QFileInfo(""));
+    m_document->m_modifiedOutsideHistory = false;
     setSavePoint();
 }
 
+Document *Buffer::document() const {
+    return m_document;
+}
+
+Document *Buffer::newDocument() {
+    Document *document = new Document(createDocument(0, SC_DOCUMENTOPTION_DEFAULT), new BraceIndex(this));
+    document->m_encoding = Encoding::fromName("UTF-8");
+    m_documents << document;
+
+    return document;
+}
+
+void Buffer::setDocument(Document *document) {
+    if (document == m_document) {
+        return;
+    }
+
+    if (m_document->m_hibernated) {
+        // The shown document has not been restored yet, or it cannot be, it
+        // stays hibernated
+        if (m_restoreWatcher) {
+            m_restoreWatcher->disconnect(this);
+            m_restoreWatcher->deleteLater();
+            m_restoreWatcher = 0;
+        }
+        releaseDocument(m_document->m_pointer);
+        m_document->m_pointer = 0;
+        setReadOnly(false);
+        emit restoringChanged(false);
+    } else {
+        // Keep the state of the shown document. The bracket pair colors are
+        // indicators of the document, remove them so that they do not go stale.
+        clearBracePairColors();
+        m_document->m_modified = modify();
+        m_document->m_anchor = anchor();
+        m_document->m_currentPos = currentPos();
+        m_document->m_firstVisibleLine = firstVisibleLine();
+        m_document->m_xOffset = xOffset();
+        m_document->m_foldedLines.clear();
+        for (int line = contractedFoldNext(0); line != -1; line = contractedFoldNext(line + 1)) {
+            m_document->m_foldedLines << line;
+        }
+    }
+    m_document->m_fileInfo = m_fileInfo;
+    m_document->m_encoding = m_encoding;
+    m_document->m_language = m_language;
+    m_document->m_idleTimer.start();
+
+    // A hibernated document gets a new Scintilla document, filled when its
+    // text has been read back
+    bool restore = document->m_hibernated;
+    if (restore) {
+        document->m_pointer = createDocument(0, SC_DOCUMENTOPTION_DEFAULT);
+        document->m_new = true;
+    }
+
+    // Show the other document, its lexer and styles are kept by Scintilla
+    setDocPointer(document->m_pointer);
+    m_document = document;
+    m_fileInfo = document->m_fileInfo;
+    m_encoding = document->m_encoding;
+    m_language = document->m_language;
+    m_braceIndex = document->m_braceIndex;
+    ++m_modificationCounter;
+    if (document->m_new) {
+        document->m_new = false;
+        setUpDocument();
+    }
+    if (restore) {
+        applyLanguage();
+        startRestore();
+    } else {
+        restoreViewState();
+    }
+
+    // The styles and the margins are kept by the view, apply the ones of the document
+    setColorScheme(m_colorScheme);
+    setShowLineNumbers(showLineNumbers());
+
+    emit fileInfoChanged(m_fileInfo);
+    emit encodingChanged(m_encoding);
+    emit languageChanged(m_language);
+    emit documentChanged();
+}
+
+void Buffer::deleteDocument(Document *document) {
+    Q_ASSERT(document != m_document);
+    if (document->m_pointer) {
+        releaseDocument(document->m_pointer);
+    }
+    m_documents.removeOne(document);
+    delete document;
+}
+
+void Buffer::shareDocument(Buffer *buffer) {
+    m_source = buffer;
+    connect(buffer, SIGNAL(documentChanged()), this, SLOT(onSourceDocumentChanged()));
+    connect(buffer, SIGNAL(fileInfoChanged(QFileInfo)), this, SLOT(onSourceStateChanged()));
+    connect(buffer, SIGNAL(encodingChanged(const Encoding*)), this, SLOT(onSourceStateChanged()));
+    connect(buffer, SIGNAL(languageChanged(const Language*)), this, SLOT(onSourceStateChanged()));
+    connect(Configuration::instance(), SIGNAL(changed(QString)), this, SLOT(onConfigurationChanged()));
+
+    // The bracket pair colors are indicators of the shared document, they
+    // are drawn by the other buffer only so that the views do not clear the
+    // colors of each other
+    setBracePairColorization(false);
+
+    onSourceDocumentChanged();
+}
+
+void Buffer::onSourceDocumentChanged() {
+    // The settings that Scintilla keeps in the document have been applied by
+    // the other buffer
+    Document *previous = m_document;
+    Document *document = new Document(m_source->docPointer(), new BraceIndex(this));
+    addRefDocument(document->m_pointer);
+    document->m_new = false;
+    document->m_fileInfo = m_source->fileInfo();
+    document->m_encoding = m_source->encoding();
+    document->m_language = m_source->language();
+    m_documents << document;
+
+    setDocument(document);
+    deleteDocument(previous);
+}
+
+void Buffer::onSourceStateChanged() {
+    m_fileInfo = m_source->fileInfo();
+    m_encoding = m_source->encoding();
+    if (m_language != m_source->language()) {
+        // The other buffer has set the lexer of the document, only the styles
+        // of the view are left
+        m_language = m_source->language();
+        m_braceIndex->invalidate();
+        setColorScheme(m_colorScheme);
+    }
+}
+
+void Buffer::onConfigurationChanged() {
+    loadConfiguration();
+}
+
+QList<MemoryUsage> Buffer::memoryUsage() {
+    QList<MemoryUsage> usages;
+    for (int i = 0; i < m_documents.size(); ++i) {
+        Document *document = m_documents.at(i);
+        QFileInfo fileInfo = document == m_document ? m_fileInfo : document->m_fileInfo;
+
+        MemoryUsage usage;
+        usage.name = fileInfo.fileName().isEmpty() ? tr("Untitled") : fileInfo.fileName();
+        usage.shared = m_source != 0;
+        if (document == m_document) {
+            usage.textBytes = length();
+            usage.markers = countMarkers(this);
+            usage.indicators = countIndicators(this);
+        } else if (document->m_hibernated) {
+            // Only the compressed text of a modified document is kept
+            usage.cachedBytes = document->m_hibernatedText.size();
+            usage.markers = document->m_markerLines.size();
+        } else {
+            // Counted only when asked for, so that switching documents stays cheap
+            ScintillaEdit *view = hiddenView();
+            view->setDocPointer(document->m_pointer);
+            usage.textBytes = view->length();
+            usage.markers = countMarkers(view);
+            usage.indicators = countIndicators(view);
+            view->setDocPointer(0);
+        }
+        usage.styleBytes = usage.textBytes;
+        usage.undoBytes = document->m_undoBytes + document->m_undoHistory->memoryBytes();
+        usages << usage;
+    }
+
+    return usages;
+}
+
+QListIterator<Buffer*> Buffer::allBuffers() {
+    return QListIterator<Buffer*>(buffers());
+}
+
+bool Buffer::isModified(Document *document) const {
+    return (document == m_document ? modify() : document->m_modified) || document->m_modifiedOutsideHistory;
+}
+
+bool Buffer::isModified() const {
+    // The undo steps of a shared document are kept by the buffer that owns it
+    return m_source ? m_source->isModified() : isModified(m_document);
+}
+
+void Buffer::undo() {
+    if (canUndo()) {
+        ScintillaEdit::undo();
+        return;
+    } else if (m_source) {
+        m_source->undo();
+        return;
+    }
+
+    loadUndoHistory(m_document);
+    UndoHistory::Step step = m_document->m_undoHistory->takeStep();
+    if (step.isEmpty()) {
+        return;
+    }
+
+    // The steps that Scintilla could redo do not apply to the text once the
+    // stored step is undone
+    emptyUndoBuffer();
+    m_document->m_undoHistory->discardRecent();
+    m_document->m_undoBytes = 0;
+    bool modified = isModified();
+    m_document->m_modifiedOutsideHistory = true;
+
+    // Undo the actions in reverse order, without recording them
+    setUndoCollection(false);
+    for (int i = step.size() - 1; i >= 0; --i) {
+        const UndoHistory::Action &action = step.at(i);
+        if (action.insert) {
+            deleteRange(action.position, action.length);
+        } else {
+            insertText(action.position, action.text.constData());
+        }
+    }
+    setUndoCollection(true);
+    gotoPos(step.first().position);
+
+    if (!modified) {
+        emit modificationChanged(true);
+    }
+}
+
+bool Buffer::isUndoAvailable() const {
+    if (canUndo()) {
+        return true;
+    } else if (m_source) {
+        return m_source->isUndoAvailable();
+    }
+
+    return m_document->m_persistedHistory || m_document->m_undoHistory->canUndo();
+}
+
+void Buffer::emptyUndoHistory() {
+    emptyUndoBuffer();
+    m_document->m_undoBytes = 0;
+    m_document->m_undoHistory->clear();
+    m_document->m_persistedHistory = false;
+}
+
 bool Buffer::open(const QString &fileName) {
+    TRACE_SCOPE("Buffer::open");
+
+    bool ok;
+    QByteArray content = readFile(fileName, m_encoding->name(), &ok);
+    if (!ok) {
+        return false;
+    }
+    setFileContent(fileName, content);
+
+    return true;
+}
+
+QByteArray Buffer::readFile(const QString &fileName, const QByteArray &encoding, bool *ok) {
     // Open the file
     QFile file(fileName);
     if (!file.open(QIODevice::ReadOnly)) {
-        return false;
+        *ok = false;
+        return QByteArray();
     }
     QTextStream input(&file);
-    input.setCodec(m_encoding->name());
+    input.setCodec(encoding);
     QString content = input.readAll();
-    setText(content.toUtf8());
     file.close();
+    *ok = true;
+
+    return content.toUtf8();
+}
+
+void Buffer::setFileContent(const QString &fileName, const QByteArray &content) {
+    if (m_restoreWatcher) {
+        completeRestore();
+    }
+    if (m_document->m_hibernated) {
+        // The text could not be read back, it is replaced
+        endHibernation(m_document);
+        setReadOnly(false);
+    }
+    // The text is replaced, keep the undo history of the previous one
+    saveUndoHistory(m_document);
+    setText(content);
 
     // File opened succesfully
     setFileInfo(QFileInfo(fileName));
-    emptyUndoBuffer();
+    if (!m_language) {
+        // The name does not tell the language, try the contents
+        setLanguage(Language::fromContent(m_fileInfo, content));
+    }
+    emptyUndoHistory();
+    m_document->m_modifiedOutsideHistory = false;
     setSavePoint();
 
-    return true;
+    // The history of a previous session is loaded on the first undo that
+    // needs it, only the hash of the text is computed now, in the background
+    m_document->m_persistedHistory = Configuration::instance()->persistUndoHistory() &&
+            QFile::exists(undoHistoryFileName(m_fileInfo.absoluteFilePath()));
+    if (m_document->m_persistedHistory) {
+        m_document->m_contentHash = QtConcurrent::run(&hashContent, content);
+    }
+}
+
+void Buffer::saveUndoHistory(Document *document) {
+    QFileInfo fileInfo = document == m_document ? m_fileInfo : document->m_fileInfo;
+    if (!Configuration::instance()->persistUndoHistory() || m_source || fileInfo.filePath().isEmpty() ||
+            isModified(document)) {
+        return;
+    }
+    if (document == m_document && m_restoreWatcher) {
+        completeRestore();
+    }
+
+    // The steps of the previous sessions come first
+    loadUndoHistory(document);
+    QString path = fileInfo.absoluteFilePath();
+    QString fileName = undoHistoryFileName(path);
+
+    // The file of a hibernated document is read again for the hash, the steps
+    // do not apply to it if it has changed since
+    bool ok = !document->m_hibernated || !document->m_hibernatedText.isEmpty() || document->m_spillFile ||
+            QFileInfo(path).lastModified() == document->m_fileModified;
+    QByteArray text;
+    if (ok) {
+        text = documentText(document, &ok);
+    }
+    if (!ok || !document->m_undoHistory->save(fileName, path, hashContent(text))) {
+        QFile::remove(fileName);
+    }
+}
+
+void Buffer::loadUndoHistory(Document *document) {
+    if (!document->m_persistedHistory) {
+        return;
+    }
+    document->m_persistedHistory = false;
+
+    QFileInfo fileInfo = document == m_document ? m_fileInfo : document->m_fileInfo;
+    QString path = fileInfo.absoluteFilePath();
+    QString fileName = undoHistoryFileName(path);
+    if (!document->m_undoHistory->load(fileName, path, document->m_contentHash.result())) {
+        // The file has changed since the history was saved
+        QFile::remove(fileName);
+    }
+}
+
+QByteArray Buffer::documentText(Document *document, bool *ok) {
+    *ok = true;
+    if (document->m_hibernated) {
+        // Including the shown document, when it cannot be restored
+        QPair<bool, QByteArray> text = readHibernated(document->m_fileInfo.filePath(), document->m_encoding->name(),
+                document->m_hibernatedText, document->m_spillFile ? document->m_spillFile->fileName() : QString());
+        *ok = text.first;
+        return text.second;
+    } else if (document == m_document) {
+        return textRange(0, length());
+    }
+
+    ScintillaEdit *view = hiddenView();
+    view->setDocPointer(document->m_pointer);
+    QByteArray text = view->textRange(0, view->length());
+    view->setDocPointer(0);
+
+    return text;
+}
+
+ScintillaEdit *Buffer::hiddenView() {
+    if (!m_hibernationView) {
+        // It is never shown, it only reads the documents
+        m_hibernationView = new ScintillaEdit();
+    }
+
+    return m_hibernationView;
 }
 
 bool Buffer::save(const QString &fileName) {
+    if (m_restoreWatcher) {
+        completeRestore();
+    }
+    if (m_document->m_hibernated) {
+        // The text could not be read back, it would overwrite the file
+        return false;
+    }
+
     // Save the file
     QFile file(fileName);
     if (!file.open(QIODevice::WriteOnly)) {
@@ -87,6 +568,7 @@ bool Buffer::save(const QString &fileName) {
 
     // File saved
     setFileInfo(QFileInfo(fileName));
+    m_document->m_modifiedOutsideHistory = false;
     setSavePoint();
 
     return true;
@@ -97,12 +579,17 @@ QFileInfo Buffer::fileInfo() const {
 }
 
 void Buffer::setColorScheme(const ColorScheme *colorScheme) {
+    m_colorScheme = colorScheme;
+    const StyleTable &table = colorScheme->styleTable(m_language ? m_language->langId() : QString());
+
     // Set the common features of all styles.
-    if (colorScheme->foreground() != -1) {
-        styleSetFore(STYLE_DEFAULT, colorScheme->foreground());
+    bool clearStyles = !m_styleTable || m_styleTable->foreground != table.foreground ||
+            m_styleTable->background != table.background;
+    if (table.foreground != -1) {
+        styleSetFore(STYLE_DEFAULT, table.foreground);
     }
-    if (colorScheme->background() != -1) {
-        styleSetBack(STYLE_DEFAULT, colorScheme->background());
+    if (table.background != -1) {
+        styleSetBack(STYLE_DEFAULT, table.background);
     }
     if (colorScheme->caret() != -1) {
         setCaretFore(colorScheme->caret());
@@ -116,23 +603,44 @@ void Buffer::setColorScheme(const ColorScheme *colorScheme) {
         setSelBack(true, colorScheme->selection());
     }
 
-    // Copy common features of all styles.
-    styleClearAll();
+    // Copy common features of all styles, only when they have changed.
+    if (clearStyles) {
+        styleClearAll();
+    }
 
-    // Set styles for the current language.
-    if (m_language) {
-        // Set the foreground of whitespace when there is no style defined by the lexer.
+    // The whitespace is colored by the lexer whitespace style when there is a language.
+    if (table.lexerWhitespace) {
         setWhitespaceFore(false, 0);
-        styleSetFore(0, colorScheme->whitespaceForeground());
-        // Set up the lexer styles
-        QHash<int, StyleInfo> styles = colorScheme->stylesForLanguage(m_language->langId());
-        QHashIterator<int, StyleInfo> styleIter(styles);
-        while (styleIter.hasNext()) {
-            styleIter.next();
-            applyStyle(styleIter.key(), styleIter.value());
-        }
     } else {
-        setWhitespaceFore(true, colorScheme->whitespaceForeground());
+        setWhitespaceFore(true, table.whitespaceForeground);
+    }
+
+    // Set the styles that differ from the ones currently applied.
+    StyleInfo defaultStyle(styleFore(STYLE_DEFAULT), styleBack(STYLE_DEFAULT), styleBold(STYLE_DEFAULT),
+            styleItalic(STYLE_DEFAULT), styleUnderline(STYLE_DEFAULT), styleEOLFilled(STYLE_DEFAULT));
+    for (int i = 0; i < StyleTable::StyleCount; ++i) {
+        if (i == STYLE_DEFAULT) {
+            continue;
+        }
+        StyleInfo style = resolveStyle(table, i, defaultStyle);
+        StyleInfo previous = clearStyles ? defaultStyle : resolveStyle(*m_styleTable, i, defaultStyle);
+        if (style != previous) {
+            applyStyle(i, style, previous);
+        }
+    }
+    m_styleTable = &table;
+
+    // Set up the indicators of the bracket pairs
+    clearBracePairColors();
+    QList<int> bracePairColors = colorScheme->bracePairColors();
+    m_bracePairColorCount = std::min(bracePairColors.size(), MaxBracePairColors);
+    for (int i = 0; i < m_bracePairColorCount; ++i) {
+        indicSetStyle(BracePair + i, INDIC_TEXTFORE);
+        indicSetFore(BracePair + i, bracePairColors.at(i));
+    }
+    m_colorizedRevision = -1;
+    if (m_bracePairColorization) {
+        colorizeBracePairs();
     }
 }
 
@@ -276,6 +784,10 @@ QFont Buffer::styleQFont(int style) const {
 }
 
 void Buffer::setStyleQFont(int style, const QFont& font) {
+    if (style == STYLE_DEFAULT) {
+        // The other styles must copy the new font the next time a color scheme is applied
+        m_styleTable = 0;
+    }
     styleSetFont(style, font.family().toLatin1());
     styleSetSize(style, font.pointSize());
     styleSetBold(style, font.bold());
@@ -312,6 +824,108 @@ bool Buffer::find(const QString& findText, int flags, bool forward, bool wrap, b
     return findPos != -1;
 }
 
+QVector<TextSearch::Match> Buffer::findAll(const QString& findText, int flags) {
+    QVector<TextSearch::Match> matches;
+    TextSearch search(findText, flags);
+    if (search.isValid() && search.isExact()) {
+        return search.findAllParallel(reinterpret_cast<const char*>(characterPointer()), length());
+    } else if (findText.isEmpty()) {
+        return matches;
+    }
+
+    // Let Scintilla perform the search sequentially
+    setSearchFlags(flags);
+    QByteArray findArray = findText.toUtf8();
+    sptr_t position = 0;
+    while (position <= length()) {
+        setTargetStart(position);
+        setTargetEnd(length());
+        if (searchInTarget(findArray.length(), findArray) == -1) {
+            break;
+        }
+        TextSearch::Match match = { targetStart(), targetEnd() };
+        matches << match;
+        if (match.end > match.start) {
+            position = match.end;
+        } else if (match.end < length()) {
+            position = positionAfter(match.end);
+        } else {
+            break;
+        }
+    }
+
+    return matches;
+}
+
+int Buffer::selectMatches(const QString& findText, int flags) {
+    QVector<TextSearch::Match> matches = findAll(findText, flags);
+    if (matches.isEmpty()) {
+        return 0;
+    }
+    // Allow typing in all the matches until the selection is collapsed
+    setMultipleSelection(true);
+    setAdditionalSelectionTyping(true);
+    setSelection(matches.first().end, matches.first().start);
+    for (int i = 1; i < matches.size(); ++i) {
+        addSelection(matches.at(i).end, matches.at(i).start);
+    }
+    setMainSelection(0);
+    scrollRange(matches.first().start, matches.first().end);
+
+    return matches.size();
+}
+
+int Buffer::replaceAll(const QString& findText, const QString& replaceText, int flags) {
+    QByteArray replaceArray = replaceText.toUtf8();
+    TextSearch search(findText, flags);
+    if (!search.isValid() || !search.isExact()) {
+        // Replace the matches found by Scintilla one by one
+        int count = 0;
+        beginUndoAction();
+        setCurrentPos(0);
+        setAnchor(0);
+        while (find(findText, flags, true, false, NULL)) {
+            if (flags & SCFIND_REGEXP) {
+                replaceTargetRE(replaceArray.length(), replaceArray);
+            } else {
+                replaceTarget(replaceArray.length(), replaceArray);
+            }
+            ++count;
+        }
+        endUndoAction();
+
+        return count;
+    }
+
+    // Find all matches, and expand the replacements before the text changes
+    const char *text = reinterpret_cast<const char*>(characterPointer());
+    qint64 textLength = length();
+    QVector<TextSearch::Match> matches = search.findAllParallel(text, textLength);
+    QVector<QByteArray> replacements;
+    if (flags & SCFIND_REGEXP) {
+        replacements.reserve(matches.size());
+        for (int i = 0; i < matches.size(); ++i) {
+            replacements << search.expandReplacement(text, textLength, matches.at(i), replaceArray);
+        }
+    }
+
+    // Replace from the end, so that the positions of the remaining matches stay valid
+    beginUndoAction();
+    for (int i = matches.size() - 1; i >= 0; --i) {
+        const QByteArray &replacement = replacements.isEmpty() ? replaceArray : replacements.at(i);
+        setTargetStart(matches.at(i).start);
+        setTargetEnd(matches.at(i).end);
+        replaceTarget(replacement.length(), replacement);
+    }
+    endUndoAction();
+
+    return matches.size();
+}
+
+quint64 Buffer::modificationCounter() const {
+    return m_modificationCounter;
+}
+
 void Buffer::toggleBookmark(int line) {
     if (line < 0) {
         line = lineFromPosition(currentPos());
@@ -350,7 +964,42 @@ void Buffer::gotoBookmark(bool next) {
     }
 }
 
+void Buffer::gotoEnclosingBrace() {
+    qint64 position = m_braceIndex->enclosingBrace(currentPos());
+    if (position != -1) {
+        gotoPos(position);
+    }
+}
+
+bool Buffer::bracePairColorization() const {
+    return m_bracePairColorization;
+}
+
+void Buffer::setBracePairColorization(bool bracePairColorization) {
+    m_bracePairColorization = bracePairColorization;
+    if (bracePairColorization) {
+        m_colorizedRevision = -1;
+        colorizeBracePairs();
+    } else {
+        clearBracePairColors();
+    }
+}
+
 void Buffer::onUpdateUi(int updated) {
+    QElapsedTimer timer;
+    timer.start();
+    if (m_bracePairColorization && (updated & (SC_UPDATE_CONTENT | SC_UPDATE_V_SCROLL))) {
+        colorizeBracePairs();
+    }
+    // Scrolling does not move the caret, the braces stay the same
+    if (!(updated & (SC_UPDATE_CONTENT | SC_UPDATE_SELECTION))) {
+        return;
+    }
+    // The multiple selection is only enabled for the matches of find all
+    if (multipleSelection() && selections() == 1) {
+        setMultipleSelection(false);
+        setAdditionalSelectionTyping(false);
+    }
     if (m_braceHighlight && selectionEmpty()) {
         sptr_t position = currentPos();
         sptr_t braceStart = -1;
@@ -361,9 +1010,12 @@ void Buffer::onUpdateUi(int updated) {
             braceStart = position;
         }
         if (braceStart != -1) {
-            // Brace found
-            sptr_t braceEnd = braceMatch(braceStart, 0);
-            if (braceEnd > 0) {
+            // Brace found, brackets that are not indexed are matched by Scintilla
+            qint64 braceEnd;
+            if (!m_braceIndex->findMatch(braceStart, &braceEnd)) {
+                braceEnd = braceMatch(braceStart, 0);
+            }
+            if (braceEnd != -1) {
                 braceHighlight(braceStart, braceEnd);
             } else {
                 // Missing matching brace.
@@ -374,6 +1026,7 @@ void Buffer::onUpdateUi(int updated) {
             braceBadLight(-1);
         }
     }
+    qCDebug(editorUi) << "Buffer::onUpdateUi" << updated << timer.nsecsElapsed() / 1000 << "us";
 }
 
 void Buffer::onLinesAdded(int) {
@@ -390,6 +1043,237 @@ void Buffer::onMarginClicked(int position, int, int margin) {
     }
 }
 
+void Buffer::onModified(int type, int position, int length, int, const QByteArray &text, int, int, int) {
+    if (type & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) {
+        ++m_modificationCounter;
+    }
+    // Scintilla keeps the text of every action in the undo history, the
+    // buffer that owns a shared document accounts for it
+    if ((type & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) && !m_source && undoCollection()) {
+        Configuration *config = Configuration::instance();
+        qint64 budget = qint64(config->undoMemoryBudget()) * 1024 * 1024;
+        if (type & SC_PERFORMED_USER) {
+            m_document->m_undoBytes += length + UndoActionOverhead;
+        }
+        // Only the documents of tabs are hibernated, the shown one once
+        // another tab is selected
+        bool hibernation = config->hibernateTimeout() > 0 && config->tabbedInterface();
+        if (budget > 0 || hibernation || config->persistUndoHistory()) {
+            // Mirror the steps, so that they can be moved out of Scintilla
+            m_document->m_undoHistory->record(type, position, length, text);
+            if (budget > 0 && undoMemoryBytes(m_document) > budget && !m_compactionPending) {
+                // Not while Scintilla is performing the action
+                m_compactionPending = true;
+                QMetaObject::invokeMethod(this, "compactUndoHistory", Qt::QueuedConnection);
+            }
+        } else {
+            // The mirror would only be a second copy of the history of
+            // Scintilla. Starting it again later only loses older steps.
+            m_document->m_undoHistory->discardRecent();
+        }
+    }
+    if (type & SC_MOD_INSERTTEXT) {
+        m_braceIndex->textInserted(position, text);
+    } else if (type & SC_MOD_DELETETEXT) {
+        m_braceIndex->textDeleted(position, length);
+    } else if (type & SC_MOD_CHANGESTYLE) {
+        m_braceIndex->styleChanged(position, length);
+    }
+}
+
+qint64 Buffer::undoMemoryBytes(Document *document) {
+    return document->m_undoBytes + document->m_undoHistory->memoryBytes();
+}
+
+void Buffer::onSavePointChanged(bool dirty) {
+    emit modificationChanged(dirty || m_document->m_modifiedOutsideHistory);
+}
+
+void Buffer::compactUndoHistory() {
+    m_compactionPending = false;
+    qint64 budget = qint64(Configuration::instance()->undoMemoryBudget()) * 1024 * 1024;
+    if (budget <= 0 || undoMemoryBytes(m_document) <= budget) {
+        return;
+    }
+
+    // Discarding the undo history moves the save point of Scintilla to the
+    // current text
+    if (modify()) {
+        m_document->m_modifiedOutsideHistory = true;
+    }
+    // The compressed steps keep half the budget, the history of Scintilla and
+    // its mirror share the other half until the next compaction
+    m_document->m_undoHistory->compact(budget / 2);
+    emptyUndoBuffer();
+    m_document->m_undoBytes = 0;
+}
+
+void Buffer::hibernateIdleDocuments() {
+    // The documents of a second view are hibernated by the buffer that owns them
+    qint64 timeout = qint64(Configuration::instance()->hibernateTimeout()) * 60 * 1000;
+    if (timeout <= 0 || m_source) {
+        return;
+    }
+
+    for (int i = 0; i < m_documents.size(); ++i) {
+        Document *document = m_documents.at(i);
+        if (document != m_document && !document->m_hibernated && document->m_idleTimer.hasExpired(timeout)) {
+            hibernate(document);
+        }
+    }
+}
+
+void Buffer::hibernate(Document *document) {
+    TRACE_SCOPE("Buffer::hibernate");
+
+    ScintillaEdit *view = hiddenView();
+    view->setDocPointer(document->m_pointer);
+
+    // The markers are kept by Scintilla for each line
+    document->m_markerLines.clear();
+    for (int line = view->markerNext(0, ~0); line != -1; line = view->markerNext(line + 1, ~0)) {
+        document->m_markerLines << qMakePair(line, int(view->markerGet(line)));
+    }
+
+    // The text of an unmodified file is read again, the text of a modified
+    // one is compressed
+    QString fileName = document->m_fileInfo.filePath();
+    if (!isModified(document) && !fileName.isEmpty() && QFileInfo::exists(fileName)) {
+        document->m_fileModified = QFileInfo(fileName).lastModified();
+    } else {
+        QByteArray compressed = qCompress(view->textRange(0, view->length()));
+        if (compressed.size() > SpillThreshold) {
+            QTemporaryFile *file = new QTemporaryFile();
+            if (file->open() && file->write(compressed) == compressed.size()) {
+                file->close();
+                document->m_spillFile = file;
+                compressed.clear();
+            } else {
+                delete file;
+            }
+        }
+        document->m_hibernatedText = compressed;
+    }
+
+    // The undo history of Scintilla goes with its document, keep its steps
+    qint64 budget = qint64(Configuration::instance()->undoMemoryBudget()) * 1024 * 1024;
+    document->m_undoHistory->compact(budget > 0 ? budget / 2 : std::numeric_limits<qint64>::max());
+    document->m_undoBytes = 0;
+    if (document->m_modified) {
+        document->m_modifiedOutsideHistory = true;
+    }
+
+    view->setDocPointer(0);
+    releaseDocument(document->m_pointer);
+    document->m_pointer = 0;
+    document->m_braceIndex->invalidate();
+    document->m_hibernated = true;
+}
+
+void Buffer::startRestore() {
+    Document *document = m_document;
+    setReadOnly(true);
+    m_restoreWatcher = new QFutureWatcher<QPair<bool, QByteArray> >(this);
+    connect(m_restoreWatcher, SIGNAL(finished()), this, SLOT(onRestoreFinished()));
+    m_restoreWatcher->setFuture(QtConcurrent::run(&Buffer::readHibernated, document->m_fileInfo.filePath(),
+            m_encoding->name(), document->m_hibernatedText,
+            document->m_spillFile ? document->m_spillFile->fileName() : QString()));
+
+    emit restoringChanged(true);
+}
+
+void Buffer::onRestoreFinished() {
+    if (sender() == m_restoreWatcher) {
+        completeRestore();
+    }
+}
+
+void Buffer::completeRestore() {
+    TRACE_SCOPE("Buffer::completeRestore");
+
+    m_restoreWatcher->waitForFinished();
+    QPair<bool, QByteArray> restored = m_restoreWatcher->result();
+    m_restoreWatcher->deleteLater();
+    m_restoreWatcher = 0;
+
+    Document *document = m_document;
+    if (!restored.first) {
+        // The document stays hibernated and read-only, it is never marked
+        // saved, so that the empty text cannot overwrite the file
+        emit restoringChanged(false);
+        emit restoreFailed(document->m_fileInfo.filePath());
+        return;
+    }
+    bool reloaded = document->m_hibernatedText.isEmpty() && !document->m_spillFile;
+    if (reloaded && QFileInfo(document->m_fileInfo.filePath()).lastModified() != document->m_fileModified) {
+        // The file has changed since, the undo steps do not apply to it
+        document->m_undoHistory->clear();
+    }
+
+    setReadOnly(false);
+    setUndoCollection(false);
+    setText(restored.second.constData());
+    setUndoCollection(true);
+    setSavePoint();
+    for (int i = 0; i < document->m_markerLines.size(); ++i) {
+        markerAddSet(document->m_markerLines.at(i).first, document->m_markerLines.at(i).second);
+    }
+
+    // The fold levels are set by the lexer
+    if (!document->m_foldedLines.isEmpty()) {
+        colourise(0, positionFromLine(document->m_foldedLines.last() + 1));
+    }
+    restoreViewState();
+    endHibernation(document);
+
+    emit restoringChanged(false);
+}
+
+void Buffer::endHibernation(Document *document) {
+    document->m_hibernated = false;
+    document->m_hibernatedText.clear();
+    document->m_markerLines.clear();
+    delete document->m_spillFile;
+    document->m_spillFile = 0;
+}
+
+QPair<bool, QByteArray> Buffer::readHibernated(const QString &fileName, const QByteArray &encoding,
+        const QByteArray &compressed, const QString &spillFileName) {
+    if (!compressed.isEmpty()) {
+        return qMakePair(true, qUncompress(compressed));
+    } else if (!spillFileName.isEmpty()) {
+        QFile file(spillFileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return qMakePair(false, QByteArray());
+        }
+
+        return qMakePair(true, qUncompress(file.readAll()));
+    }
+
+    bool ok;
+    QByteArray content = readFile(fileName, encoding, &ok);
+
+    return qMakePair(ok, content);
+}
+
+void Buffer::restoreViewState() {
+    for (int i = 0; i < m_document->m_foldedLines.size(); ++i) {
+        foldLine(m_document->m_foldedLines.at(i), SC_FOLDACTION_CONTRACT);
+    }
+    setSel(m_document->m_anchor, m_document->m_currentPos);
+    setFirstVisibleLine(m_document->m_firstVisibleLine);
+    setXOffset(m_document->m_xOffset);
+}
+
+void Buffer::keyPressEvent(QKeyEvent *event) {
+    if (event->matches(QKeySequence::Undo) && !canUndo()) {
+        undo();
+        event->accept();
+        return;
+    }
+    ScintillaEditBase::keyPressEvent(event);
+}
+
 void Buffer::dropEvent(QDropEvent *event) {
     if (event->mimeData()->hasUrls()) {
         // If the user is dropping URLs, emit a signal
@@ -402,10 +1286,13 @@ void Buffer::dropEvent(QDropEvent *event) {
 }
 
 void Buffer::loadConfiguration() {
+    TRACE_SCOPE("Buffer::loadConfiguration");
+
     Configuration *config = Configuration::instance();
 
     m_trackLineWidth = config->trackLineMarginWidth();
     m_braceHighlight = config->braceHighlight();
+    m_bracePairColorization = config->bracePairColorization() && !m_source;
 
     setStyleQFont(STYLE_DEFAULT, config->font());
     setViewWhitespace(config->viewWhitespace());
@@ -426,6 +1313,15 @@ void Buffer::loadConfiguration() {
     setColorScheme(ColorScheme::getColorScheme(config->colorScheme()));
 }
 
+void Buffer::setUpDocument() {
+    Configuration *config = Configuration::instance();
+
+    setCodePage(SC_CP_UTF8);
+    setTabWidth(config->tabWidth());
+    setIndent(config->indentationWidth());
+    setUseTabs(config->useTabs());
+}
+
 void Buffer::setFileInfo(const QFileInfo& fileInfo) {
     if (m_fileInfo != fileInfo) {
         m_fileInfo = fileInfo;
@@ -442,27 +1338,49 @@ const Language *Buffer::language() const {
 void Buffer::setLanguage(const Language *language) {
     if (m_language != language) {
         m_language = language;
+        applyLanguage();
 
-        if (language) {
-            setLexerLanguage(language->lexer().toLocal8Bit());
-            for (int i = 0; i < language->keywords().size(); ++i) {
-                setKeyWords(i, language->keywords().at(i).toLatin1());
-            }
-            setProperty("fold", "1");
-            setProperty("fold.compact", "0");
-        } else {
-            setLexer(SCLEX_NULL);
-            setKeyWords(0, "");
-            setProperty("fold", "0");
-        }
+        emit languageChanged(language);
+    }
+}
 
-        Configuration *config = Configuration::instance();
-        setColorScheme(ColorScheme::getColorScheme(config->colorScheme()));
+void Buffer::onLanguageReloaded(const Language *language) {
+    if (language == m_language && m_source) {
+        // The lexer of the shared document is set up by the other buffer
+        setColorScheme(m_colorScheme);
+    } else if (language == m_language) {
+        applyLanguage();
+    }
+}
 
-        emit languageChanged(language);
+void Buffer::onColorSchemeReloaded(const ColorScheme *colorScheme) {
+    if (colorScheme == m_colorScheme) {
+        // The style tables of the color scheme have been discarded
+        m_styleTable = 0;
+        setColorScheme(colorScheme);
     }
 }
 
+void Buffer::applyLanguage() {
+    if (m_language) {
+        setLexerLanguage(m_language->lexer().toLocal8Bit());
+        for (int i = 0; i < m_language->keywords().size(); ++i) {
+            setKeyWords(i, m_language->keywords().at(i).toLatin1());
+        }
+        setProperty("fold", "1");
+        setProperty("fold.compact", "0");
+    } else {
+        setLexer(SCLEX_NULL);
+        setKeyWords(0, "");
+        setProperty("fold", "0");
+    }
+    // The brackets inside comments and strings depend on the language
+    m_braceIndex->invalidate();
+
+    Configuration *config = Configuration::instance();
+    setColorScheme(ColorScheme::getColorScheme(config->colorScheme()));
+}
+
 int Buffer::getLineMarginWidth() {
     Configuration *configuration = Configuration::instance();
     int lineWidth = m_trackLineWidth ?
@@ -495,15 +1413,111 @@ int Buffer::isBrace(sptr_t c) {
     return 0;
 }
 
-void Buffer::applyStyle(int styleNumber, const StyleInfo& style) {
-    if (style.foregroundColor() >= 0) {
+int Buffer::countMarkers(ScintillaEdit *view) {
+    int count = 0;
+    for (int line = view->markerNext(0, ~0); line != -1; line = view->markerNext(line + 1, ~0)) {
+        ++count;
+    }
+
+    return count;
+}
+
+int Buffer::countIndicators(ScintillaEdit *view) {
+    int count = 0;
+    sptr_t length = view->length();
+    for (int indicator = INDIC_CONTAINER; indicator <= INDIC_MAX; ++indicator) {
+        // Walk the runs of the indicator, the gaps between them are runs too
+        sptr_t position = 0;
+        while (position < length) {
+            sptr_t end = view->indicatorEnd(indicator, position);
+            if (end <= position) {
+                break;
+            }
+            if (view->indicatorValueAt(indicator, position)) {
+                ++count;
+            }
+            position = end;
+        }
+    }
+
+    return count;
+}
+
+QList<Buffer*> &Buffer::buffers() {
+    static QList<Buffer*> buffers;
+
+    return buffers;
+}
+
+void Buffer::colorizeBracePairs() {
+    if (m_bracePairColorCount == 0) {
+        return;
+    }
+    int firstLine = docLineFromVisible(firstVisibleLine());
+    int lastLine = docLineFromVisible(firstVisibleLine() + linesOnScreen());
+    sptr_t start = positionFromLine(firstLine);
+    sptr_t end = lineEndPosition(lastLine);
+    if (start == m_colorizedStart && end == m_colorizedEnd &&
+            m_braceIndex->revision() == m_colorizedRevision &&
+            m_modificationCounter == m_colorizedModification) {
+        return;
+    }
+    clearBracePairColors();
+
+    QVector<BraceIndex::Level> levels = m_braceIndex->levels(start, end);
+    for (int i = 0; i < levels.size(); ++i) {
+        const BraceIndex::Level &level = levels.at(i);
+        if (level.depth >= 0) {
+            setIndicatorCurrent(BracePair + level.depth % m_bracePairColorCount);
+            indicatorFillRange(level.position, 1);
+        }
+    }
+    m_colorizedStart = start;
+    m_colorizedEnd = end;
+    m_colorizedRevision = m_braceIndex->revision();
+    m_colorizedModification = m_modificationCounter;
+}
+
+void Buffer::clearBracePairColors() {
+    // The colors of a shared document belong to the other buffer
+    if (m_source) {
+        return;
+    }
+    // The colors move with the text, after an edit they can be anywhere
+    sptr_t start = m_colorizedStart;
+    sptr_t end = m_colorizedEnd;
+    if (m_modificationCounter != m_colorizedModification) {
+        start = 0;
+        end = length();
+    }
+    end = std::min<sptr_t>(end, length());
+    if (end > start) {
+        for (int i = 0; i < m_bracePairColorCount; ++i) {
+            setIndicatorCurrent(BracePair + i);
+            indicatorClearRange(start, end - start);
+        }
+    }
+    m_colorizedStart = m_colorizedEnd = 0;
+    m_colorizedModification = m_modificationCounter;
+}
+
+void Buffer::applyStyle(int styleNumber, const StyleInfo& style, const StyleInfo& previous) {
+    if (style.foregroundColor() != previous.foregroundColor()) {
         styleSetFore(styleNumber, style.foregroundColor());
     }
-    if (style.backgroundColor() >= 0) {
+    if (style.backgroundColor() != previous.backgroundColor()) {
         styleSetBack(styleNumber, style.backgroundColor());
     }
-    styleSetBold(styleNumber, style.bold());
-    styleSetItalic(styleNumber, style.italic());
-    styleSetUnderline(styleNumber, style.underline());
-    styleSetEOLFilled(styleNumber, style.eolFilled());
+    if (style.bold() != previous.bold()) {
+        styleSetBold(styleNumber, style.bold());
+    }
+    if (style.italic() != previous.italic()) {
+        styleSetItalic(styleNumber, style.italic());
+    }
+    if (style.underline() != previous.underline()) {
+        styleSetUnderline(styleNumber, style.underline());
+    }
+    if (style.eolFilled() != previous.eolFilled()) {
+        styleSetEOLFilled(styleNumber, style.eolFilled());
+    }
 }
@@ -1,29 +1,40 @@
 #include "colorscheme.h"
 
+#include "builtintables.h"
 #include "styleinfo.h"
+#include "trace.h"
 #include "util.h"
 
 #include <QDebug>
 #include <QDir>
 #include <QXmlStreamReader>
 
+#include <algorithm>
+
+StyleTable::StyleTable() :
+        foreground(-1), background(-1), whitespaceForeground(-1), lexerWhitespace(false) {
+    std::fill(defined, defined + StyleCount, false);
+}
+
 QStringList ColorScheme::allColorSchemes() {
     // Sort the keys and return them.
-    QStringList list = colorSchemes.keys();
+    QStringList list = colorSchemes().keys();
     qSort(list.begin(), list.end());
 
     return list;
 }
 
 const ColorScheme *ColorScheme::getColorScheme(const QString &name) {
-    return colorSchemes[name];
+    return colorSchemes().value(name);
+}
+
+void ColorScheme::initialize() {
+    colorSchemes();
 }
 
 void ColorScheme::cleanup() {
-    QHashIterator<QString, ColorScheme*> iter(colorSchemes);
-    while (iter.hasNext()) {
-        delete iter.next().value();
-    }
+    qDeleteAll(colorSchemes());
+    colorSchemes().clear();
 }
 
 int ColorScheme::foreground() const {
@@ -50,45 +61,154 @@ int ColorScheme::whitespaceForeground() const {
     return m_whitespaceForeground;
 }
 
-QHash<int, StyleInfo> ColorScheme::stylesForLanguage(const QString& lang) const {
-    return m_languagesStyles[lang];
+QList<int> ColorScheme::bracePairColors() const {
+    return m_bracePairColors;
 }
 
-ColorScheme::ColorScheme() {
+const QHash<int, StyleInfo> &ColorScheme::stylesForLanguage(const QString& lang) const {
+    static const QHash<int, StyleInfo> noStyles;
+    QHash<QString, QHash<int, StyleInfo> >::const_iterator iter = m_languagesStyles.constFind(lang);
 
+    return iter != m_languagesStyles.constEnd() ? iter.value() : noStyles;
 }
 
-ColorScheme::~ColorScheme() {
+const StyleTable &ColorScheme::styleTable(const QString& lang) const {
+    StyleTable *table = m_styleTables.value(lang);
+    if (table) {
+        return *table;
+    }
 
+    table = new StyleTable;
+    table->foreground = m_foreground;
+    table->background = m_background;
+    table->whitespaceForeground = m_whitespaceForeground;
+    if (!lang.isNull()) {
+        // The whitespace is colored through the whitespace style of the lexer
+        table->lexerWhitespace = true;
+        const QHash<int, StyleInfo> &styles = stylesForLanguage(lang);
+        for (QHash<int, StyleInfo>::const_iterator iter = styles.constBegin();
+                iter != styles.constEnd(); ++iter) {
+            if (iter.key() >= 0 && iter.key() < StyleTable::StyleCount) {
+                table->defined[iter.key()] = true;
+                table->styles[iter.key()] = iter.value();
+            }
+        }
+    }
+    m_styleTables.insert(lang, table);
+
+    return *table;
+}
+
+ColorScheme::ColorScheme() :
+        m_foreground(-1), m_background(-1), m_caret(-1), m_caretLine(-1), m_selection(-1),
+        m_whitespaceForeground(-1) {
+}
+
+ColorScheme::~ColorScheme() {
+    qDeleteAll(m_styleTables);
 }
 
-QHash<QString, ColorScheme*> ColorScheme::colorSchemes = ColorScheme::initializeColorSchemes();
+QHash<QString, ColorScheme*> &ColorScheme::colorSchemes() {
+    // Initialized on first use, which is thread safe
+    static QHash<QString, ColorScheme*> colorSchemes = initializeColorSchemes();
+
+    return colorSchemes;
+}
 
 QHash<QString, ColorScheme*> ColorScheme::initializeColorSchemes() {
+    TRACE_SCOPE("ColorScheme::initialize");
+
     QHash<QString, ColorScheme*> colorSchemes;
 
-    // Make sure the resources are initialized
-    Q_INIT_RESOURCE(qtscitntillaeditor);
-    // List all the color scheme files
-    QDir dir(":/colorschemes/colorschemes");
-    QStringList colorSchemeFiles = dir.entryList();
-    for (int i = 0; i < colorSchemeFiles.size(); ++i) {
-        QFile file(dir.absolutePath() + "/" + colorSchemeFiles.at(i));
-        if (file.open(QFile::ReadOnly | QIODevice::Text)) {
-            QXmlStreamReader xml(&file);
-            processColorSchemeXml(xml, colorSchemes);
-            if (xml.hasError()) {
-                qCritical("Color scheme file %s cannot be parsed", qUtf8Printable(file.fileName()));
+    // The built-in color schemes
+    for (int i = 0; i < BuiltinTables::colorSchemeCount; ++i) {
+        const BuiltinTables::ColorSchemeEntry &entry = BuiltinTables::colorSchemes[i];
+        ColorScheme *colorScheme = new ColorScheme;
+        colorScheme->m_foreground = entry.foreground;
+        colorScheme->m_background = entry.background;
+        colorScheme->m_caret = entry.caret;
+        colorScheme->m_caretLine = entry.caretLine;
+        colorScheme->m_selection = entry.selection;
+        colorScheme->m_whitespaceForeground = entry.whitespace;
+        for (int j = 0; j < entry.bracePairColorCount; ++j) {
+            colorScheme->m_bracePairColors << entry.bracePairColors[j];
+        }
+        for (int j = 0; j < entry.languageCount; ++j) {
+            const BuiltinTables::LanguageStylesEntry &language = entry.languages[j];
+            QHash<int, StyleInfo> &styles = colorScheme->m_languagesStyles[QString::fromUtf8(language.language)];
+            for (int k = 0; k < language.styleCount; ++k) {
+                const BuiltinTables::StyleEntry &style = language.styles[k];
+                styles[style.style] = StyleInfo(style.foreground, style.background, style.bold, style.italic,
+                        style.underline, style.eolFilled);
             }
-        } else {
-            qCritical("Cannot open color scheme file %s.",
-                    qPrintable(file.fileName()));
         }
+        colorSchemes[QString::fromUtf8(entry.name)] = colorScheme;
+    }
+
+    // The color schemes of the user configuration directory add to or replace the built-in ones
+    QDir dir(userConfigDir() + "/colorschemes");
+    QStringList colorSchemeFiles = dir.entryList(QStringList("*.xml"), QDir::Files, QDir::Name);
+    for (int i = 0; i < colorSchemeFiles.size(); ++i) {
+        merge(colorSchemes, readColorSchemes(dir.absoluteFilePath(colorSchemeFiles.at(i))));
     }
 
     return colorSchemes;
 }
 
+QHash<QString, ColorScheme*> ColorScheme::readColorSchemes(const QString &fileName) {
+    QHash<QString, ColorScheme*> colorSchemes;
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QIODevice::Text)) {
+        qCritical("Cannot open color scheme file %s.", qPrintable(fileName));
+        return colorSchemes;
+    }
+    QXmlStreamReader xml(&file);
+    processColorSchemeXml(xml, colorSchemes);
+    if (xml.hasError()) {
+        qCritical("Color scheme file %s cannot be parsed", qUtf8Printable(fileName));
+        qDeleteAll(colorSchemes);
+        colorSchemes.clear();
+    }
+
+    return colorSchemes;
+}
+
+QList<const ColorScheme*> ColorScheme::update(const QHash<QString, ColorScheme*> &colorSchemes) {
+    return merge(ColorScheme::colorSchemes(), colorSchemes);
+}
+
+QList<const ColorScheme*> ColorScheme::merge(QHash<QString, ColorScheme*> &schemes,
+        const QHash<QString, ColorScheme*> &colorSchemes) {
+    QList<const ColorScheme*> changed;
+    for (QHash<QString, ColorScheme*>::const_iterator iter = colorSchemes.constBegin();
+            iter != colorSchemes.constEnd(); ++iter) {
+        ColorScheme *colorScheme = iter.value();
+        ColorScheme *existing = schemes.value(iter.key());
+        if (existing) {
+            // Update the color scheme in place, the buffers keep pointers to
+            // it. The buffers that use it must apply it again, since the
+            // style tables they refer to are discarded.
+            existing->m_foreground = colorScheme->m_foreground;
+            existing->m_background = colorScheme->m_background;
+            existing->m_caret = colorScheme->m_caret;
+            existing->m_caretLine = colorScheme->m_caretLine;
+            existing->m_selection = colorScheme->m_selection;
+            existing->m_whitespaceForeground = colorScheme->m_whitespaceForeground;
+            existing->m_bracePairColors = colorScheme->m_bracePairColors;
+            existing->m_languagesStyles = colorScheme->m_languagesStyles;
+            qDeleteAll(existing->m_styleTables);
+            existing->m_styleTables.clear();
+            delete colorScheme;
+            changed << existing;
+        } else {
+            schemes.insert(iter.key(), colorScheme);
+            changed << colorScheme;
+        }
+    }
+
+    return changed;
+}
+
 void ColorScheme::processColorSchemeXml(QXmlStreamReader &xml,
         QHash<QString, ColorScheme *> &colorSchemes) {
     // The color scheme
@@ -102,6 +222,7 @@ void ColorScheme::processColorSchemeXml(QXmlStreamReader &xml,
         if (token == QXmlStreamReader::StartElement) {
             if (xml.name() == "colorscheme") {
                 QString name = xml.attributes().value("name").toString();
+                delete colorSchemes.value(name);
                 colorSchemes[name] = colorScheme;
             } else if (xml.name() == "color") {
                 QString type = xml.attributes().value("type").toString();
@@ -119,6 +240,8 @@ void ColorScheme::processColorSchemeXml(QXmlStreamReader &xml,
                     colorScheme->m_selection = convertColor(text);
                 } else if (type == "whitespace") {
                     colorScheme->m_whitespaceForeground = convertColor(text);
+                } else if (type == "bracePair") {
+                    colorScheme->m_bracePairColors << convertColor(text);
                 }
             } else if (xml.name() == "style") {
                 StyleInfo styleInfo;
@@ -1,9 +1,18 @@
 #include "configuration.h"
 
 #include <QColor>
+#include <QCoreApplication>
 #include <QDebug>
 #include <QFont>
 #include <QFontDatabase>
+#include <QTimer>
+
+namespace {
+
+/** The delay between the last change and the write of the settings, in milliseconds. */
+const int SyncDelay = 1000;
+
+}
 
 Configuration* Configuration::instance() {
     static Configuration configuration;
@@ -12,75 +21,179 @@ Configuration* Configuration::instance() {
 }
 
 Configuration::Configuration() {
+    load();
+
+    m_syncTimer = new QTimer(this);
+    m_syncTimer->setSingleShot(true);
+    m_syncTimer->setInterval(SyncDelay);
+    connect(m_syncTimer, SIGNAL(timeout()), this, SLOT(sync()));
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(sync()));
+    }
+}
+
+void Configuration::load() {
+    m_snapshot.showToolBar = settings.value("toolbar.visible", "true").toBool();
+    m_snapshot.showStatusBar = settings.value("statusbar.visible", true).toBool();
+    m_snapshot.fullscreen = settings.value("full.screen", false).toBool();
+    m_snapshot.viewWhitespace = settings.value("view.whitespace", true).toBool();
+    m_snapshot.viewIndentationWhitespace = settings.value("view.indentation.whitespace", true).toBool();
+    m_snapshot.viewIndentationGuides = settings.value("view.indentation.guides", true).toBool();
+    m_snapshot.caretLineVisible = settings.value("view.caret.line", true).toBool();
+    m_snapshot.braceHighlight = settings.value("braces.check", true).toBool();
+    m_snapshot.bracePairColorization = settings.value("braces.colorize", false).toBool();
+    m_snapshot.indentationGuidesMode = settings.value("view.indentation.examine", Buffer::LookBoth).toInt();
+    m_snapshot.longLineIndicator = settings.value("long.line.indicator", true).toBool();
+    m_snapshot.longLineIndicatorLine = settings.value("long.line.indicator.line", true).toBool();
+    m_snapshot.longLineIndicatorColumn = settings.value("long.line.indicator.column", 80).toInt();
+    m_snapshot.viewEndOfLine = settings.value("view.eol", false).toBool();
+    m_snapshot.showLineMargin = settings.value("line.margin.visible", true).toBool();
+    m_snapshot.lineMarginWidth = settings.value("line.margin.width", 1).toInt();
+    m_snapshot.trackLineMarginWidth = settings.value("line.margin.track", true).toBool();
+    m_snapshot.showIconMargin = settings.value("margin", false).toBool();
+    m_snapshot.iconMarginWidth = settings.value("margin.width", 16).toInt();
+    m_snapshot.showFoldMargin = settings.value("fold", true).toBool();
+    m_snapshot.foldMarginWidth = settings.value("fold.width", 16).toInt();
+    m_snapshot.foldSymbols = settings.value("fold.symbols", Buffer::Arrows).toInt();
+    m_snapshot.foldLines = settings.value("fold.lines", Buffer::BoxLine).toInt();
+    m_snapshot.wrap = settings.value("wrap", false).toBool();
+    m_snapshot.tabWidth = settings.value("tab.size", 4).toInt();
+    m_snapshot.indentationWidth = settings.value("indent.size", 4).toInt();
+    m_snapshot.useTabs = settings.value("use.tabs", false).toBool();
+    m_snapshot.scrollWidth = settings.value("horizontal.scroll.width", 1).toInt();
+    m_snapshot.scrollWidthTracking = settings.value("horizontal.scroll.width.tracking", true).toBool();
+    if (settings.contains("font.default")) {
+        m_snapshot.font.fromString(settings.value("font.default").toString());
+    } else {
+        m_snapshot.font = defaultFont();
+    }
+    m_snapshot.colorScheme = settings.value("color.scheme", "Default").toString();
+    m_snapshot.tabbedInterface = settings.value("tabbed.interface", false).toBool();
+    m_snapshot.undoMemoryBudget = settings.value("undo.memory.budget", 0).toInt();
+    m_snapshot.hibernateTimeout = settings.value("hibernate.timeout", 15).toInt();
+    m_snapshot.persistUndoHistory = settings.value("undo.persist", false).toBool();
+}
+
+void Configuration::sync() {
+    if (m_dirty.isEmpty()) {
+        return;
+    }
+    m_syncTimer->stop();
+    for (QHash<QString, QVariant>::const_iterator iter = m_dirty.constBegin(); iter != m_dirty.constEnd(); ++iter) {
+        settings.setValue(iter.key(), iter.value());
+    }
+    m_dirty.clear();
+    settings.sync();
+}
+
+QFont Configuration::defaultFont() {
+    QString family;
+#ifdef Q_OS_WIN
+    QFontDatabase fontDb;
+    if (fontDb.families(QFontDatabase::Any).contains("Consolas")) {
+        family = "Consolas";
+    } else {
+        family = "Courier New";
+    }
+#elif Q_OS_MAC
+    QFontDatabase fontDb;
+    if (fontDb.families(QFontDatabase::Any).contains("Menlo")) {
+        family = "Menlo";
+    } else {
+        family = "Monaco";
+    }
+#else
+    family = "Monospace";
+#endif
+    return QFont(family, 10);
+}
+
+template <typename T>
+void Configuration::setValue(const QString &key, T &field, const T &value) {
+    if (field == value) {
+        return;
+    }
+    field = value;
+    m_dirty.insert(key, QVariant::fromValue(value));
+    m_syncTimer->start();
+    emit changed(key);
 }
 
 bool Configuration::showToolBar() {
-    return settings.value("toolbar.visible", "true").toBool();
+    return m_snapshot.showToolBar;
 }
 
 void Configuration::setShowToolBar(bool showToolBar) {
-    settings.setValue("toolbar.visible", showToolBar);
+    setValue("toolbar.visible", m_snapshot.showToolBar, showToolBar);
 }
 
 bool Configuration::showStatusBar() {
-    return settings.value("statusbar.visible", true).toBool();
+    return m_snapshot.showStatusBar;
 }
 
 void Configuration::setShowStatusBar(bool showStatusBar) {
-    settings.setValue("statusbar.visible", showStatusBar);
+    setValue("statusbar.visible", m_snapshot.showStatusBar, showStatusBar);
 }
 
 bool Configuration::fullscreen() {
-    return settings.value("full.screen", false).toBool();
+    return m_snapshot.fullscreen;
 }
 
 void Configuration::setFullscreen(bool fullscreen) {
-    settings.setValue("full.screen", fullscreen);
+    setValue("full.screen", m_snapshot.fullscreen, fullscreen);
 }
 
 bool Configuration::viewWhitespace() {
-    return settings.value("view.whitespace", true).toBool();
+    return m_snapshot.viewWhitespace;
 }
 
 void Configuration::setViewWhitespace(bool viewWhitespace) {
-    settings.setValue("view.whitespace", viewWhitespace);
+    setValue("view.whitespace", m_snapshot.viewWhitespace, viewWhitespace);
 }
 
 bool Configuration::viewIndentationWhitespace() {
-    return settings.value("view.indentation.whitespace", true).toBool();
+    return m_snapshot.viewIndentationWhitespace;
 }
 
 void Configuration::setViewIndentationWhitespace(
         bool viewIndentationWhitespace) {
-    settings.setValue("view.indentation.whitespace", viewIndentationWhitespace);
+    setValue("view.indentation.whitespace", m_snapshot.viewIndentationWhitespace, viewIndentationWhitespace);
 }
 
 bool Configuration::viewIndentationGuides() {
-    return settings.value("view.indentation.guides", true).toBool();
+    return m_snapshot.viewIndentationGuides;
 }
 
 void Configuration::setViewIndentationGuides(bool viewIndentationGuides) {
-    settings.setValue("view.indentation.guides", viewIndentationGuides);
+    setValue("view.indentation.guides", m_snapshot.viewIndentationGuides, viewIndentationGuides);
 }
 
 bool Configuration::caretLineVisible() {
-    return settings.value("view.caret.line", true).toBool();
+    return m_snapshot.caretLineVisible;
 }
 
 void Configuration::setCaretLineVisible(bool caretLineVisible) {
-    settings.setValue("view.caret.line", caretLineVisible);
+    setValue("view.caret.line", m_snapshot.caretLineVisible, caretLineVisible);
 }
 
 bool Configuration::braceHighlight() {
-    return settings.value("braces.check", true).toBool();
+    return m_snapshot.braceHighlight;
 }
 
 void Configuration::setBraceHighlight(bool braceHighlight) {
-    settings.setValue("braces.check", braceHighlight);
+    setValue("braces.check", m_snapshot.braceHighlight, braceHighlight);
+}
+
+bool Configuration::bracePairColorization() {
+    return m_snapshot.bracePairColorization;
+}
+
+void Configuration::setBracePairColorization(bool bracePairColorization) {
+    setValue("braces.colorize", m_snapshot.bracePairColorization, bracePairColorization);
 }
 
 Buffer::IndentationGuidesMode Configuration::indentationGuidesMode() {
-    int examine = settings.value("view.indentation.examine", Buffer::LookBoth).toInt();
+    int examine = m_snapshot.indentationGuidesMode;
     switch(examine) {
     case 1:
         return Buffer::Real;
@@ -94,99 +207,99 @@ Buffer::IndentationGuidesMode Configuration::indentationGuidesMode() {
 }
 
 void Configuration::setIndentationGuidesMode(Buffer::IndentationGuidesMode mode) {
-    settings.setValue("view.indentation.examine", mode);
+    setValue("view.indentation.examine", m_snapshot.indentationGuidesMode, int(mode));
 }
 
 bool Configuration::longLineIndicator() {
-    return settings.value("long.line.indicator", true).toBool();
+    return m_snapshot.longLineIndicator;
 }
 
 void Configuration::setLongLineIndicator(bool longLineIndicator) {
-    settings.setValue("long.line.indicator", longLineIndicator);
+    setValue("long.line.indicator", m_snapshot.longLineIndicator, longLineIndicator);
 }
 
 bool Configuration::longLineIndicatorLine() {
-    return settings.value("long.line.indicator.line", true).toBool();
+    return m_snapshot.longLineIndicatorLine;
 }
 
 void Configuration::setLongLineIndicatorLine(bool longLineIndicatorLine) {
-    settings.setValue("long.line.indicator.line", longLineIndicatorLine);
+    setValue("long.line.indicator.line", m_snapshot.longLineIndicatorLine, longLineIndicatorLine);
 }
 
 int Configuration::longLineIndicatorColumn() {
-    return settings.value("long.line.indicator.column", 80).toInt();
+    return m_snapshot.longLineIndicatorColumn;
 }
 
 void Configuration::setLongLineIndicatorColumn(int longLineIndicatorColumn) {
-    settings.setValue("long.line.indicator.column", longLineIndicatorColumn);
+    setValue("long.line.indicator.column", m_snapshot.longLineIndicatorColumn, longLineIndicatorColumn);
 }
 
 bool Configuration::viewEndOfLine() {
-    return settings.value("view.eol", false).toBool();
+    return m_snapshot.viewEndOfLine;
 }
 
 void Configuration::setViewEndOfLine(bool endOfLine) {
-    settings.setValue("view.eol", endOfLine);
+    setValue("view.eol", m_snapshot.viewEndOfLine, endOfLine);
 }
 
 bool Configuration::showLineMargin() {
-    return settings.value("line.margin.visible", true).toBool();
+    return m_snapshot.showLineMargin;
 }
 
 void Configuration::setShowLineMargin(bool showLineMargin) {
-    settings.setValue("line.margin.visible", showLineMargin);
+    setValue("line.margin.visible", m_snapshot.showLineMargin, showLineMargin);
 }
 
 int Configuration::lineMarginWidth() {
-    return settings.value("line.margin.width", 1).toInt();
+    return m_snapshot.lineMarginWidth;
 }
 
 void Configuration::setLineMarginWidth(int lineMarginWidth) {
-    settings.setValue("line.margin.width", lineMarginWidth);
+    setValue("line.margin.width", m_snapshot.lineMarginWidth, lineMarginWidth);
 }
 
 bool Configuration::trackLineMarginWidth() {
-    return settings.value("line.margin.track", true).toBool();
+    return m_snapshot.trackLineMarginWidth;
 }
 
 void Configuration::setTrackLineMarginWidth(bool trackLineMarginWidth) {
-    settings.setValue("line.margin.track", trackLineMarginWidth);
+    setValue("line.margin.track", m_snapshot.trackLineMarginWidth, trackLineMarginWidth);
 }
 
 bool Configuration::showIconMargin() {
-    return settings.value("margin", false).toBool();
+    return m_snapshot.showIconMargin;
 }
 
 void Configuration::setShowIconMargin(bool showIconMargin) {
-    settings.setValue("margin", showIconMargin);
+    setValue("margin", m_snapshot.showIconMargin, showIconMargin);
 }
 
 int Configuration::iconMarginWidth() {
-    return settings.value("margin.width", 16).toInt();
+    return m_snapshot.iconMarginWidth;
 }
 
 void Configuration::setIconMarginWidth(int iconMarginWidth) {
-    settings.setValue("margin.width", iconMarginWidth);
+    setValue("margin.width", m_snapshot.iconMarginWidth, iconMarginWidth);
 }
 
 bool Configuration::showFoldMargin() {
-    return settings.value("fold", true).toBool();
+    return m_snapshot.showFoldMargin;
 }
 
 void Configuration::setShowFoldMargin(bool showFoldMargin) {
-    settings.setValue("fold", showFoldMargin);
+    setValue("fold", m_snapshot.showFoldMargin, showFoldMargin);
 }
 
 int Configuration::foldMarginWidth() {
-    return settings.value("fold.width", 16).toInt();
+    return m_snapshot.foldMarginWidth;
 }
 
 void Configuration::setFoldMarginWidth(int foldMarginWidth) {
-    settings.setValue("fold.width", foldMarginWidth);
+    setValue("fold.width", m_snapshot.foldMarginWidth, foldMarginWidth);
 }
 
 Buffer::FoldSymbols Configuration::foldSymbols() {
-    int value = settings.value("fold.symbols", Buffer::Arrows).toInt();
+    int value = m_snapshot.foldSymbols;
     switch (value) {
     case 0:
         return Buffer::Arrows;
@@ -202,11 +315,11 @@ Buffer::FoldSymbols Configuration::foldSymbols() {
 }
 
 void Configuration::setFoldSymbols(Buffer::FoldSymbols foldSymbols) {
-    settings.setValue("fold.symbols", foldSymbols);
+    setValue("fold.symbols", m_snapshot.foldSymbols, int(foldSymbols));
 }
 
 Buffer::FoldLines Configuration::foldLines() {
-    int value = settings.value("fold.lines", Buffer::BoxLine).toInt();
+    int value = m_snapshot.foldLines;
     switch (value) {
     case 0:
         return Buffer::NoLine;
@@ -220,94 +333,108 @@ Buffer::FoldLines Configuration::foldLines() {
 }
 
 void Configuration::setFoldLines(Buffer::FoldLines foldLines) {
-    settings.setValue("fold.lines", foldLines);
+    setValue("fold.lines", m_snapshot.foldLines, int(foldLines));
 }
 
 bool Configuration::wrap() {
-    return settings.value("wrap", false).toBool();
+    return m_snapshot.wrap;
 }
 
 void Configuration::setWrap(bool wrap) {
-    settings.setValue("wrap", wrap);
+    setValue("wrap", m_snapshot.wrap, wrap);
 }
 
 int Configuration::tabWidth() const {
-    return settings.value("tab.size", 4).toInt();
+    return m_snapshot.tabWidth;
 }
 
 void Configuration::setTabWidth(int tabWidth) {
-    settings.setValue("tab.size", tabWidth);
+    setValue("tab.size", m_snapshot.tabWidth, tabWidth);
 }
 
 int Configuration::indentationWidth() const {
-    return settings.value("indent.size", 4).toInt();
+    return m_snapshot.indentationWidth;
 }
 
 void Configuration::setIndentationWidth(int indentationWidth) {
-    settings.setValue("indent.size", indentationWidth);
+    setValue("indent.size", m_snapshot.indentationWidth, indentationWidth);
 }
 
 bool Configuration::useTabs() const {
-    return settings.value("use.tabs", false).toBool();
+    return m_snapshot.useTabs;
 }
 
 void Configuration::setUseTabs(bool useTabs) {
-    settings.setValue("use.tabs", useTabs);
+    setValue("use.tabs", m_snapshot.useTabs, useTabs);
 }
 
 int Configuration::scrollWidth() const {
-    return settings.value("horizontal.scroll.width", 1).toInt();
+    return m_snapshot.scrollWidth;
 }
 
 void Configuration::setScrollWidth(int scrollWidth) {
-    settings.setValue("horizontal.scroll.width", scrollWidth);
+    setValue("horizontal.scroll.width", m_snapshot.scrollWidth, scrollWidth);
 }
 
 bool Configuration::scrollWidthTracking() const {
-    return settings.value("horizontal.scroll.width.tracking", true).toBool();
+    return m_snapshot.scrollWidthTracking;
 }
 
 void Configuration::setScrollWidthTracking(bool scrollWidthTracking) {
-    settings.setValue("horizontal.scroll.width.tracking", scrollWidthTracking);
+    setValue("horizontal.scroll.width.tracking", m_snapshot.scrollWidthTracking, scrollWidthTracking);
 }
 
 QFont Configuration::font() const {
-    if (settings.contains("font.default")) {
-        QFont font;
-        font.fromString(settings.value("font.default").toString());
-        return font;
-    } else {
-        QString family;
-#ifdef Q_OS_WIN
-        QFontDatabase fontDb;
-        if (fontDb.families(QFontDatabase::Any).contains("Consolas")) {
-            family = "Consolas";
-        } else {
-            family = "Courier New";
-        }
-#elif Q_OS_MAC
-        QFontDatabase fontDb;
-        if (fontDb.families(QFontDatabase::Any).contains("Menlo")) {
-            family = "Menlo";
-        } else {
-            family = "Monaco";
-        }
-#else
-        family = "Monospace";
-#endif
-        return QFont(family, 10);
-    }
+    return m_snapshot.font;
 }
 
 void Configuration::setFont(const QFont &font) {
-    settings.setValue("font.default", font.toString());
+    if (m_snapshot.font == font) {
+        return;
+    }
+    m_snapshot.font = font;
+    m_dirty.insert("font.default", font.toString());
+    m_syncTimer->start();
+    emit changed("font.default");
 }
 
 QString Configuration::colorScheme() const {
-    return settings.value("color.scheme", "Default").toString();
+    return m_snapshot.colorScheme;
 }
 
 void Configuration::setColorScheme(const QString &name) {
-    settings.setValue("color.scheme", name);
+    setValue("color.scheme", m_snapshot.colorScheme, name);
+}
+
+bool Configuration::tabbedInterface() const {
+    return m_snapshot.tabbedInterface;
+}
+
+void Configuration::setTabbedInterface(bool tabbedInterface) {
+    setValue("tabbed.interface", m_snapshot.tabbedInterface, tabbedInterface);
+}
+
+int Configuration::undoMemoryBudget() const {
+    return m_snapshot.undoMemoryBudget;
+}
+
+void Configuration::setUndoMemoryBudget(int undoMemoryBudget) {
+    setValue("undo.memory.budget", m_snapshot.undoMemoryBudget, undoMemoryBudget);
+}
+
+int Configuration::hibernateTimeout() const {
+    return m_snapshot.hibernateTimeout;
+}
+
+void Configuration::setHibernateTimeout(int hibernateTimeout) {
+    setValue("hibernate.timeout", m_snapshot.hibernateTimeout, hibernateTimeout);
+}
+
+bool Configuration::persistUndoHistory() const {
+    return m_snapshot.persistUndoHistory;
+}
+
+void Configuration::setPersistUndoHistory(bool persistUndoHistory) {
+    setValue("undo.persist", m_snapshot.persistUndoHistory, persistUndoHistory);
 }
 
@@ -0,0 +1,148 @@
+#include "colorscheme.h"
+#include "definitionwatcher.h"
+#include "language.h"
+#include "util.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+namespace {
+
+/**
+ * Returns the definition files of the user configuration directory that
+ * exist.
+ *
+ * @return The absolute paths of the files.
+ */
+QStringList definitionFiles() {
+    QStringList files;
+    if (QFile::exists(userConfigDir() + "/languages.xml")) {
+        files << userConfigDir() + "/languages.xml";
+    }
+    QStringList dirs = QStringList() << userConfigDir() + "/languages" << userConfigDir() + "/colorschemes";
+    for (int i = 0; i < dirs.size(); ++i) {
+        QDir dir(dirs.at(i));
+        QStringList names = dir.entryList(QStringList("*.xml"), QDir::Files, QDir::Name);
+        for (int j = 0; j < names.size(); ++j) {
+            files << dir.absoluteFilePath(names.at(j));
+        }
+    }
+
+    return files;
+}
+
+/**
+ * Returns true if a definition file contains languages, false if it contains
+ * color schemes.
+ *
+ * @param path The path of the file.
+ * @return true if the file contains languages.
+ */
+bool isLanguagesFile(const QString &path) {
+    return QFileInfo(path).absolutePath() != QDir(userConfigDir() + "/colorschemes").absolutePath();
+}
+
+}
+
+DefinitionWatcher* DefinitionWatcher::instance() {
+    static DefinitionWatcher *instance = new DefinitionWatcher;
+
+    return instance;
+}
+
+DefinitionWatcher::DefinitionWatcher() : QObject(QCoreApplication::instance()),
+        watcher(new QFileSystemWatcher(this)) {
+    connect(watcher, SIGNAL(fileChanged(QString)), this, SLOT(onFileChanged(QString)));
+    connect(watcher, SIGNAL(directoryChanged(QString)), this, SLOT(onDirectoryChanged()));
+
+    // The files that exist now have been read by the registries
+    QStringList files = definitionFiles();
+    for (int i = 0; i < files.size(); ++i) {
+        modified[files.at(i)] = QFileInfo(files.at(i)).lastModified();
+    }
+    watch();
+}
+
+void DefinitionWatcher::watch() {
+    QStringList paths;
+    QStringList dirs = QStringList() << userConfigDir() << userConfigDir() + "/languages" <<
+            userConfigDir() + "/colorschemes";
+    for (int i = 0; i < dirs.size(); ++i) {
+        if (QFileInfo(dirs.at(i)).isDir() && !watcher->directories().contains(dirs.at(i))) {
+            paths << dirs.at(i);
+        }
+    }
+    QStringList files = definitionFiles();
+    for (int i = 0; i < files.size(); ++i) {
+        if (!watcher->files().contains(files.at(i))) {
+            paths << files.at(i);
+        }
+    }
+    if (!paths.isEmpty()) {
+        watcher->addPaths(paths);
+    }
+}
+
+void DefinitionWatcher::reload(const QString &path) {
+    // Editors often save twice, or touch the directory, read each change once
+    QFileInfo fileInfo(path);
+    if (!fileInfo.exists() || modified.value(path) == fileInfo.lastModified()) {
+        return;
+    }
+    modified[path] = fileInfo.lastModified();
+
+    if (isLanguagesFile(path)) {
+        QFutureWatcher<QList<Language*> > *futureWatcher = new QFutureWatcher<QList<Language*> >(this);
+        connect(futureWatcher, SIGNAL(finished()), this, SLOT(onLanguagesRead()));
+        futureWatcher->setFuture(QtConcurrent::run(&Language::readLanguages, path, (bool*) 0));
+    } else {
+        QFutureWatcher<QHash<QString, ColorScheme*> > *futureWatcher =
+                new QFutureWatcher<QHash<QString, ColorScheme*> >(this);
+        connect(futureWatcher, SIGNAL(finished()), this, SLOT(onColorSchemesRead()));
+        futureWatcher->setFuture(QtConcurrent::run(&ColorScheme::readColorSchemes, path));
+    }
+}
+
+void DefinitionWatcher::onFileChanged(const QString &path) {
+    // A file that is saved by replacing it is no longer watched
+    if (QFile::exists(path) && !watcher->files().contains(path)) {
+        watcher->addPath(path);
+    }
+    reload(path);
+}
+
+void DefinitionWatcher::onDirectoryChanged() {
+    watch();
+    QStringList files = definitionFiles();
+    for (int i = 0; i < files.size(); ++i) {
+        reload(files.at(i));
+    }
+}
+
+void DefinitionWatcher::onLanguagesRead() {
+    QFutureWatcher<QList<Language*> > *futureWatcher =
+            static_cast<QFutureWatcher<QList<Language*> >*>(sender());
+    QList<Language*> languages = futureWatcher->result();
+    futureWatcher->deleteLater();
+
+    QList<const Language*> changed = Language::update(languages);
+    for (int i = 0; i < changed.size(); ++i) {
+        emit languageReloaded(changed.at(i));
+    }
+}
+
+void DefinitionWatcher::onColorSchemesRead() {
+    QFutureWatcher<QHash<QString, ColorScheme*> > *futureWatcher =
+            static_cast<QFutureWatcher<QHash<QString, ColorScheme*> >*>(sender());
+    QHash<QString, ColorScheme*> colorSchemes = futureWatcher->result();
+    futureWatcher->deleteLater();
+
+    QList<const ColorScheme*> changed = ColorScheme::update(colorSchemes);
+    for (int i = 0; i < changed.size(); ++i) {
+        emit colorSchemeReloaded(changed.at(i));
+    }
+}
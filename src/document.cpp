@@ -0,0 +1,20 @@
+#include "braceindex.h"
+#include "document.h"
+#include "undohistory.h"
+
+#include <QTemporaryFile>
+
+Document::Document(sptr_t pointer, BraceIndex *braceIndex) :
+        m_pointer(pointer), m_new(true), m_encoding(0), m_language(0), m_braceIndex(braceIndex),
+        m_modified(false), m_undoBytes(0),
+        m_undoHistory(new UndoHistory()), m_modifiedOutsideHistory(false), m_anchor(0), m_currentPos(0),
+        m_firstVisibleLine(0), m_xOffset(0), m_hibernated(false), m_spillFile(0),
+        m_persistedHistory(false) {
+    m_idleTimer.start();
+}
+
+Document::~Document() {
+    delete m_braceIndex;
+    delete m_undoHistory;
+    delete m_spillFile;
+}
@@ -1,17 +1,21 @@
+#include "builtintables.h"
 #include "encoding.h"
+#include "trace.h"
+#include "util.h"
 
 #include <QDebug>
 #include <QFile>
 #include <QXmlStreamReader>
 
 QListIterator<Encoding*> Encoding::allEncodings() {
-    return QListIterator<Encoding*>(availableEncodings);
+    return QListIterator<Encoding*>(availableEncodings());
 }
 
 const Encoding *Encoding::fromName(const QByteArray& name) {
-    for (int i = 0; i < availableEncodings.size(); i++) {
-        if (availableEncodings.at(i)->name() == name) {
-            return availableEncodings.at(i);
+    const QList<Encoding*> &encodings = availableEncodings();
+    for (int i = 0; i < encodings.size(); i++) {
+        if (encodings.at(i)->name() == name) {
+            return encodings.at(i);
         }
     }
     // Encoding not found.
@@ -30,56 +34,81 @@ QByteArray Encoding::name() const {
     return m_name;
 }
 
-QList<Encoding*> Encoding::availableEncodings = Encoding::intializeEncodings();
+void Encoding::initialize() {
+    availableEncodings();
+}
+
+QList<Encoding*> &Encoding::availableEncodings() {
+    // Initialized on first use, which is thread safe
+    static QList<Encoding*> encodings = intializeEncodings();
+
+    return encodings;
+}
 
 QList<Encoding*> Encoding::intializeEncodings(){
+    TRACE_SCOPE("Encoding::initialize");
+
+    // The encodings of the user configuration directory replace the built-in ones
+    QFile file(userConfigDir() + "/encodings.xml");
+    if (file.exists()) {
+        if (file.open(QFile::ReadOnly | QIODevice::Text)) {
+            QXmlStreamReader xml(&file);
+            QList<Encoding*> encodings = processEncodingsXml(xml);
+            if (!xml.hasError()) {
+                return encodings;
+            }
+            qWarning("Error while parsing the encodings file %s: %s.", qPrintable(file.fileName()),
+                    qPrintable(xml.errorString()));
+            qDeleteAll(encodings);
+        } else {
+            qWarning("Unable to open the encodings file %s.", qPrintable(file.fileName()));
+        }
+    }
+
     QList<Encoding*> encodings;
+    for (int i = 0; i < BuiltinTables::encodingCount; ++i) {
+        const BuiltinTables::EncodingEntry &entry = BuiltinTables::encodings[i];
+        encodings << new Encoding(QString::fromUtf8(entry.language), QString::fromUtf8(entry.displayName),
+                QByteArray(entry.name), (EncodingCategory) entry.category);
+    }
+
+    return encodings;
+}
 
-    // Make sure the resources are initialized
-    Q_INIT_RESOURCE(qtscitntillaeditor);
-    // Open the encoding xml file for reading
-    QFile file(":/conf/conf/encodings.xml");
-    if (file.open(QFile::ReadOnly | QIODevice::Text)) {
-        QXmlStreamReader xml(&file);
-        EncodingCategory currentCategory = WestEuropean;
-        // Loop through the xml elements
-        while (!xml.atEnd() && !xml.hasError()) {
-            QXmlStreamReader::TokenType token = xml.readNext();
-            if (token == QXmlStreamReader::StartElement) {
-                if (xml.name() == "category") {
-                    // New category element, get the id
-                    bool ok;
-                    int id = xml.attributes().value("id").toString().toInt(&ok);
-                    if (ok && id >= 0 && id <= 5) {
-                        currentCategory = (EncodingCategory) id;
-                    } else {
-                        qWarning("id attribute of category element is invalid");
-                    }
-                } else if (xml.name() == "encoding") {
-                    // New encoding element, add it to the list
-                    QString language = xml.attributes().value("language").toString();
-                    QString displayName = xml.attributes().value("displayName").toString();
-                    QByteArray name = xml.attributes().value("name").toLocal8Bit();
-                    encodings << new Encoding(language, displayName,
-                            name, currentCategory);
+QList<Encoding*> Encoding::processEncodingsXml(QXmlStreamReader &xml) {
+    QList<Encoding*> encodings;
+
+    EncodingCategory currentCategory = WestEuropean;
+    // Loop through the xml elements
+    while (!xml.atEnd() && !xml.hasError()) {
+        QXmlStreamReader::TokenType token = xml.readNext();
+        if (token == QXmlStreamReader::StartElement) {
+            if (xml.name() == "category") {
+                // New category element, get the id
+                bool ok;
+                int id = xml.attributes().value("id").toString().toInt(&ok);
+                if (ok && id >= 0 && id <= 5) {
+                    currentCategory = (EncodingCategory) id;
+                } else {
+                    qWarning("id attribute of category element is invalid");
                 }
+            } else if (xml.name() == "encoding") {
+                // New encoding element, add it to the list
+                QString language = xml.attributes().value("language").toString();
+                QString displayName = xml.attributes().value("displayName").toString();
+                QByteArray name = xml.attributes().value("name").toLocal8Bit();
+                encodings << new Encoding(language, displayName,
+                        name, currentCategory);
             }
         }
-        if (xml.hasError()) {
-            qFatal("Error while parsing the encodings configuration file: %s.",
-                qPrintable(xml.errorString().toLatin1()));
-        }
-    } else {
-        qFatal("Unable to open the encodings configuration file.");
     }
 
     return encodings;
 }
 
 void Encoding::cleanup() {
-    for (int i = 0; i < availableEncodings.size(); ++i) {
-        delete availableEncodings.at(i);
-    }
+    qDeleteAll(availableEncodings());
+    availableEncodings().clear();
 }
 
 Encoding::EncodingCategory Encoding::category() const {
@@ -0,0 +1,416 @@
+#include "fileindex.h"
+
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+namespace {
+
+/**
+ * A candidate produced by the scoring of a file.
+ */
+struct Candidate {
+    int score;
+    int index;
+};
+
+/**
+ * A slice of the entries, scored by a single worker.
+ */
+struct Chunk {
+    int begin;
+    int end;
+    QVector<Candidate> candidates;
+};
+
+/** The minimum number of entries for which the scoring runs in parallel. */
+const int ParallelThreshold = 4096;
+
+/**
+ * Orders the candidates by descending score.
+ */
+bool betterCandidate(const Candidate &a, const Candidate &b) {
+    return a.score != b.score ? a.score > b.score : a.index < b.index;
+}
+
+/**
+ * Returns true if a character separates the words of a path.
+ */
+inline bool isSeparator(char c) {
+    return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+/**
+ * Matches the pattern greedily in the text, starting from an offset.
+ *
+ * @return The score of the match, or -1 if the pattern is not a subsequence of
+ * the text.
+ */
+int greedyScore(const char *pattern, int patternLength, const char *text,
+        int textLength, int from, int fileNameStart) {
+    int score = 0;
+    int p = 0;
+    int lastMatch = -2;
+    for (int i = from; i < textLength && p < patternLength; ++i) {
+        if (text[i] != pattern[p]) {
+            continue;
+        }
+        int bonus = 1;
+        if (i == lastMatch + 1) {
+            // Consecutive characters
+            bonus += 5;
+        }
+        if (i == 0 || isSeparator(text[i - 1])) {
+            // Start of a word
+            bonus += 8;
+        }
+        if (i >= fileNameStart) {
+            // Matches in the file name are preferred to matches in the directory
+            bonus += 2;
+        }
+        score += bonus;
+        lastMatch = i;
+        ++p;
+    }
+
+    return p == patternLength ? score : -1;
+}
+
+}
+
+FileIndex* FileIndex::instance() {
+    static FileIndex instance;
+
+    return &instance;
+}
+
+QString FileIndex::projectRoot(const QDir &dir) {
+    QDir current(dir);
+    do {
+        if (current.exists(".git") || current.exists(".hg") || current.exists(".svn")) {
+            return current.absolutePath();
+        }
+    } while (current.cdUp());
+
+    return dir.absolutePath();
+}
+
+int FileIndex::score(const QByteArray &pattern, quint64 patternMask, const Entry &entry) {
+    // Reject the entry early if it does not contain all the pattern characters
+    if (patternMask & ~entry.mask) {
+        return -1;
+    }
+    const char *text = entry.key.constData();
+    int textLength = entry.key.size();
+    int score = greedyScore(pattern.constData(), pattern.size(), text, textLength, 0,
+            entry.fileNameStart);
+    if (score < 0) {
+        return -1;
+    }
+    // The greedy match might have consumed characters from the directory, check
+    // if the whole pattern can be matched in the file name.
+    if (entry.fileNameStart > 0) {
+        score = std::max(score, greedyScore(pattern.constData(), pattern.size(), text,
+                textLength, entry.fileNameStart, entry.fileNameStart));
+    }
+
+    // Prefer shorter paths for equal matches
+    return score * 64 - std::min(textLength, 63);
+}
+
+QByteArray FileIndex::foldKey(const QString &text) {
+    QByteArray key = text.toLower().toUtf8();
+    key.replace(' ', "");
+
+    return key;
+}
+
+quint64 FileIndex::charMask(const QByteArray &key) {
+    quint64 mask = 0;
+    for (int i = 0; i < key.size(); ++i) {
+        mask |= Q_UINT64_C(1) << (static_cast<uchar>(key.at(i)) & 63);
+    }
+
+    return mask;
+}
+
+QString FileIndex::rootPath() const {
+    return m_rootPath;
+}
+
+void FileIndex::setRootPath(const QString &rootPath) {
+    QString path = QDir(rootPath).absolutePath();
+    if (path == m_rootPath) {
+        return;
+    }
+    // Clear the index and start crawling the new root
+    m_rootPath = path;
+    ++m_generation;
+    m_runningCrawls = 0;
+    m_directories.clear();
+    m_pendingDirectories.clear();
+    m_changedDirectories.clear();
+    m_entries.clear();
+    m_entriesDirty = false;
+    if (!m_watcher.directories().isEmpty()) {
+        m_watcher.removePaths(m_watcher.directories());
+    }
+    emit indexChanged();
+
+    startCrawl(QStringList(""), true);
+}
+
+bool FileIndex::isCrawling() const {
+    return m_runningCrawls > 0;
+}
+
+int FileIndex::fileCount() const {
+    return entries().size();
+}
+
+QList<FileIndex::Match> FileIndex::match(const QString &query, int maxResults) const {
+    QList<Match> matches;
+    const QVector<Entry> &allEntries = entries();
+    QByteArray pattern = foldKey(query);
+    if (pattern.isEmpty()) {
+        // Nothing to match, return the first files
+        for (int i = 0; i < allEntries.size() && i < maxResults; ++i) {
+            Match match = { allEntries.at(i).path, 0 };
+            matches << match;
+        }
+        return matches;
+    }
+    quint64 patternMask = charMask(pattern);
+
+    // Split the entries in one chunk per core, and keep the best candidates of
+    // each chunk.
+    int chunkCount = allEntries.size() < ParallelThreshold ?
+            1 : QThread::idealThreadCount();
+    chunkCount = std::max(chunkCount, 1);
+    QVector<Chunk> chunks(chunkCount);
+    int chunkSize = (allEntries.size() + chunkCount - 1) / chunkCount;
+    for (int i = 0; i < chunkCount; ++i) {
+        chunks[i].begin = std::min(i * chunkSize, allEntries.size());
+        chunks[i].end = std::min(chunks[i].begin + chunkSize, allEntries.size());
+    }
+    auto scoreChunk = [&](Chunk &chunk) {
+        for (int i = chunk.begin; i < chunk.end; ++i) {
+            int s = score(pattern, patternMask, allEntries.at(i));
+            if (s >= 0) {
+                Candidate candidate = { s, i };
+                chunk.candidates << candidate;
+            }
+        }
+        if (chunk.candidates.size() > maxResults) {
+            std::partial_sort(chunk.candidates.begin(),
+                    chunk.candidates.begin() + maxResults,
+                    chunk.candidates.end(), betterCandidate);
+            chunk.candidates.resize(maxResults);
+        }
+    };
+    if (chunkCount == 1) {
+        scoreChunk(chunks[0]);
+    } else {
+        QtConcurrent::blockingMap(chunks, scoreChunk);
+    }
+
+    // Merge the results of the chunks
+    QVector<Candidate> candidates;
+    for (int i = 0; i < chunks.size(); ++i) {
+        candidates << chunks.at(i).candidates;
+    }
+    int resultCount = std::min(candidates.size(), maxResults);
+    std::partial_sort(candidates.begin(), candidates.begin() + resultCount,
+            candidates.end(), betterCandidate);
+    for (int i = 0; i < resultCount; ++i) {
+        Match match = { allEntries.at(candidates.at(i).index).path, candidates.at(i).score };
+        matches << match;
+    }
+
+    return matches;
+}
+
+void FileIndex::onCrawlFinished() {
+    QFutureWatcher<CrawlResult> *watcher = static_cast<QFutureWatcher<CrawlResult>*>(sender());
+    watcher->deleteLater();
+    if (watcher->property("generation").toInt() != m_generation) {
+        // The root path has changed since the crawl started
+        return;
+    }
+    --m_runningCrawls;
+    QStringList directories = watcher->property("directories").toStringList();
+    QStringList changedDirectories;
+    for (int i = 0; i < directories.size(); ++i) {
+        m_pendingDirectories.remove(directories.at(i));
+        if (m_changedDirectories.remove(directories.at(i))) {
+            changedDirectories << directories.at(i);
+        }
+    }
+
+    // Merge the crawled directories and start watching the new ones
+    CrawlResult result = watcher->result();
+    QStringList watchPaths;
+    QHashIterator<QString, QVector<Entry> > iter(result.files);
+    while (iter.hasNext()) {
+        iter.next();
+        if (!m_directories.contains(iter.key())) {
+            watchPaths << absolutePath(iter.key());
+        }
+        m_directories[iter.key()] = iter.value();
+    }
+    if (!watchPaths.isEmpty()) {
+        // Directories beyond the inotify watch limit are silently not watched
+        m_watcher.addPaths(watchPaths);
+    }
+
+    // Crawl the new subdirectories of the directories that were listed again,
+    // skipping the ones that are already being crawled, and remove the
+    // subdirectories that no longer exist.
+    QStringList newDirectories;
+    QHashIterator<QString, QStringList> listed(result.subdirectories);
+    while (listed.hasNext()) {
+        listed.next();
+        const QStringList &subdirectories = listed.value();
+        for (int i = 0; i < subdirectories.size(); ++i) {
+            const QString &subdirectory = subdirectories.at(i);
+            if (!m_directories.contains(subdirectory) && !m_pendingDirectories.contains(subdirectory)) {
+                newDirectories << subdirectory;
+            }
+        }
+        QString prefix = listed.key().isEmpty() ? QString() : listed.key() + '/';
+        QStringList known = m_directories.keys();
+        for (int i = 0; i < known.size(); ++i) {
+            const QString &candidate = known.at(i);
+            if (!candidate.isEmpty() && candidate.startsWith(prefix) &&
+                    candidate.indexOf('/', prefix.size()) == -1 &&
+                    !subdirectories.contains(candidate)) {
+                removeDirectory(candidate);
+            }
+        }
+    }
+    if (!newDirectories.isEmpty()) {
+        startCrawl(newDirectories, true);
+    }
+    if (!changedDirectories.isEmpty()) {
+        // The listing of these directories might predate their last change
+        startCrawl(changedDirectories, false);
+    }
+    m_entriesDirty = true;
+
+    emit indexChanged();
+}
+
+void FileIndex::onDirectoryChanged(const QString &path) {
+    QString directory = QDir(m_rootPath).relativeFilePath(path);
+    if (directory == ".") {
+        directory = "";
+    }
+    if (m_pendingDirectories.contains(directory)) {
+        // The directory is being crawled, list it again when the crawl finishes
+        m_changedDirectories.insert(directory);
+    } else if (QFileInfo(path).isDir()) {
+        // List the directory again on a worker thread, its new subdirectories
+        // are crawled when the listing finishes.
+        startCrawl(QStringList(directory), false);
+    } else {
+        removeDirectory(directory);
+        m_entriesDirty = true;
+
+        emit indexChanged();
+    }
+}
+
+FileIndex::FileIndex() : m_generation(0), m_runningCrawls(0), m_entriesDirty(false) {
+    connect(&m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(onDirectoryChanged(QString)));
+}
+
+FileIndex::CrawlResult FileIndex::crawl(const QString &rootPath, const QStringList &directories,
+        bool recursive) {
+    CrawlResult result;
+    QStringList pending = directories;
+    while (!pending.isEmpty()) {
+        QString directory = pending.takeLast();
+        QVector<Entry> files;
+        if (recursive) {
+            listDirectory(rootPath, directory, &files, &pending);
+        } else {
+            listDirectory(rootPath, directory, &files, &result.subdirectories[directory]);
+        }
+        result.files.insert(directory, files);
+    }
+
+    return result;
+}
+
+void FileIndex::listDirectory(const QString &rootPath, const QString &directory,
+        QVector<Entry> *files, QStringList *subdirectories) {
+    QString prefix = directory.isEmpty() ? QString() : directory + '/';
+    QDirIterator iter(directory.isEmpty() ? rootPath : rootPath + '/' + directory,
+            QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+    while (iter.hasNext()) {
+        iter.next();
+        QFileInfo fileInfo = iter.fileInfo();
+        QString name = fileInfo.fileName();
+        if (name.startsWith('.')) {
+            // Skip hidden files and version control directories
+            continue;
+        }
+        if (fileInfo.isDir()) {
+            if (!fileInfo.isSymLink()) {
+                *subdirectories << prefix + name;
+            }
+        } else {
+            Entry entry;
+            entry.path = prefix + name;
+            entry.key = foldKey(entry.path);
+            entry.fileNameStart = entry.key.lastIndexOf('/') + 1;
+            entry.mask = charMask(entry.key);
+            *files << entry;
+        }
+    }
+}
+
+void FileIndex::startCrawl(const QStringList &directories, bool recursive) {
+    QFutureWatcher<CrawlResult> *watcher = new QFutureWatcher<CrawlResult>(this);
+    watcher->setProperty("generation", m_generation);
+    watcher->setProperty("directories", directories);
+    connect(watcher, SIGNAL(finished()), this, SLOT(onCrawlFinished()));
+    ++m_runningCrawls;
+    for (int i = 0; i < directories.size(); ++i) {
+        m_pendingDirectories.insert(directories.at(i));
+    }
+    watcher->setFuture(QtConcurrent::run(&FileIndex::crawl, m_rootPath, directories, recursive));
+}
+
+void FileIndex::removeDirectory(const QString &directory) {
+    QString prefix = directory + '/';
+    QStringList known = m_directories.keys();
+    for (int i = 0; i < known.size(); ++i) {
+        if (known.at(i) == directory || known.at(i).startsWith(prefix)) {
+            m_directories.remove(known.at(i));
+            m_watcher.removePath(absolutePath(known.at(i)));
+        }
+    }
+}
+
+QString FileIndex::absolutePath(const QString &directory) const {
+    return directory.isEmpty() ? m_rootPath : m_rootPath + '/' + directory;
+}
+
+const QVector<FileIndex::Entry> &FileIndex::entries() const {
+    if (m_entriesDirty) {
+        m_entries.clear();
+        QHashIterator<QString, QVector<Entry> > iter(m_directories);
+        while (iter.hasNext()) {
+            m_entries << iter.next().value();
+        }
+        m_entriesDirty = false;
+    }
+
+    return m_entries;
+}
@@ -0,0 +1,59 @@
+#include "buffer.h"
+#include "fileloader.h"
+#include "trace.h"
+
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+FileLoader::FileLoader(QObject *parent) : QObject(parent), m_pending(0) {
+}
+
+void FileLoader::load(const QStringList &fileNames, const QByteArray &encoding) {
+    // Start with the small files, the pool runs the tasks in order
+    QList<QPair<qint64, QString> > files;
+    for (int i = 0; i < fileNames.size(); ++i) {
+        files << qMakePair(QFileInfo(fileNames.at(i)).size(), fileNames.at(i));
+    }
+    std::stable_sort(files.begin(), files.end(),
+            [](const QPair<qint64, QString> &a, const QPair<qint64, QString> &b) {
+        return a.first < b.first;
+    });
+
+    for (int i = 0; i < files.size(); ++i) {
+        QFutureWatcher<Result> *watcher = new QFutureWatcher<Result>(this);
+        connect(watcher, SIGNAL(finished()), this, SLOT(onReadFinished()));
+        watcher->setFuture(QtConcurrent::run(&FileLoader::read, files.at(i).second, encoding));
+        ++m_pending;
+    }
+    if (m_pending == 0) {
+        emit finished();
+    }
+}
+
+void FileLoader::onReadFinished() {
+    QFutureWatcher<Result> *watcher = static_cast<QFutureWatcher<Result>*>(sender());
+    Result result = watcher->result();
+    watcher->deleteLater();
+
+    if (result.ok) {
+        emit fileLoaded(result.fileName, result.content);
+    } else {
+        emit fileFailed(result.fileName);
+    }
+    if (--m_pending == 0) {
+        emit finished();
+    }
+}
+
+FileLoader::Result FileLoader::read(const QString &fileName, const QByteArray &encoding) {
+    TRACE_SCOPE("FileLoader::read");
+
+    Result result;
+    result.fileName = fileName;
+    result.content = Buffer::readFile(fileName, encoding, &result.ok);
+
+    return result;
+}
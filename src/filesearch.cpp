@@ -0,0 +1,201 @@
+#include "filesearch.h"
+
+#include <QtConcurrentMap>
+
+#include <algorithm>
+
+namespace {
+
+/** The size of the blocks of the line index. */
+const qint64 BlockSize = 64 * 1024;
+
+/** The approximate size of the chunks searched by find next and find previous. */
+const qint64 SearchChunkSize = 4 * 1024 * 1024;
+
+/**
+ * A block of the file, whose lines are counted by a single worker.
+ */
+struct Block {
+    qint64 begin;
+    qint64 end;
+    qint64 lineStarts;
+};
+
+}
+
+FileSearch::FileSearch(const QString &fileName) : m_file(fileName), m_data(0), m_size(0) {
+}
+
+FileSearch::~FileSearch() {
+    if (m_data && m_size > 0) {
+        m_file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_data)));
+    }
+    m_file.close();
+}
+
+bool FileSearch::open() {
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size > 0) {
+        uchar *data = m_file.map(0, m_size);
+        if (!data) {
+            qWarning("Cannot map file %s", qPrintable(m_file.fileName()));
+            m_file.close();
+            return false;
+        }
+        m_data = reinterpret_cast<const char*>(data);
+    } else {
+        m_data = "";
+    }
+
+    // Count the lines of each block in parallel, the disk is the bottleneck
+    QVector<Block> blocks((m_size + BlockSize - 1) / BlockSize);
+    for (int i = 0; i < blocks.size(); ++i) {
+        blocks[i].begin = i * BlockSize;
+        blocks[i].end = std::min(blocks[i].begin + BlockSize, m_size);
+        blocks[i].lineStarts = 0;
+    }
+    QtConcurrent::blockingMap(blocks, [this](Block &block) {
+        block.lineStarts = countLineStarts(block.begin, block.end);
+    });
+    m_blockLines.resize(blocks.size() + 1);
+    m_blockLines[0] = 0;
+    for (int i = 0; i < blocks.size(); ++i) {
+        m_blockLines[i + 1] = m_blockLines.at(i) + blocks.at(i).lineStarts;
+    }
+
+    return true;
+}
+
+bool FileSearch::isOpen() const {
+    return m_data != 0;
+}
+
+qint64 FileSearch::size() const {
+    return m_size;
+}
+
+const char *FileSearch::data() const {
+    return m_data;
+}
+
+qint64 FileSearch::lineCount() const {
+    return m_blockLines.isEmpty() ? 0 : m_blockLines.last() + 1;
+}
+
+qint64 FileSearch::lineFromPosition(qint64 position) const {
+    position = qBound<qint64>(0, position, m_size);
+    qint64 block = position / BlockSize;
+
+    return m_blockLines.at(block) + countLineStarts(block * BlockSize, position);
+}
+
+qint64 FileSearch::positionFromLine(qint64 line) const {
+    if (line <= 0) {
+        return 0;
+    } else if (line >= lineCount()) {
+        return m_size;
+    }
+
+    // Find the block that contains the end of the previous line, and scan it
+    int block = std::lower_bound(m_blockLines.constBegin(), m_blockLines.constEnd(), line) -
+            m_blockLines.constBegin() - 1;
+    qint64 lines = m_blockLines.at(block);
+    for (qint64 i = block * BlockSize; i < m_size; ++i) {
+        char c = m_data[i];
+        if (c == '\n' || (c == '\r' && (i + 1 == m_size || m_data[i + 1] != '\n'))) {
+            if (++lines == line) {
+                return i + 1;
+            }
+        }
+    }
+
+    return m_size;
+}
+
+bool FileSearch::findNext(const TextSearch &search, qint64 from, TextSearch::Match *match) const {
+    if (!m_data) {
+        return false;
+    }
+    // Search chunks of whole lines, starting from the position itself, so
+    // that the matches that start inside an earlier one are not skipped
+    qint64 begin = qBound<qint64>(0, from, m_size);
+    while (true) {
+        qint64 end = begin + SearchChunkSize >= m_size ? m_size : nextLineStart(begin + SearchChunkSize);
+        QVector<TextSearch::Match> matches = search.findAll(m_data, m_size, begin, end);
+        if (!matches.isEmpty()) {
+            *match = matches.first();
+            return true;
+        }
+        if (end >= m_size) {
+            break;
+        }
+        begin = end;
+    }
+
+    return false;
+}
+
+bool FileSearch::findPrevious(const TextSearch &search, qint64 from, TextSearch::Match *match) const {
+    if (!m_data) {
+        return false;
+    }
+    // Search chunks of whole lines backwards, starting from the line of the position
+    from = qBound<qint64>(0, from, m_size);
+    qint64 end = from >= m_size ? m_size : nextLineStart(from);
+    while (true) {
+        qint64 begin = end - SearchChunkSize <= 0 ? 0 : lineStart(end - SearchChunkSize);
+        QVector<TextSearch::Match> matches = search.findAll(m_data, m_size, begin, end);
+        for (int i = matches.size() - 1; i >= 0; --i) {
+            const TextSearch::Match &found = matches.at(i);
+            if (found.start >= from) {
+                continue;
+            }
+            // Every other match starts inside one of the matches found, try
+            // the starts inside this one from the last
+            for (qint64 start = std::min(found.end, from) - 1; start > found.start; --start) {
+                if (search.matchAt(m_data, m_size, start, match) && match->end <= from) {
+                    return true;
+                }
+            }
+            if (found.end <= from) {
+                *match = found;
+                return true;
+            }
+        }
+        if (begin == 0) {
+            break;
+        }
+        end = begin;
+    }
+
+    return false;
+}
+
+QVector<TextSearch::Match> FileSearch::findAll(const TextSearch &search, int threadCount) const {
+    if (!m_data) {
+        return QVector<TextSearch::Match>();
+    }
+
+    return search.findAllParallel(m_data, m_size, threadCount);
+}
+
+qint64 FileSearch::countLineStarts(qint64 begin, qint64 end) const {
+    qint64 count = 0;
+    for (qint64 i = begin; i < end; ++i) {
+        char c = m_data[i];
+        count += (c == '\n') + (c == '\r' && (i + 1 == m_size || m_data[i + 1] != '\n'));
+    }
+
+    return count;
+}
+
+qint64 FileSearch::lineStart(qint64 position) const {
+    return positionFromLine(lineFromPosition(position));
+}
+
+qint64 FileSearch::nextLineStart(qint64 position) const {
+    return positionFromLine(lineFromPosition(position) + 1);
+}
@@ -36,6 +36,14 @@ void FindReplaceDialog::on_findPushButton_clicked() {
     }
 }
 
+void FindReplaceDialog::on_findAllPushButton_clicked() {
+    QString findText = ui->findLindEdit->text();
+    if (!findText.isEmpty()) {
+        // Emit the signal
+        emit findAll(findText, searchFlags());
+    }
+}
+
 void FindReplaceDialog::on_replacePushButton_clicked() {
     QString findText = ui->findLindEdit->text();
     QString replaceText = ui->replaceLineEdit->text();
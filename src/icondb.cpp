@@ -1,5 +1,49 @@
 #include "icondb.h"
 
+namespace {
+
+/**
+ * The file of an icon, and whether it is available in the large sizes.
+ */
+struct IconFile {
+    const char *name;
+    bool allSizes;
+};
+
+/**
+ * The files of the icons, in the order of the Icon enumeration.
+ */
+const IconFile iconFiles[] = {
+    { "accessories-text-editor", true },
+    { "document-new", false },
+    { "document-open", false },
+    { "view-refresh", false },
+    { "document-save", false },
+    { "document-save-as", false },
+    { "document-print", false },
+    { "document-close", false },
+    { "application-exit", false },
+    { "edit-undo", false },
+    { "edit-redo", false },
+    { "edit-cut", false },
+    { "edit-copy", false },
+    { "edit-paste", false },
+    { "edit-find", false },
+    { "edit-find-replace", false },
+    { "view-fullscreen", false },
+    { "zoom-in", false },
+    { "zoom-out", false },
+    { "zoom-original", false },
+    { "preferences-desktop-font", false },
+    { "bookmarks", false },
+    { "help-about", false },
+    { "dialog-ok", false },
+    { "dialog-close", false },
+    { "dialog-cancel", false }
+};
+
+}
+
 IconDb* IconDb::instance() {
     static IconDb instance;
 
@@ -7,140 +51,24 @@ IconDb* IconDb::instance() {
 }
 
 QIcon IconDb::getIcon(Icon icon) {
-    return iconMap[icon];
+    QMap<Icon, QIcon>::const_iterator iter = iconMap.constFind(icon);
+    if (iter != iconMap.constEnd()) {
+        return iter.value();
+    }
+
+    // The icon is created on first use. The sizes are given, so that the
+    // images are decoded only when the icon is first painted in a size.
+    static const int sizes[] = { 16, 22, 32, 48, 64 };
+    const IconFile &file = iconFiles[icon];
+    QIcon result;
+    for (int i = 0; i < (file.allSizes ? 5 : 2); ++i) {
+        result.addFile(QString(":/icons/icons/%1x%1/%2.png").arg(sizes[i]).arg(file.name),
+                QSize(sizes[i], sizes[i]));
+    }
+    iconMap[icon] = result;
+
+    return result;
 }
 
 IconDb::IconDb() {
-    QIcon icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/accessories-text-editor.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/accessories-text-editor.png", QSize(22, 22));
-    icon.addFile(":/icons/icons/32x32/accessories-text-editor.png", QSize(32, 32));
-    icon.addFile(":/icons/icons/48x48/accessories-text-editor.png", QSize(48, 48));
-    icon.addFile(":/icons/icons/64x64/accessories-text-editor.png", QSize(64, 64));
-    iconMap[Application] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/document-new.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/document-new.png", QSize(22, 22));
-    iconMap[New] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/document-open.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/document-open.png", QSize(22, 22));
-    iconMap[Open] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/view-refresh.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/view-refresh.png", QSize(22, 22));
-    iconMap[Reopen] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/document-save.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/document-save.png", QSize(22, 22));
-    iconMap[Save] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/document-save-as.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/document-save-as.png", QSize(22, 22));
-    iconMap[SaveAs] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/document-print.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/document-print.png", QSize(22, 22));
-    iconMap[Print] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/document-close.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/document-close.png", QSize(22, 22));
-    iconMap[Close] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/application-exit.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/application-exit.png", QSize(22, 22));
-    iconMap[Quit] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/edit-undo.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/edit-undo.png", QSize(22, 22));
-    iconMap[Undo] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/edit-redo.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/edit-redo.png", QSize(22, 22));
-    iconMap[Redo] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/edit-cut.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/edit-cut.png", QSize(22, 22));
-    iconMap[Cut] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/edit-copy.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/edit-copy.png", QSize(22, 22));
-    iconMap[Copy] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/edit-paste.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/edit-paste.png", QSize(22, 22));
-    iconMap[Paste] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/edit-find.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/edit-find.png", QSize(22, 22));
-    iconMap[Find] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/edit-find-replace.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/edit-find-replace.png", QSize(22, 22));
-    iconMap[Replace] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/view-fullscreen.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/view-fullscreen.png", QSize(22, 22));
-    iconMap[Fullscreen] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/zoom-in.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/zoom-in.png", QSize(22, 22));
-    iconMap[ZoomIn] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/zoom-out.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/zoom-out.png", QSize(22, 22));
-    iconMap[ZoomOut] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/zoom-original.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/zoom-original.png", QSize(22, 22));
-    iconMap[ZoomReset] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/preferences-desktop-font.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/preferences-desktop-font.png", QSize(22, 22));
-    iconMap[Font] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/bookmarks.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/bookmarks.png", QSize(22, 22));
-    iconMap[Bookmark] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/help-about.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/help-about.png", QSize(22, 22));
-    iconMap[About] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/dialog-ok.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/dialog-ok.png", QSize(22, 22));
-    iconMap[DialogOk] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/dialog-close.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/dialog-close.png", QSize(22, 22));
-    iconMap[DialogClose] = icon;
-
-    icon = QIcon();
-    icon.addFile(":/icons/icons/16x16/dialog-cancel.png", QSize(16, 16));
-    icon.addFile(":/icons/icons/22x22/dialog-cancel.png", QSize(22, 22));
-    iconMap[DialogCancel] = icon;
 }
@@ -1,21 +1,124 @@
+#include "builtintables.h"
 #include "language.h"
+#include "trace.h"
+#include "util.h"
 
+#include <QDateTime>
+#include <QDir>
 #include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QObject>
 #include <QStringList>
 #include <QXmlStreamReader>
 
 #include <SciLexer.h>
 
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+/** The number of bytes examined at the start and at the end of a file. */
+const int DetectionLength = 4096;
+
+/** The number of lines examined for vim modelines at the start and at the end. */
+const int ModelineLines = 5;
+
+/**
+ * A line that is typical of a language.
+ */
+struct Signature {
+    /** The expression that matches the line. */
+    const char *pattern;
+
+    /** The language identifier. */
+    const char *language;
+};
+
+/**
+ * The signatures, tried on every line in order. The ones for languages that
+ * are not defined are skipped.
+ */
+const Signature signatures[] = {
+    { "<\\?xml\\s.*", "xml" },
+    { "<![Dd][Oo][Cc][Tt][Yy][Pp][Ee]\\s+[Hh][Tt][Mm][Ll].*", "html" },
+    { "FROM\\s+\\S+.*", "dockerfile" },
+    { "#(include\\s*[<\"]|pragma\\s+\\w|ifndef\\s+\\w+\\s*).*", "cpp" },
+    { "\\s*(package\\s+[A-Za-z0-9_.]+\\s*;|import\\s+java\\.).*", "java" },
+    { "\\s*(from\\s+[A-Za-z0-9_.]+\\s+import\\s.*|import\\s+[A-Za-z0-9_.]+\\s*|def\\s+\\w+\\s*\\(.*\\)\\s*:.*)", "python" }
+};
+
+/**
+ * The language detected for a file, and the file state it was detected for.
+ */
+struct Detection {
+    QDateTime modified;
+    qint64 size;
+    QString languageId;
+};
+
+/**
+ * Returns the interpreter named in a shebang line.
+ */
+QString interpreterFromShebang(const QString &line) {
+    QStringList words = line.mid(2).split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    if (words.isEmpty()) {
+        return QString();
+    }
+    QString interpreter = words.first().section('/', -1);
+    if (interpreter == "env") {
+        // Skip the options and the variable assignments of env
+        interpreter.clear();
+        for (int i = 1; i < words.size(); ++i) {
+            if (!words.at(i).startsWith('-') && !words.at(i).contains('=')) {
+                interpreter = words.at(i).section('/', -1);
+                break;
+            }
+        }
+    }
+
+    return interpreter;
+}
+
+/**
+ * Returns the mode of an emacs modeline, such as -*- mode: python -*-.
+ */
+QString modeFromEmacsModeline(const QString &line) {
+    QRegExp modeline("-\\*-\\s*(.*)\\s*-\\*-");
+    if (modeline.indexIn(line) == -1) {
+        return QString();
+    }
+    QString variables = modeline.cap(1).trimmed();
+    if (!variables.contains(':')) {
+        return variables;
+    }
+    QRegExp mode("(?:^|;)\\s*mode\\s*:\\s*([^;\\s]+)", Qt::CaseInsensitive);
+
+    return mode.indexIn(variables) != -1 ? mode.cap(1) : QString();
+}
+
+/**
+ * Returns the file type of a vim modeline, such as vim: set ft=python:.
+ */
+QString modeFromVimModeline(const QString &line) {
+    QRegExp modeline("(?:^|\\s)(?:vi|vim|ex)(?:[<=>]?\\d+)?:.*(?:ft|filetype|syn|syntax)\\s*=\\s*([A-Za-z0-9_+-]+)");
+
+    return modeline.indexIn(line) != -1 ? modeline.cap(1) : QString();
+}
+
+}
+
 QString Language::filterString() {
     QString filter(QObject::tr("All files (*)"));
     filter.append(";;");
 
-    for (int i = 0; i < availableLangs.size(); ++i) {
-        Language *language = availableLangs.at(i);
+    const QList<Language*> &langs = availableLangs();
+    for (int i = 0; i < langs.size(); ++i) {
+        Language *language = langs.at(i);
         filter.append(QString(QObject::tr("%1 files (%2)")).arg(language->name(),
                 language->patterns()));
-        if (i != availableLangs.size() - 1) {
+        if (i != langs.size() - 1) {
             filter.append(";;");
         }
     }
@@ -24,13 +127,14 @@ QString Language::filterString() {
 }
 
 QListIterator<Language *> Language::allLanguages() {
-    return QListIterator<Language *>(availableLangs);
+    return QListIterator<Language *>(availableLangs());
 }
 
 const Language* Language::fromLanguageId(const QString& languageId) {
-    for (int i = 0; i < availableLangs.size(); ++i) {
-        if (availableLangs.at(i)->langId() == languageId) {
-            return availableLangs.at(i);
+    const QList<Language*> &langs = availableLangs();
+    for (int i = 0; i < langs.size(); ++i) {
+        if (langs.at(i)->langId() == languageId) {
+            return langs.at(i);
         }
     }
     // Not found
@@ -38,106 +142,370 @@ const Language* Language::fromLanguageId(const QString& languageId) {
 }
 
 const Language* Language::fromFilename(const QString& fileName) {
-    // Search for all available languages.
-    for (int i = 0; i < availableLangs.size(); ++i) {
-        Language *currentLang = availableLangs.at(i);
-        QStringList extensions = currentLang->patterns().split(' ');
-        // Search for all extensions.
-        for (int j = 0; j < extensions.size(); ++j) {
-            QRegExp re(extensions.at(j));
-            re.setPatternSyntax(QRegExp::Wildcard);
-            if (re.exactMatch(fileName)) {
-                return availableLangs.at(i);
+    QSharedPointer<const FilenameIndex> indexPointer = filenameIndex();
+    const FilenameIndex &index = *indexPointer;
+
+    // Look up the whole name, then every extension, the longest first
+    int found = index.names.value(fileName, INT_MAX);
+    for (int dot = fileName.indexOf('.'); dot != -1; dot = fileName.indexOf('.', dot + 1)) {
+        found = std::min(found, index.extensions.value(fileName.mid(dot + 1), INT_MAX));
+    }
+
+    // Only the patterns of the languages before the one found can still win.
+    // The expressions are copied, since matching is not thread safe.
+    for (int i = 0; i < index.globs.size() && index.globs.at(i).second < found; ++i) {
+        QRegExp glob = index.globs.at(i).first;
+        if (glob.exactMatch(fileName)) {
+            found = index.globs.at(i).second;
+            break;
+        }
+    }
+
+    return found == INT_MAX ? NULL : availableLangs().at(found);
+}
+
+const Language* Language::fromContent(const QFileInfo& fileInfo, const QByteArray& content) {
+    static QMutex mutex;
+    static QHash<QString, Detection> detections;
+
+    // Look in the cache first
+    QString path = fileInfo.absoluteFilePath();
+    QDateTime modified = fileInfo.lastModified();
+    {
+        QMutexLocker locker(&mutex);
+        QHash<QString, Detection>::const_iterator iter = detections.constFind(path);
+        if (iter != detections.constEnd() && iter->modified == modified && iter->size == fileInfo.size()) {
+            return fromLanguageId(iter->languageId);
+        }
+    }
+
+    // Only the lines at the start and at the end are examined
+    QStringList lines = QString::fromUtf8(content.left(DetectionLength)).split('\n');
+    QStringList lastLines;
+    if (content.size() > DetectionLength) {
+        lines.removeLast();
+        lastLines = QString::fromUtf8(content.right(DetectionLength)).split('\n');
+        lastLines.removeFirst();
+    } else {
+        lastLines = lines;
+    }
+    lastLines = lastLines.mid(std::max(lastLines.size() - ModelineLines, 0));
+
+    const Language *language = NULL;
+
+    // The interpreter of a shebang line
+    if (lines.first().startsWith("#!")) {
+        language = fromInterpreter(interpreterFromShebang(lines.first().trimmed()));
+    }
+
+    // An emacs modeline on the first line, or on the second one after a shebang
+    for (int i = 0; !language && i < std::min(lines.size(), 2); ++i) {
+        language = fromMode(modeFromEmacsModeline(lines.at(i)));
+    }
+
+    // A vim modeline on the first or last lines
+    for (int i = 0; !language && i < std::min(lines.size(), ModelineLines); ++i) {
+        language = fromMode(modeFromVimModeline(lines.at(i)));
+    }
+    for (int i = 0; !language && i < lastLines.size(); ++i) {
+        language = fromMode(modeFromVimModeline(lastLines.at(i)));
+    }
+
+    // The signatures, on the first lines
+    for (int i = 0; !language && i < lines.size(); ++i) {
+        QString line = lines.at(i);
+        line.chop(line.endsWith('\r') ? 1 : 0);
+        for (size_t j = 0; !language && j < sizeof(signatures) / sizeof(signatures[0]); ++j) {
+            const Language *candidate = fromLanguageId(signatures[j].language);
+            if (candidate && QRegExp(signatures[j].pattern).exactMatch(line)) {
+                language = candidate;
             }
         }
     }
-    // Not found
+
+    if (!path.isEmpty()) {
+        QMutexLocker locker(&mutex);
+        Detection detection = { modified, fileInfo.size(), language ? language->langId() : QString() };
+        detections.insert(path, detection);
+    }
+
+    return language;
+}
+
+const Language* Language::fromInterpreter(const QString& interpreter) {
+    if (interpreter.isEmpty()) {
+        return NULL;
+    }
+    // Try the name as is, then without the version, as in python3.8
+    QString unversioned = interpreter;
+    unversioned.remove(QRegExp("[\\d.]+$"));
+    const QList<Language*> &langs = availableLangs();
+    for (int i = 0; i < langs.size(); ++i) {
+        if (langs.at(i)->m_interpreters.contains(interpreter)) {
+            return langs.at(i);
+        }
+    }
+    for (int i = 0; i < langs.size(); ++i) {
+        if (langs.at(i)->m_interpreters.contains(unversioned)) {
+            return langs.at(i);
+        }
+    }
+
     return NULL;
 }
 
-QList<Language*> Language::availableLangs = Language::intializeLangs();
+const Language* Language::fromMode(const QString& mode) {
+    if (mode.isEmpty()) {
+        return NULL;
+    }
+    // The mode is the language identifier, an interpreter or an extension,
+    // as in c++
+    const QList<Language*> &langs = availableLangs();
+    for (int i = 0; i < langs.size(); ++i) {
+        if (langs.at(i)->langId().compare(mode, Qt::CaseInsensitive) == 0) {
+            return langs.at(i);
+        }
+    }
+    const Language *language = fromInterpreter(mode.toLower());
+
+    return language ? language : fromFilename("file." + mode.toLower());
+}
+
+QSharedPointer<const Language::FilenameIndex> Language::filenameIndex(bool reset) {
+    static QMutex mutex;
+    static QSharedPointer<const FilenameIndex> current;
+
+    QMutexLocker locker(&mutex);
+    if (reset) {
+        current.clear();
+        return current;
+    }
+    if (current) {
+        return current;
+    }
+
+    FilenameIndex *index = new FilenameIndex;
+    QRegExp wildcards("[*?\\[]");
+    const QList<Language*> &langs = availableLangs();
+    for (int i = 0; i < langs.size(); ++i) {
+        QStringList patterns = langs.at(i)->patterns().split(' ', QString::SkipEmptyParts);
+        for (int j = 0; j < patterns.size(); ++j) {
+            const QString &pattern = patterns.at(j);
+            if (pattern.startsWith("*.") && !pattern.mid(2).contains(wildcards)) {
+                if (!index->extensions.contains(pattern.mid(2))) {
+                    index->extensions.insert(pattern.mid(2), i);
+                }
+            } else if (!pattern.contains(wildcards)) {
+                if (!index->names.contains(pattern)) {
+                    index->names.insert(pattern, i);
+                }
+            } else {
+                index->globs << qMakePair(QRegExp(pattern, Qt::CaseSensitive, QRegExp::Wildcard), i);
+            }
+        }
+    }
+    current = QSharedPointer<const FilenameIndex>(index);
+
+    return current;
+}
+
+void Language::initialize() {
+    availableLangs();
+}
+
+QList<Language*> &Language::availableLangs() {
+    // Initialized on first use, which is thread safe
+    static QList<Language*> langs = intializeLangs();
+
+    return langs;
+}
 
 QList<Language*> Language::intializeLangs() {
+    TRACE_SCOPE("Language::initialize");
+
+    // The languages file of the user configuration directory replaces the
+    // built-in languages
+    QList<Language*> langs;
+    bool ok = false;
+    if (QFile::exists(userConfigDir() + "/languages.xml")) {
+        langs = readLanguages(userConfigDir() + "/languages.xml", &ok);
+    }
+    if (!ok) {
+        langs = builtinLanguages();
+    }
+
+    // The files of the languages directory add to them or replace some of them
+    QDir dir(userConfigDir() + "/languages");
+    QStringList languageFiles = dir.entryList(QStringList("*.xml"), QDir::Files, QDir::Name);
+    for (int i = 0; i < languageFiles.size(); ++i) {
+        merge(langs, readLanguages(dir.absoluteFilePath(languageFiles.at(i))));
+    }
+
+    return langs;
+}
+
+QList<Language*> Language::builtinLanguages() {
+    QList<Language*> langs;
+    for (int i = 0; i < BuiltinTables::languageCount; ++i) {
+        const BuiltinTables::LanguageEntry &entry = BuiltinTables::languages[i];
+        Language *language = new Language;
+        language->m_langId = QString::fromUtf8(entry.id);
+        language->m_name = QString::fromUtf8(entry.name);
+        language->m_lexer = QString::fromUtf8(entry.lexer);
+        language->m_patterns = QString::fromUtf8(entry.patterns);
+        language->m_interpreters = QString::fromUtf8(entry.interpreters).split(' ', QString::SkipEmptyParts);
+        for (int j = 0; j < entry.keywordCount; ++j) {
+            language->m_keywords << QString::fromUtf8(entry.keywords[j]);
+        }
+        for (int j = 0; j < entry.styleCount; ++j) {
+            const BuiltinTables::StyleDescriptionEntry &style = entry.styles[j];
+            language->m_styles << StyleDescription((uchar) style.style, QString::fromUtf8(style.description));
+            if (style.commentOrString) {
+                language->m_commentOrStringStyles.setBit(style.style);
+            }
+        }
+        langs << language;
+    }
+
+    return langs;
+}
+
+QList<Language*> Language::readLanguages(const QString& fileName, bool *ok) {
+    if (ok) {
+        *ok = false;
+    }
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QIODevice::Text)) {
+        qWarning("Unable to open the languages file %s.", qPrintable(fileName));
+        return QList<Language*>();
+    }
+    QXmlStreamReader xml(&file);
+    QList<Language*> langs = processLanguagesXml(xml);
+    if (xml.hasError()) {
+        qWarning("Error while parsing the languages file %s: %s.", qPrintable(fileName),
+                qPrintable(xml.errorString()));
+        qDeleteAll(langs);
+        return QList<Language*>();
+    }
+    if (ok) {
+        *ok = true;
+    }
+
+    return langs;
+}
+
+QList<const Language*> Language::update(const QList<Language*>& languages) {
+    QList<const Language*> changed = merge(availableLangs(), languages);
+    filenameIndex(true);
+
+    return changed;
+}
+
+QList<const Language*> Language::merge(QList<Language*>& langs, const QList<Language*>& languages) {
+    QList<const Language*> changed;
+    for (int i = 0; i < languages.size(); ++i) {
+        Language *language = languages.at(i);
+        Language *existing = NULL;
+        for (int j = 0; j < langs.size() && !existing; ++j) {
+            if (langs.at(j)->m_langId == language->m_langId) {
+                existing = langs.at(j);
+            }
+        }
+        if (existing) {
+            // Update the language in place, the buffers keep pointers to it
+            existing->m_name = language->m_name;
+            existing->m_lexer = language->m_lexer;
+            existing->m_patterns = language->m_patterns;
+            existing->m_interpreters = language->m_interpreters;
+            existing->m_keywords = language->m_keywords;
+            existing->m_styles = language->m_styles;
+            existing->m_commentOrStringStyles = language->m_commentOrStringStyles;
+            delete language;
+            changed << existing;
+        } else {
+            langs << language;
+            changed << language;
+        }
+    }
+
+    return changed;
+}
+
+QList<Language*> Language::processLanguagesXml(QXmlStreamReader &xml) {
     QList<Language*> langs;
 
-    // Make sure the resources are initialized
-    Q_INIT_RESOURCE(qtscitntillaeditor);
-    // Open the encoding xml file for reading
-    QFile file(":/conf/conf/languages.xml");
-    if (file.open(QFile::ReadOnly | QIODevice::Text)) {
-        QXmlStreamReader xml(&file);
-        // Loop through the xml elements
-        Language *currentLang = NULL;
-        QStringList keywords;
-        QList<StyleDescription> styles;
-        while (!xml.atEnd() && !xml.hasError()) {
-            QXmlStreamReader::TokenType token = xml.readNext();
-            if (token == QXmlStreamReader::StartElement) {
-                if (xml.name() == "language") {
-                    QXmlStreamAttributes attrs = xml.attributes();
-                    currentLang = new Language;
-                    currentLang->m_langId = attrs.value("id").toString();
-                    currentLang->m_name = attrs.value("name").toString();
-                    currentLang->m_lexer = attrs.value("lexer").toString();
-                } else if (xml.name() == "patterns") {
-                    currentLang->m_patterns = xml.readElementText(
-                                QXmlStreamReader::ErrorOnUnexpectedElement);
-                } else if (xml.name() == "keywordSet") {
-                    bool ok;
-                    int id = xml.attributes().value("id").toString().toInt(&ok);
-                    if (ok) {
-                        while (id != keywords.size()) {
-                            keywords.append("");
-                        }
-                        keywords << xml.readElementText(
+    // Loop through the xml elements
+    Language *currentLang = NULL;
+    QStringList keywords;
+    QList<StyleDescription> styles;
+    while (!xml.atEnd() && !xml.hasError()) {
+        QXmlStreamReader::TokenType token = xml.readNext();
+        if (token == QXmlStreamReader::StartElement) {
+            if (xml.name() == "language") {
+                QXmlStreamAttributes attrs = xml.attributes();
+                currentLang = new Language;
+                currentLang->m_langId = attrs.value("id").toString();
+                currentLang->m_name = attrs.value("name").toString();
+                currentLang->m_lexer = attrs.value("lexer").toString();
+            } else if (xml.name() == "patterns") {
+                currentLang->m_patterns = xml.readElementText(
                             QXmlStreamReader::ErrorOnUnexpectedElement);
-                    } else {
-                        qWarning("id attribute of keywordSet element is "
-                                 "invalid");
-                    }
-                } else if (xml.name() == "styleDescription") {
-                    QXmlStreamAttributes attrs = xml.attributes();
-                    QString description = attrs.value("description").toString();
-                    bool ok;
-                    uint style = attrs.value("style").toString().toUInt(&ok);
-                    if (ok && style <= UCHAR_MAX) {
-                        styles << StyleDescription((uchar) style, description);
-                    } else {
-                        qWarning("id attribute of styleDescription element is "
-                                 "invalid");
+            } else if (xml.name() == "interpreters") {
+                currentLang->m_interpreters = xml.readElementText(
+                            QXmlStreamReader::ErrorOnUnexpectedElement).split(QRegExp("\\s+"),
+                            QString::SkipEmptyParts);
+            } else if (xml.name() == "keywordSet") {
+                bool ok;
+                int id = xml.attributes().value("id").toString().toInt(&ok);
+                if (ok) {
+                    while (id != keywords.size()) {
+                        keywords.append("");
                     }
+                    keywords << xml.readElementText(
+                        QXmlStreamReader::ErrorOnUnexpectedElement);
+                } else {
+                    qWarning("id attribute of keywordSet element is "
+                             "invalid");
                 }
-            } else if (token == QXmlStreamReader::EndElement) {
-                if (xml.name() == "keywordSets") {
-                    currentLang->m_keywords = keywords.replaceInStrings(
-                            QRegExp("\\s+"), " ");;
-                    keywords.clear();
-                } else if (xml.name() == "styleDescriptions") {
-                    currentLang->m_styles = styles;
-                    styles.clear();
-                } else if (xml.name() == "language") {
-                    langs << currentLang;
+            } else if (xml.name() == "styleDescription") {
+                QXmlStreamAttributes attrs = xml.attributes();
+                QString description = attrs.value("description").toString();
+                bool ok;
+                uint style = attrs.value("style").toString().toUInt(&ok);
+                if (ok && style <= UCHAR_MAX) {
+                    styles << StyleDescription((uchar) style, description);
+                    QStringRef type = attrs.value("type");
+                    if (type == "comment" || type == "string") {
+                        currentLang->m_commentOrStringStyles.setBit(style);
+                    }
+                } else {
+                    qWarning("id attribute of styleDescription element is "
+                             "invalid");
                 }
             }
+        } else if (token == QXmlStreamReader::EndElement) {
+            if (xml.name() == "keywordSets") {
+                currentLang->m_keywords = keywords.replaceInStrings(
+                        QRegExp("\\s+"), " ");;
+                keywords.clear();
+            } else if (xml.name() == "styleDescriptions") {
+                currentLang->m_styles = styles;
+                styles.clear();
+            } else if (xml.name() == "language") {
+                langs << currentLang;
+            }
         }
-        if (xml.hasError()) {
-            qFatal("Error while parsing the languages configuration file: %s.",
-                qPrintable(xml.errorString()));
-        }
-    } else {
-        qFatal("Unable to find the languages configuration file.");
     }
 
     return langs;
 }
 
 void Language::cleanup() {
-    for (int i = 0; i < availableLangs.size(); ++i) {
-        delete availableLangs.at(i);
-    }
+    qDeleteAll(availableLangs());
+    availableLangs().clear();
 }
 
-Language::Language() {
+Language::Language() : m_commentOrStringStyles(UCHAR_MAX + 1) {
 }
 
 Language::~Language() {
@@ -159,6 +527,10 @@ QString Language::patterns() const {
     return m_patterns;
 }
 
+QStringList Language::interpreters() const {
+    return m_interpreters;
+}
+
 QStringList Language::keywords() const {
     return m_keywords;
 }
@@ -166,3 +538,7 @@ QStringList Language::keywords() const {
 QList<StyleDescription> Language::styles() const {
     return m_styles;
 }
+
+bool Language::isCommentOrStringStyle(int style) const {
+    return style >= 0 && style < m_commentOrStringStyles.size() && m_commentOrStringStyles.testBit(style);
+}
@@ -1,12 +1,151 @@
 #include "qscintillaeditor.h"
 
-#include "colorscheme.h"
-#include "encoding.h"
-#include "language.h"
+#include "buffer.h"
+#include "configuration.h"
+#include "fileloader.h"
+#include "registries.h"
+#include "singleinstance.h"
+#include "trace.h"
 #include "version.h"
 
 #include <QApplication>
 #include <QDebug>
+#include <QDir>
+#include <QPointer>
+#include <QtConcurrentRun>
+
+#include <cstring>
+
+namespace {
+
+/**
+ * Removes an option from the command line.
+ *
+ * @param argc The argument count, updated if the option is removed.
+ * @param argv The arguments.
+ * @param option The option.
+ * @return true if the option was in the command line.
+ */
+bool takeOption(int &argc, char *argv[], const char *option) {
+    bool found = false;
+    int count = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], option) == 0) {
+            found = true;
+        } else {
+            argv[count++] = argv[i];
+        }
+    }
+    argc = count;
+    argv[argc] = nullptr;
+
+    return found;
+}
+
+/**
+ * Returns the file names of the command line.
+ *
+ * @param argc The argument count.
+ * @param argv The arguments.
+ * @return The file names.
+ */
+QStringList fileArguments(int argc, char *argv[]) {
+    QStringList fileNames;
+    for (int i = 1; i < argc; ++i) {
+        fileNames << QString::fromLocal8Bit(argv[i]);
+    }
+
+    return fileNames;
+}
+
+/**
+ * Creates and shows an editor window.
+ *
+ * @return The window.
+ */
+QScintillaEditor *newWindow() {
+    QScintillaEditor *w = new QScintillaEditor;
+    w->show();
+    w->activateWindow();
+
+    // Startup ends with the first paint of the first window
+    static bool first = true;
+    if (first) {
+        first = false;
+        TRACE_FIRST_PAINT(w->findChild<Buffer*>());
+    }
+
+    return w;
+}
+
+/**
+ * Returns the window that opens a file. In the tabbed interface, it is the
+ * active window, or the one that opened the last file, otherwise it is a new
+ * window.
+ *
+ * @return The window.
+ */
+QScintillaEditor *fileWindow() {
+    if (!Configuration::instance()->tabbedInterface()) {
+        return newWindow();
+    }
+    static QPointer<QScintillaEditor> window;
+    QScintillaEditor *active = qobject_cast<QScintillaEditor*>(QApplication::activeWindow());
+    if (active) {
+        window = active;
+    } else if (!window || !window->isVisible()) {
+        window = newWindow();
+    }
+
+    return window;
+}
+
+/**
+ * Opens a file that has been read in a new window, or in a new tab.
+ *
+ * @param fileName The file name.
+ * @param content The contents of the file.
+ */
+void openFileContent(const QString &fileName, const QByteArray &content) {
+    fileWindow()->openFileContent(fileName, content);
+}
+
+/**
+ * Opens a file that cannot be read in a new window or tab, which offers to
+ * create it or reports the error.
+ *
+ * @param fileName The file name.
+ */
+void openFailedFile(const QString &fileName) {
+    fileWindow()->openFile(fileName);
+}
+
+/**
+ * Opens each file in a new window, or in a new tab in the tabbed interface,
+ * or a single empty window if there are no files. The files are read in
+ * parallel, and each file is shown as soon as it has been read.
+ *
+ * @param fileNames The file names, relative to the working directory.
+ * @param workingDir The working directory.
+ */
+void openFiles(const QStringList &fileNames, const QString &workingDir) {
+    if (fileNames.isEmpty()) {
+        newWindow();
+        return;
+    }
+
+    QStringList absoluteFileNames;
+    for (int i = 0; i < fileNames.size(); i++) {
+        absoluteFileNames << QDir(workingDir).absoluteFilePath(fileNames.at(i));
+    }
+    FileLoader *loader = new FileLoader(qApp);
+    QObject::connect(loader, &FileLoader::fileLoaded, openFileContent);
+    QObject::connect(loader, &FileLoader::fileFailed, openFailedFile);
+    QObject::connect(loader, SIGNAL(finished()), loader, SLOT(deleteLater()));
+    loader->load(absoluteFileNames, "UTF-8");
+}
+
+}
 
 /**
  * The application entry point.
@@ -16,31 +155,62 @@
  * @return The exit code.
  */
 int main(int argc, char *argv[]) {
+    TRACE_START(argc, argv);
+
+    // The resources are in the core library, which is static
+    Q_INIT_RESOURCE(qtscitntillaeditor);
+
+    QApplication::setOrganizationName(ORGANIZATION_NAME);
+    QApplication::setOrganizationDomain(ORGANIZATION_DOMAIN);
+    QApplication::setApplicationName(APPLICATION_NAME);
+    QApplication::setApplicationVersion(APPLICATION_VERSION);
+
+    // In single instance mode, hand the files over to the running editor if
+    // there is one. Only a core application is needed for that, which is much
+    // cheaper to create than the GUI one.
+    bool newInstance = takeOption(argc, argv, "--new-instance");
+    bool singleInstance = takeOption(argc, argv, "--single-instance") ||
+            (!newInstance && SingleInstance::enabledInSettings());
+    if (singleInstance && !newInstance) {
+        bool forwarded;
+        {
+            TRACE_SCOPE("SingleInstance::forward");
+            QCoreApplication core(argc, argv);
+            forwarded = SingleInstance::forward(fileArguments(argc, argv), QDir::currentPath());
+        }
+        if (forwarded) {
+            TRACE_FINISH();
+            return 0;
+        }
+    }
+
+    // Read the definitions on a worker thread while the application and the
+    // main window are created. If the window needs them first, it waits.
+    QFuture<void> registries = QtConcurrent::run(initializeRegistries);
+
     // Initialize the application
+    TRACE_BEGIN("QApplication");
     QApplication a(argc, argv);
-
-    a.setOrganizationName(ORGANIZATION_NAME);
-    a.setOrganizationDomain(ORGANIZATION_DOMAIN);
-    a.setApplicationName(APPLICATION_NAME);
-    a.setApplicationVersion(APPLICATION_VERSION);
+    TRACE_END("QApplication");
 
     // Open file names provided as command line arguments
-    if (argc == 1) {
-        QScintillaEditor *w = new QScintillaEditor;
-        w->show();
-    } else {
-        for (int i = 1; i < argc; i++) {
-            QScintillaEditor *w = new QScintillaEditor;
-            w->show();
-            w->openFile(argv[i]);
+    openFiles(fileArguments(argc, argv), QDir::currentPath());
+
+    // Open the files of later launches
+    if (singleInstance) {
+        SingleInstance *instance = new SingleInstance(&a);
+        if (instance->listen()) {
+            QObject::connect(instance, &SingleInstance::filesReceived, openFiles);
+        } else {
+            qWarning("Cannot listen for the files of other launches.");
         }
     }
 
     // Exiting, clean-up static resources
     int exitCode = a.exec();
-    Encoding::cleanup();
-    Language::cleanup();
-    ColorScheme::cleanup();
+    TRACE_FINISH();
+    registries.waitForFinished();
+    cleanupRegistries();
 
     return exitCode;
 }
@@ -0,0 +1,211 @@
+#include "buffer.h"
+#include "matchcounter.h"
+
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+namespace {
+
+/**
+ * Edits larger than this number of bytes cause a full count on the worker
+ * thread, instead of searching the affected lines on the main thread.
+ */
+const qint64 MaxIncrementalLength = 64 * 1024;
+
+/**
+ * Orders the matches by their start position.
+ */
+bool startsBefore(const TextSearch::Match &match, qint64 position) {
+    return match.start < position;
+}
+
+}
+
+MatchCounter::MatchCounter(QObject *parent) :
+        QObject(parent), m_buffer(0), m_ready(false), m_counting(false), m_stale(false),
+        m_modificationCounter(0), m_generation(0) {
+}
+
+void MatchCounter::setBuffer(Buffer *buffer) {
+    if (m_buffer == buffer) {
+        return;
+    }
+    if (m_buffer) {
+        disconnect(m_buffer, 0, this, 0);
+    }
+    m_buffer = buffer;
+    if (m_buffer) {
+        connect(m_buffer, SIGNAL(modified(int,int,int,int,QByteArray,int,int,int)),
+                this, SLOT(onModified(int,int,int,int,QByteArray,int,int,int)));
+        connect(m_buffer, SIGNAL(documentChanged()), this, SLOT(reset()));
+    }
+
+    // Forget the matches of the previous buffer
+    reset();
+}
+
+void MatchCounter::setQuery(const QString &findText, int flags) {
+    if (!m_buffer) {
+        return;
+    }
+    // Reuse the matches if neither the query nor the buffer have changed
+    if (m_search && m_search->findText() == findText && m_search->flags() == flags &&
+            m_modificationCounter == m_buffer->modificationCounter() && (m_ready || m_counting)) {
+        return;
+    }
+
+    m_search = QSharedPointer<const TextSearch>(new TextSearch(findText, flags));
+    m_matches.clear();
+    if (m_search->isValid() && m_search->isExact()) {
+        startCount();
+    } else {
+        // The count is not available for this search. Find and Find All use
+        // Scintilla for the inexact searches, their matches could disagree.
+        ++m_generation;
+        m_search.clear();
+        m_ready = false;
+        m_counting = false;
+    }
+}
+
+bool MatchCounter::isReady() const {
+    return m_ready;
+}
+
+int MatchCounter::count() const {
+    return m_ready ? m_matches.size() : -1;
+}
+
+int MatchCounter::indexOf(qint64 position) const {
+    if (!m_ready) {
+        return -1;
+    }
+    Matches::const_iterator iter = std::lower_bound(m_matches.constBegin(),
+            m_matches.constEnd(), position, startsBefore);
+    if (iter == m_matches.constEnd() || iter->start != position) {
+        return -1;
+    }
+
+    return iter - m_matches.constBegin();
+}
+
+void MatchCounter::onCountFinished() {
+    QFutureWatcher<Matches> *watcher = static_cast<QFutureWatcher<Matches>*>(sender());
+    watcher->deleteLater();
+    if (watcher->property("generation").toInt() != m_generation) {
+        // The query or the buffer have changed since the count started
+        return;
+    }
+    m_counting = false;
+    if (m_stale) {
+        // The snapshot no longer matches the buffer
+        startCount();
+        return;
+    }
+
+    m_matches = watcher->result();
+    m_ready = true;
+    emit countChanged();
+}
+
+void MatchCounter::onModified(int type, int position, int length, int, const QByteArray &,
+        int, int, int) {
+    if (!m_search || !(type & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))) {
+        return;
+    }
+    if (m_counting) {
+        // Count again when the running count has finished
+        m_stale = true;
+        return;
+    }
+    if (!m_ready) {
+        return;
+    }
+
+    bool inserted = type & SC_MOD_INSERTTEXT;
+    if (updateMatches(position, inserted ? length : 0, inserted ? 0 : length)) {
+        m_modificationCounter = m_buffer->modificationCounter();
+        emit countChanged();
+    } else {
+        startCount();
+    }
+}
+
+void MatchCounter::reset() {
+    ++m_generation;
+    m_search.clear();
+    m_matches.clear();
+    m_ready = false;
+    m_counting = false;
+    emit countChanged();
+}
+
+MatchCounter::Matches MatchCounter::findMatches(QSharedPointer<const TextSearch> search,
+        QByteArray text) {
+    return search->findAllParallel(text.constData(), text.size());
+}
+
+void MatchCounter::startCount() {
+    // Take a snapshot of the document, the buffer can change while counting
+    QByteArray text(reinterpret_cast<const char*>(m_buffer->characterPointer()),
+            m_buffer->length());
+
+    ++m_generation;
+    m_ready = false;
+    m_counting = true;
+    m_stale = false;
+    m_modificationCounter = m_buffer->modificationCounter();
+
+    QFutureWatcher<Matches> *watcher = new QFutureWatcher<Matches>(this);
+    watcher->setProperty("generation", m_generation);
+    connect(watcher, SIGNAL(finished()), this, SLOT(onCountFinished()));
+    watcher->setFuture(QtConcurrent::run(&MatchCounter::findMatches, m_search, text));
+}
+
+bool MatchCounter::updateMatches(qint64 position, qint64 inserted, qint64 deleted) {
+    // Matches that can span lines cannot be updated locally
+    if (!m_search->isLineBounded() ||
+            inserted > MaxIncrementalLength || deleted > MaxIncrementalLength) {
+        return false;
+    }
+
+    // Search the whole lines affected by the edit again
+    qint64 documentLength = m_buffer->length();
+    qint64 scanStart = m_buffer->positionFromLine(m_buffer->lineFromPosition(position));
+    qint64 scanEnd = m_buffer->lineEndPosition(m_buffer->lineFromPosition(position + inserted));
+    qint64 delta = inserted - deleted;
+    qint64 scanEndOld = scanEnd - delta;
+
+    // Include one character of context around the lines for the word checks
+    qint64 textStart = std::max<qint64>(scanStart - 1, 0);
+    qint64 textEnd = std::min(scanEnd + 1, documentLength);
+    QByteArray text = m_buffer->get_text_range(textStart, textEnd);
+    Matches found = m_search->findAll(text.constData(), text.size(), scanStart - textStart,
+            textEnd - textStart);
+    Matches replacement;
+    for (int i = 0; i < found.size(); ++i) {
+        TextSearch::Match match = { found.at(i).start + textStart, found.at(i).end + textStart };
+        if (match.start <= scanEnd) {
+            replacement << match;
+        }
+    }
+
+    // Replace the matches of the affected lines, and move the following ones
+    Matches::iterator first = std::lower_bound(m_matches.begin(), m_matches.end(), scanStart,
+            startsBefore);
+    Matches::iterator last = std::lower_bound(first, m_matches.end(), scanEndOld + 1,
+            startsBefore);
+    for (Matches::iterator iter = last; iter != m_matches.end(); ++iter) {
+        iter->start += delta;
+        iter->end += delta;
+    }
+    int index = first - m_matches.begin();
+    m_matches.erase(first, last);
+    for (int i = 0; i < replacement.size(); ++i) {
+        m_matches.insert(index + i, replacement.at(i));
+    }
+
+    return true;
+}
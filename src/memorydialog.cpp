@@ -0,0 +1,111 @@
+#include "memorydialog.h"
+#include "memoryusage.h"
+#include "ui_memorydialog.h"
+
+#include <QHeaderView>
+#include <QTableWidgetItem>
+#include <QTimer>
+
+namespace {
+
+/** The interval between refreshes, in milliseconds. */
+const int RefreshInterval = 1000;
+
+/**
+ * Formats a number of bytes for display.
+ *
+ * @param bytes The number of bytes.
+ * @return The formatted number.
+ */
+QString formatBytes(qint64 bytes) {
+    if (bytes < 1024) {
+        return QString("%1 B").arg(bytes);
+    } else if (bytes < 1024 * 1024) {
+        return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+    } else if (bytes < 1024 * 1024 * 1024) {
+        return QString("%1 MB").arg(bytes / (1024.0 * 1024), 0, 'f', 1);
+    }
+
+    return QString("%1 GB").arg(bytes / (1024.0 * 1024 * 1024), 0, 'f', 2);
+}
+
+/**
+ * Creates a right aligned cell of the table.
+ *
+ * @param text The text of the cell.
+ * @return The cell.
+ */
+QTableWidgetItem *numberItem(const QString &text) {
+    QTableWidgetItem *item = new QTableWidgetItem(text);
+    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+
+    return item;
+}
+
+}
+
+MemoryDialog::MemoryDialog(QWidget *parent) :
+    QDialog(parent), ui(new Ui::MemoryDialog) {
+    ui->setupUi(this);
+
+    ui->usageTable->setColumnCount(8);
+    ui->usageTable->setHorizontalHeaderLabels(QStringList() << tr("Document") << tr("Text") << tr("Styles") <<
+            tr("Undo") << tr("Cached") << tr("Markers") << tr("Indicators") << tr("Total"));
+    ui->usageTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setInterval(RefreshInterval);
+    connect(m_refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+}
+
+MemoryDialog::~MemoryDialog() {
+    delete ui;
+}
+
+void MemoryDialog::showEvent(QShowEvent *e) {
+    QDialog::showEvent(e);
+
+    refresh();
+    m_refreshTimer->start();
+}
+
+void MemoryDialog::hideEvent(QHideEvent *e) {
+    QDialog::hideEvent(e);
+
+    m_refreshTimer->stop();
+}
+
+void MemoryDialog::refresh() {
+    QList<MemoryUsage> usages = MemoryUsage::collect();
+    MemoryUsage total = MemoryUsage::sum(usages);
+    total.name = tr("Total");
+    usages << total;
+
+    ui->usageTable->setRowCount(usages.size());
+    for (int i = 0; i < usages.size(); ++i) {
+        const MemoryUsage &usage = usages.at(i);
+        // The second views of a document use no memory of their own
+        QString name = usage.shared ? tr("%1 (second view)").arg(usage.name) : usage.name;
+        ui->usageTable->setItem(i, 0, new QTableWidgetItem(name));
+        ui->usageTable->setItem(i, 1, numberItem(formatBytes(usage.textBytes)));
+        ui->usageTable->setItem(i, 2, numberItem(formatBytes(usage.styleBytes)));
+        ui->usageTable->setItem(i, 3, numberItem(formatBytes(usage.undoBytes)));
+        ui->usageTable->setItem(i, 4, numberItem(formatBytes(usage.cachedBytes)));
+        ui->usageTable->setItem(i, 5, numberItem(QString::number(usage.markers)));
+        ui->usageTable->setItem(i, 6, numberItem(QString::number(usage.indicators)));
+        ui->usageTable->setItem(i, 7, numberItem(formatBytes(usage.shared ? 0 : usage.totalBytes())));
+    }
+    // Make the totals stand out
+    QFont font = ui->usageTable->font();
+    font.setBold(true);
+    for (int column = 0; column < ui->usageTable->columnCount(); ++column) {
+        ui->usageTable->item(usages.size() - 1, column)->setFont(font);
+    }
+
+    ui->totalLabel->setText(tr("%n document(s), %1 in total", 0, usages.size() - 1).arg(
+            formatBytes(total.totalBytes())));
+}
+
+void MemoryDialog::on_pushButtonClose_clicked() {
+    hide();
+}
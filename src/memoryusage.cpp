@@ -0,0 +1,38 @@
+#include "buffer.h"
+#include "memoryusage.h"
+
+MemoryUsage::MemoryUsage() :
+        shared(false), textBytes(0), styleBytes(0), undoBytes(0), cachedBytes(0), markers(0), indicators(0) {
+}
+
+qint64 MemoryUsage::totalBytes() const {
+    return textBytes + styleBytes + undoBytes + cachedBytes;
+}
+
+QList<MemoryUsage> MemoryUsage::collect() {
+    QList<MemoryUsage> usages;
+    QListIterator<Buffer*> buffers = Buffer::allBuffers();
+    while (buffers.hasNext()) {
+        usages << buffers.next()->memoryUsage();
+    }
+
+    return usages;
+}
+
+MemoryUsage MemoryUsage::sum(const QList<MemoryUsage> &usages) {
+    MemoryUsage total;
+    for (int i = 0; i < usages.size(); ++i) {
+        const MemoryUsage &usage = usages.at(i);
+        if (usage.shared) {
+            continue;
+        }
+        total.textBytes += usage.textBytes;
+        total.styleBytes += usage.styleBytes;
+        total.undoBytes += usage.undoBytes;
+        total.cachedBytes += usage.cachedBytes;
+        total.markers += usage.markers;
+        total.indicators += usage.indicators;
+    }
+
+    return total;
+}
@@ -3,31 +3,60 @@
 #include <QtGlobal>
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFontDialog>
 #include <QInputDialog>
 #include <QLabel>
 #include <QMessageBox>
+#include <QProgressBar>
 #include <QSettings>
+#include <QSplitter>
+#include <QTabBar>
+#include <QTimer>
+#include <QVBoxLayout>
 
 #include "aboutdialog.h"
 #include "buffer.h"
 #include "configuration.h"
 #include "encodingdialog.h"
+#include "fileindex.h"
 #include "findreplacedialog.h"
 #include "icondb.h"
 #include "language.h"
 #include "languagedialog.h"
+#include "matchcounter.h"
+#include "memorydialog.h"
 #include "qscintillaeditor.h"
+#include "quickopendialog.h"
+#include "trace.h"
 #include "ui_qscintillaeditor.h"
 #include "util.h"
 
 QScintillaEditor::QScintillaEditor(QWidget *parent) :
-        QMainWindow(parent), ui(new Ui::QScintillaEditor), workingDir(QDir::home()), wasMaximized(false), findDlg(0),
-        aboutDlg(0), encodingDlg(0), languageDlg(0) {
-    ui->setupUi(this);
+        QMainWindow(parent), ui(new Ui::QScintillaEditor), splitEdit(0), tabBar(0), workingDir(QDir::home()),
+        pendingUiUpdates(0),
+        hadSelection(true), displayedLine(-1), displayedColumn(-1), wasMaximized(false), findDlg(0),
+        lastFindFound(false), lastFindWrapped(false), aboutDlg(0), encodingDlg(0), languageDlg(0),
+        quickOpenDlg(0), memoryDlg(0) {
+    TRACE_SCOPE("QScintillaEditor");
+    {
+        TRACE_SCOPE("QScintillaEditor::setupUi");
+        ui->setupUi(this);
+    }
     edit = new Buffer(parent);
-    setCentralWidget(edit);
+    splitter = new QSplitter(this);
+    splitter->addWidget(edit);
+    if (Configuration::instance()->tabbedInterface()) {
+        setUpTabBar();
+    } else {
+        setCentralWidget(splitter);
+    }
+    matchCounter = new MatchCounter(this);
+    matchCounter->setBuffer(edit);
+    uiUpdateTimer = new QTimer(this);
+    uiUpdateTimer->setSingleShot(true);
+    uiUpdateTimer->setInterval(0);
 
     IconDb* iconDb = IconDb::instance();
     setWindowIcon(iconDb->getIcon(IconDb::Application));
@@ -36,12 +65,18 @@ QScintillaEditor::QScintillaEditor(QWidget *parent) :
     setUpMenuBar();
     setUpStatusBar();
 
-    connect(edit, SIGNAL(savePointChanged(bool)), this, SLOT(savePointChanged(bool)));
+    connect(edit, SIGNAL(modificationChanged(bool)), this, SLOT(savePointChanged(bool)));
     connect(edit, SIGNAL(updateUi(int)), this, SLOT(updateUi(int)));
     connect(edit, SIGNAL(fileInfoChanged(QFileInfo)), this, SLOT(onFileInfoChanged(QFileInfo)));
     connect(edit, SIGNAL(encodingChanged(const Encoding *)), this, SLOT(onEncodingChanged(const Encoding *)));
     connect(edit, SIGNAL(languageChanged(const Language *)), this, SLOT(onLanguageChanged(const Language *)));
     connect(edit, SIGNAL(urlsDropped(QList<QUrl>)), this, SLOT(onUrlsDropped(QList<QUrl>)));
+    connect(edit, SIGNAL(documentChanged()), this, SLOT(onDocumentChanged()));
+    connect(edit, SIGNAL(restoringChanged(bool)), this, SLOT(onRestoringChanged(bool)));
+    connect(edit, SIGNAL(restoreFailed(QString)), this, SLOT(onRestoreFailed(QString)));
+    connect(matchCounter, SIGNAL(countChanged()), this, SLOT(onMatchCountChanged()));
+    connect(uiUpdateTimer, SIGNAL(timeout()), this, SLOT(processUiUpdates()));
+    connect(Configuration::instance(), SIGNAL(changed(QString)), this, SLOT(onConfigurationChanged(QString)));
 }
 
 QScintillaEditor::~QScintillaEditor() {
@@ -49,7 +84,10 @@ QScintillaEditor::~QScintillaEditor() {
 }
 
 void QScintillaEditor::openFile(const QString& fileName) {
-    if (checkModifiedAndSave()) {
+    // In the tabbed interface the file opens in a new tab, unless it is the
+    // file of the current tab being opened again
+    bool replace = !tabBar || (!fileName.isEmpty() && fileName == edit->fileInfo().absoluteFilePath());
+    if (!replace || checkModifiedAndSave()) {
         QString openFileName;
         if (fileName.isEmpty()) {
             // Display the open file dialog
@@ -85,6 +123,9 @@ void QScintillaEditor::openFile(const QString& fileName) {
             }
             // Save the working directory.
             workingDir = fileInfo.absoluteDir();
+            if (!replace) {
+                addTab();
+            }
             // Open the selected file.
             if (!edit->open(openFileName)) {
                 QString message(tr("File '%1' cannot be opened").arg(fileInfo.absoluteFilePath()));
@@ -94,6 +135,14 @@ void QScintillaEditor::openFile(const QString& fileName) {
     }
 }
 
+void QScintillaEditor::openFileContent(const QString& fileName, const QByteArray& content) {
+    workingDir = QFileInfo(fileName).absoluteDir();
+    if (tabBar) {
+        addTab();
+    }
+    edit->setFileContent(fileName, content);
+}
+
 bool QScintillaEditor::eventFilter(QObject *obj, QEvent *event) {
     if (obj == encodingLabel && event->type() == QEvent::MouseButtonDblClick) {
         if (!encodingDlg) {
@@ -124,6 +173,10 @@ bool QScintillaEditor::eventFilter(QObject *obj, QEvent *event) {
 
 
 void QScintillaEditor::on_actionNew_triggered() {
+    if (tabBar) {
+        addTab();
+        return;
+    }
     QScintillaEditor *w = new QScintillaEditor;
     w->show();
 }
@@ -132,6 +185,20 @@ void QScintillaEditor::on_actionOpen_triggered() {
     openFile("");
 }
 
+void QScintillaEditor::on_actionQuickOpen_triggered() {
+    // Index the project that contains the working directory
+    FileIndex::instance()->setRootPath(FileIndex::projectRoot(workingDir));
+    if (!quickOpenDlg) {
+        quickOpenDlg = new QuickOpenDialog(this);
+    }
+    if (quickOpenDlg->exec() == QDialog::Accepted) {
+        QString fileName = quickOpenDlg->selectedFile();
+        if (!fileName.isEmpty()) {
+            openFile(fileName);
+        }
+    }
+}
+
 void QScintillaEditor::on_actionReopen_triggered() {
     openFile(edit->fileInfo().absoluteFilePath());
 }
@@ -153,7 +220,11 @@ void QScintillaEditor::on_actionSaveAs_triggered() {
 }
 
 void QScintillaEditor::on_actionClose_triggered() {
-    edit->clear();
+    if (tabBar) {
+        closeTab(tabBar->currentIndex());
+    } else {
+        edit->clear();
+    }
 }
 
 void QScintillaEditor::on_actionQuit_triggered() {
@@ -221,6 +292,10 @@ void QScintillaEditor::on_actionGoTo_triggered() {
     }
 }
 
+void QScintillaEditor::on_actionGoToEnclosingBrace_triggered() {
+    edit->gotoEnclosingBrace();
+}
+
 void QScintillaEditor::on_actionSelectAll_triggered() {
     edit->selectAll();
 }
@@ -249,6 +324,21 @@ void QScintillaEditor::on_actionFullscreen_triggered() {
     Configuration::instance()->setFullscreen(ui->actionFullscreen->isChecked());
 }
 
+void QScintillaEditor::on_actionSplitHorizontally_triggered() {
+    split(Qt::Vertical);
+}
+
+void QScintillaEditor::on_actionSplitVertically_triggered() {
+    split(Qt::Horizontal);
+}
+
+void QScintillaEditor::on_actionUnsplit_triggered() {
+    delete splitEdit;
+    splitEdit = 0;
+    ui->actionUnsplit->setEnabled(false);
+    edit->setFocus();
+}
+
 void QScintillaEditor::on_actionZoomIn_triggered() {
     edit->zoomIn();
     if (edit->zoom() == 20) {
@@ -291,6 +381,11 @@ void QScintillaEditor::on_actionLongLineIndicator_triggered() {
     Configuration::instance()->setLongLineIndicator(ui->actionLongLineIndicator->isChecked());
 }
 
+void QScintillaEditor::on_actionBracePairColorization_triggered() {
+    edit->setBracePairColorization(ui->actionBracePairColorization->isChecked());
+    Configuration::instance()->setBracePairColorization(ui->actionBracePairColorization->isChecked());
+}
+
 void QScintillaEditor::on_actionEndOfLine_triggered() {
     edit->setViewEOL(ui->actionEndOfLine->isChecked());
     Configuration::instance()->setViewEndOfLine(ui->actionEndOfLine->isChecked());
@@ -313,6 +408,9 @@ void QScintillaEditor::on_actionFoldMargin_triggered() {
 
 void QScintillaEditor::on_actionWordWrap_triggered() {
     edit->setWrapMode(ui->actionWordWrap->isChecked() ? 1 : 0);
+    if (splitEdit) {
+        splitEdit->setWrapMode(edit->wrapMode());
+    }
     Configuration::instance()->setWrap(ui->actionWordWrap->isChecked());
 }
 
@@ -386,6 +484,15 @@ void QScintillaEditor::on_actionClearAllBookmarks_triggered() {
     edit->markerDeleteAll(Buffer::Bookmark);
 }
 
+void QScintillaEditor::on_actionMemoryUsage_triggered() {
+    if (!memoryDlg) {
+        memoryDlg = new MemoryDialog(this);
+    }
+    memoryDlg->show();
+    memoryDlg->raise();
+    memoryDlg->activateWindow();
+}
+
 void QScintillaEditor::on_actionAbout_triggered() {
     if (!aboutDlg) {
         aboutDlg = new AboutDialog(this);
@@ -395,18 +502,22 @@ void QScintillaEditor::on_actionAbout_triggered() {
 
 void QScintillaEditor::find(const QString& findText, int flags, bool forward,
         bool wrap) {
-    bool searchWrapped;
-    bool found = edit->find(findText, flags, forward, wrap, &searchWrapped);
-    if (found) {
-        messageLabel->setText(searchWrapped ? tr("Search wrapped.") : tr(""));
-    } else {
-        messageLabel->setText(tr("The text was not found."));
-    }
+    lastFindFound = edit->find(findText, flags, forward, wrap, &lastFindWrapped);
 
     // Save the last search parameters
     lastFindParams.findText = findText;
     lastFindParams.flags = flags;
     lastFindParams.wrap = wrap;
+
+    // Count the matches in the background, unless they are already counted
+    matchCounter->setQuery(findText, flags);
+    updateFindMessage();
+}
+
+void QScintillaEditor::findAll(const QString& findText, int flags) {
+    int count = edit->selectMatches(findText, flags);
+    lastFindFound = false;
+    messageLabel->setText(count > 0 ? tr("%1 matches selected.").arg(count) : tr("The text was not found."));
 }
 
 void QScintillaEditor::replace(const QString& findText, const QString& replaceText, int flags, bool forward,
@@ -431,34 +542,55 @@ void QScintillaEditor::replace(const QString& findText, const QString& replaceTe
 }
 
 void QScintillaEditor::replaceAll(const QString& findText, const QString& replaceText, int flags) {
-    edit->beginUndoAction();
-    edit->setCurrentPos(0);
-    edit->setAnchor(0);
-    while (edit->find(findText, flags, true, false, NULL)) {
-        QByteArray replaceArray = replaceText.toUtf8();
-        if (flags & SCFIND_REGEXP) {
-            edit->replaceTargetRE(replaceArray.length(), replaceArray);
-        } else {
-            edit->replaceTarget(replaceArray.length(), replaceArray);
-        }
-    }
-    edit->endUndoAction();
+    int count = edit->replaceAll(findText, replaceText, flags);
+    lastFindFound = false;
+    messageLabel->setText(tr("%1 occurences replaced.").arg(count));
 }
 
 void QScintillaEditor::savePointChanged(bool dirty) {
     ui->actionSave->setEnabled(dirty);
-    ui->actionUndo->setEnabled(dirty);
+    // The stored undo history can be undone even if the document is not dirty
+    ui->actionUndo->setEnabled(dirty || edit->isUndoAvailable());
     setTitle();
 }
 
 void QScintillaEditor::updateUi(int updated) {
+    // Only the content and the selection affect the actions and the labels
+    if (updated & (SC_UPDATE_CONTENT | SC_UPDATE_SELECTION)) {
+        pendingUiUpdates |= updated;
+        if (!uiUpdateTimer->isActive()) {
+            uiUpdateTimer->start();
+        }
+    }
+}
+
+void QScintillaEditor::processUiUpdates() {
+    QElapsedTimer timer;
+    timer.start();
+
     // Set the actions that depend on the buffer state
-    ui->actionCut->setEnabled(!edit->selectionEmpty());
-    ui->actionCopy->setEnabled(!edit->selectionEmpty());
+    bool hasSelection = !edit->selectionEmpty();
+    if (hasSelection != hadSelection) {
+        ui->actionCut->setEnabled(hasSelection);
+        ui->actionCopy->setEnabled(hasSelection);
+        hadSelection = hasSelection;
+    }
+    if (pendingUiUpdates & SC_UPDATE_CONTENT) {
+        ui->actionUndo->setEnabled(edit->isModified() || edit->isUndoAvailable());
+    }
     // Set the postition indicator
     int position = edit->currentPos();
-    positionLabel->setText(QString(tr("Line %1, Col %2").arg(edit->lineFromPosition(position) + 1).arg(
-                                       edit->column(position) + 1)));
+    int line = edit->lineFromPosition(position);
+    int column = edit->column(position);
+    if (line != displayedLine || column != displayedColumn) {
+        positionLabel->setText(QString(tr("Line %1, Col %2").arg(line + 1).arg(column + 1)));
+        displayedLine = line;
+        displayedColumn = column;
+    }
+
+    qCDebug(editorUi) << "QScintillaEditor::processUiUpdates" << pendingUiUpdates <<
+            timer.nsecsElapsed() / 1000 << "us";
+    pendingUiUpdates = 0;
 }
 
 void QScintillaEditor::onFileInfoChanged(const QFileInfo& fileInfo) {
@@ -480,7 +612,10 @@ void QScintillaEditor::onUrlsDropped(const QList<QUrl>& urls) {
     for (int i = 0; i < urls.size(); ++i) {
         QUrl url = urls.at(i);
         if (url.isLocalFile()) {
-            if (i == 0) {
+            if (tabBar) {
+                // Each file opens in a new tab
+                openFile(url.toLocalFile());
+            } else if (i == 0) {
                 // Reuse the same window for the first file
                 if (checkModifiedAndSave()) {
                     edit->open(url.toLocalFile());
@@ -495,7 +630,83 @@ void QScintillaEditor::onUrlsDropped(const QList<QUrl>& urls) {
     }
 }
 
+void QScintillaEditor::onMatchCountChanged() {
+    if (lastFindFound) {
+        updateFindMessage();
+    }
+}
+
+void QScintillaEditor::onConfigurationChanged(const QString &key) {
+    // Apply the changes made in other windows, the full screen state is only
+    // used for new windows.
+    Configuration *configuration = Configuration::instance();
+    if (key == "toolbar.visible") {
+        syncAction(ui->actionToolBar, configuration->showToolBar());
+    } else if (key == "statusbar.visible") {
+        syncAction(ui->actionStatusBar, configuration->showStatusBar());
+    } else if (key == "view.whitespace") {
+        syncAction(ui->actionWhitespace, configuration->viewWhitespace());
+    } else if (key == "view.indentation.guides") {
+        syncAction(ui->actionIndentationGuides, configuration->viewIndentationGuides());
+    } else if (key == "view.caret.line") {
+        syncAction(ui->actionHighlightCurrentLine, configuration->caretLineVisible());
+    } else if (key == "long.line.indicator") {
+        syncAction(ui->actionLongLineIndicator, configuration->longLineIndicator());
+    } else if (key == "braces.colorize") {
+        syncAction(ui->actionBracePairColorization, configuration->bracePairColorization());
+    } else if (key == "view.eol") {
+        syncAction(ui->actionEndOfLine, configuration->viewEndOfLine());
+    } else if (key == "line.margin.visible") {
+        syncAction(ui->actionLineNumbers, configuration->showLineMargin());
+    } else if (key == "margin") {
+        syncAction(ui->actionIconMargin, configuration->showIconMargin());
+    } else if (key == "fold") {
+        syncAction(ui->actionFoldMargin, configuration->showFoldMargin());
+    } else if (key == "wrap") {
+        syncAction(ui->actionWordWrap, configuration->wrap());
+    } else if (key == "font.default") {
+        // The other styles copy the default font when the color scheme is applied
+        edit->setStyleQFont(STYLE_DEFAULT, configuration->font());
+        edit->setColorScheme(ColorScheme::getColorScheme(configuration->colorScheme()));
+    } else if (key == "color.scheme") {
+        edit->setColorScheme(ColorScheme::getColorScheme(configuration->colorScheme()));
+    }
+}
+
+void QScintillaEditor::onDocumentChanged() {
+    // The file, encoding and language have been updated by the signals of the buffer
+    if (!edit->fileInfo().fileName().isEmpty()) {
+        workingDir = edit->fileInfo().absoluteDir();
+    }
+    savePointChanged(edit->isModified());
+    ui->actionRedo->setEnabled(edit->canRedo());
+    updateUi(SC_UPDATE_CONTENT | SC_UPDATE_SELECTION);
+}
+
+void QScintillaEditor::onRestoringChanged(bool restoring) {
+    // The time it takes is not known, show a busy indicator
+    restoreProgress->setVisible(restoring);
+    messageLabel->setText(restoring ? tr("Restoring the document...") : QString());
+}
+
+void QScintillaEditor::onRestoreFailed(const QString &fileName) {
+    QString message(tr("File '%1' cannot be read again, open it to replace the document").arg(fileName));
+    QMessageBox::critical(this, tr("Open File Error"), message);
+}
+
+void QScintillaEditor::onTabChanged(int index) {
+    if (index >= 0 && index < documents.size()) {
+        edit->setDocument(documents.at(index));
+    }
+}
+
+void QScintillaEditor::onTabCloseRequested(int index) {
+    closeTab(index);
+}
+
 void QScintillaEditor::setUpActions() {
+    TRACE_SCOPE("QScintillaEditor::setUpActions");
+
     // Set the icon of the actions.
     IconDb* iconDb = IconDb::instance();
     ui->actionNew->setIcon(iconDb->getIcon(IconDb::New));
@@ -532,6 +743,7 @@ void QScintillaEditor::setUpActions() {
     ui->actionIndentationGuides->setChecked(configuration->viewIndentationGuides());
     ui->actionHighlightCurrentLine->setChecked(configuration->caretLineVisible());
     ui->actionLongLineIndicator->setChecked(configuration->longLineIndicator());
+    ui->actionBracePairColorization->setChecked(configuration->bracePairColorization());
     ui->actionEndOfLine->setChecked(configuration->viewEndOfLine());
     ui->actionLineNumbers->setChecked(configuration->showLineMargin());
     ui->actionIconMargin->setChecked(configuration->showIconMargin());
@@ -539,7 +751,15 @@ void QScintillaEditor::setUpActions() {
     ui->actionWordWrap->setChecked(configuration->wrap());
 }
 
+void QScintillaEditor::syncAction(QAction *action, bool checked) {
+    if (action->isChecked() != checked) {
+        action->trigger();
+    }
+}
+
 void QScintillaEditor::setUpMenuBar() {
+    TRACE_SCOPE("QScintillaEditor::setUpMenuBar");
+
     // Add all color schemes to the menu
     QStringList colorSchemeNames = ColorScheme::allColorSchemes();
     for (int i = 0; i < colorSchemeNames.size(); ++i) {
@@ -597,29 +817,105 @@ void QScintillaEditor::setUpEncodingMenu(QMenu *parent, const char* slot) {
 }
 
 void QScintillaEditor::setUpStatusBar() {
+    TRACE_SCOPE("QScintillaEditor::setUpStatusBar");
+
     messageLabel = new QLabel(this);
     languageLabel = new QLabel(edit->language() ? edit->language()->name() : tr("Default text"), this);
     languageLabel->installEventFilter(this);
     encodingLabel = new QLabel(edit->encoding()->toString(), this);
     encodingLabel->installEventFilter(this);
     positionLabel = new QLabel(this);
+    restoreProgress = new QProgressBar(this);
+    restoreProgress->setRange(0, 0);
+    restoreProgress->setMaximumWidth(100);
+    restoreProgress->hide();
 
     statusBar()->addPermanentWidget(messageLabel, 1);
+    statusBar()->addPermanentWidget(restoreProgress);
     statusBar()->addPermanentWidget(languageLabel);
     statusBar()->addPermanentWidget(encodingLabel);
     statusBar()->addPermanentWidget(positionLabel);
 }
 
+void QScintillaEditor::setUpTabBar() {
+    tabBar = new QTabBar(this);
+    tabBar->setDocumentMode(true);
+    tabBar->setExpanding(false);
+    tabBar->setTabsClosable(true);
+    tabBar->setUsesScrollButtons(true);
+    documents << edit->document();
+    tabBar->addTab(tr("Untitled"));
+    connect(tabBar, SIGNAL(currentChanged(int)), this, SLOT(onTabChanged(int)));
+    connect(tabBar, SIGNAL(tabCloseRequested(int)), this, SLOT(onTabCloseRequested(int)));
+
+    // All the tabs share the buffer, which shows the document of the current one
+    QWidget *widget = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(widget);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->setSpacing(0);
+    layout->addWidget(tabBar);
+    layout->addWidget(splitter);
+    setCentralWidget(widget);
+}
+
+void QScintillaEditor::split(Qt::Orientation orientation) {
+    splitter->setOrientation(orientation);
+    if (!splitEdit) {
+        // The second view shares the Scintilla document of the buffer
+        splitEdit = new Buffer(splitter);
+        splitEdit->shareDocument(edit);
+        splitEdit->setWrapMode(edit->wrapMode());
+        splitEdit->setZoom(edit->zoom());
+        splitEdit->setFirstVisibleLine(edit->firstVisibleLine());
+        splitter->addWidget(splitEdit);
+        connect(splitEdit, SIGNAL(urlsDropped(QList<QUrl>)), this, SLOT(onUrlsDropped(QList<QUrl>)));
+        ui->actionUnsplit->setEnabled(true);
+    }
+    // Give both views the same size
+    splitter->setSizes(QList<int>() << 1 << 1);
+}
+
+void QScintillaEditor::addTab() {
+    // An empty untitled document is used instead, like the one of a new window
+    if (edit->fileInfo().fileName().isEmpty() && !edit->isModified() && edit->length() == 0) {
+        return;
+    }
+    documents << edit->newDocument();
+    tabBar->setCurrentIndex(tabBar->addTab(tr("Untitled")));
+}
+
+bool QScintillaEditor::closeTab(int index) {
+    tabBar->setCurrentIndex(index);
+    if (!checkModifiedAndSave()) {
+        return false;
+    }
+    edit->saveUndoHistory(documents.at(index));
+    if (documents.size() == 1) {
+        edit->clear();
+        return true;
+    }
+    // Removing the tab shows the document of another one
+    Document *document = documents.takeAt(index);
+    tabBar->removeTab(index);
+    edit->deleteDocument(document);
+
+    return true;
+}
+
 void QScintillaEditor::setTitle() {
     QFileInfo fileInfo = edit->fileInfo();
     QString name = fileInfo.fileName().isEmpty() ? tr("Untitled") : fileInfo.fileName();
-    QString title = QString("%1 - %2").arg(name).arg(qApp->applicationName()).append(edit->modify() ? " *" : "");
+    QString title = QString("%1 - %2").arg(name).arg(qApp->applicationName()).append(edit->isModified() ? " *" : "");
     setWindowTitle(title);
+    if (tabBar) {
+        tabBar->setTabText(tabBar->currentIndex(), edit->isModified() ? name + " *" : name);
+        tabBar->setTabToolTip(tabBar->currentIndex(), fileInfo.absoluteFilePath());
+    }
 }
 
 bool QScintillaEditor::checkModifiedAndSave() {
     // If the file has been modified, prompt the user to save the changes
-    if (edit->modify()) {
+    if (edit->isModified()) {
         // Ask the user if the file should be saved
         QFileInfo fileInfo = edit->fileInfo();
         QString message = QString(tr("File '%1' has been modified")).arg(
@@ -683,6 +979,7 @@ void QScintillaEditor::initFindDialog() {
         findDlg = new FindReplaceDialog(this);
         connect(findDlg, SIGNAL(find(const QString&, int, bool, bool)), this,
                 SLOT(find(const QString&, int, bool, bool)));
+        connect(findDlg, SIGNAL(findAll(const QString&, int)), this, SLOT(findAll(const QString&, int)));
         connect(findDlg, SIGNAL(replace(const QString&, const QString&, int, bool, bool)), this,
                 SLOT(replace(const QString&, const QString&, int, bool, bool)));
         connect(findDlg, SIGNAL(replaceAll(const QString&, const QString&, int)), this,
@@ -690,9 +987,41 @@ void QScintillaEditor::initFindDialog() {
     }
 }
 
+void QScintillaEditor::updateFindMessage() {
+    if (!lastFindFound) {
+        messageLabel->setText(tr("The text was not found."));
+        return;
+    }
+    QString message = lastFindWrapped ? tr("Search wrapped.") : tr("");
+    if (matchCounter->isReady()) {
+        int index = matchCounter->indexOf(edit->selectionStart());
+        QString count = index >= 0 ?
+                tr("Match %1 of %2").arg(index + 1).arg(matchCounter->count()) :
+                tr("%1 matches").arg(matchCounter->count());
+        message = message.isEmpty() ? count : message + ' ' + count;
+    }
+    messageLabel->setText(message);
+}
+
 void QScintillaEditor::closeEvent(QCloseEvent *event) {
-    if (!checkModifiedAndSave()) {
+    if (tabBar) {
+        // Ask for each modified document in turn
+        for (int i = 0; i < documents.size(); ++i) {
+            if (edit->isModified(documents.at(i))) {
+                tabBar->setCurrentIndex(i);
+                if (!checkModifiedAndSave()) {
+                    event->ignore();
+                    return;
+                }
+            }
+        }
+        for (int i = 0; i < documents.size(); ++i) {
+            edit->saveUndoHistory(documents.at(i));
+        }
+    } else if (!checkModifiedAndSave()) {
         // If the user canceled any dialog, do not exit the application
         event->ignore();
+    } else {
+        edit->saveUndoHistory(edit->document());
     }
 }
@@ -0,0 +1,90 @@
+#include "fileindex.h"
+#include "quickopendialog.h"
+#include "ui_quickopendialog.h"
+
+#include <QKeyEvent>
+
+/** The maximum number of files displayed in the result list. */
+static const int MaxResults = 100;
+
+QuickOpenDialog::QuickOpenDialog(QWidget *parent) :
+        QDialog(parent), ui(new Ui::QuickOpenDialog) {
+    ui->setupUi(this);
+
+    ui->queryEdit->installEventFilter(this);
+    connect(FileIndex::instance(), SIGNAL(indexChanged()), this, SLOT(onIndexChanged()));
+}
+
+QuickOpenDialog::~QuickOpenDialog() {
+    delete ui;
+}
+
+QString QuickOpenDialog::selectedFile() const {
+    QListWidgetItem *item = ui->resultListWidget->currentItem();
+    if (!item) {
+        return QString();
+    }
+
+    return FileIndex::instance()->rootPath() + '/' + item->text();
+}
+
+void QuickOpenDialog::showEvent(QShowEvent *e) {
+    QDialog::showEvent(e);
+
+    ui->queryEdit->clear();
+    ui->queryEdit->setFocus(Qt::ActiveWindowFocusReason);
+    updateResults();
+}
+
+bool QuickOpenDialog::eventFilter(QObject *obj, QEvent *event) {
+    if (obj == ui->queryEdit && event->type() == QEvent::KeyPress) {
+        int key = static_cast<QKeyEvent*>(event)->key();
+        if (key == Qt::Key_Up || key == Qt::Key_Down || key == Qt::Key_PageUp ||
+                key == Qt::Key_PageDown) {
+            // Forward the navigation keys to the result list
+            QCoreApplication::sendEvent(ui->resultListWidget, event);
+            return true;
+        }
+    }
+
+    return QDialog::eventFilter(obj, event);
+}
+
+void QuickOpenDialog::on_queryEdit_textChanged(const QString &) {
+    updateResults();
+}
+
+void QuickOpenDialog::on_queryEdit_returnPressed() {
+    if (ui->resultListWidget->currentItem()) {
+        accept();
+    }
+}
+
+void QuickOpenDialog::on_resultListWidget_itemActivated(QListWidgetItem *) {
+    accept();
+}
+
+void QuickOpenDialog::onIndexChanged() {
+    if (isVisible()) {
+        updateResults();
+    }
+}
+
+void QuickOpenDialog::updateResults() {
+    FileIndex *index = FileIndex::instance();
+    QList<FileIndex::Match> matches = index->match(ui->queryEdit->text(), MaxResults);
+
+    ui->resultListWidget->clear();
+    for (int i = 0; i < matches.size(); ++i) {
+        ui->resultListWidget->addItem(matches.at(i).path);
+    }
+    if (ui->resultListWidget->count() > 0) {
+        ui->resultListWidget->setCurrentRow(0);
+    }
+
+    QString status = tr("%1 files").arg(index->fileCount());
+    if (index->isCrawling()) {
+        status.append(tr(", indexing..."));
+    }
+    ui->statusLabel->setText(status);
+}
@@ -0,0 +1,16 @@
+#include "colorscheme.h"
+#include "encoding.h"
+#include "language.h"
+#include "registries.h"
+
+void initializeRegistries() {
+    Encoding::initialize();
+    ColorScheme::initialize();
+    Language::initialize();
+}
+
+void cleanupRegistries() {
+    Encoding::cleanup();
+    Language::cleanup();
+    ColorScheme::cleanup();
+}
@@ -0,0 +1,138 @@
+#include "singleinstance.h"
+#include "version.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QtEndian>
+
+namespace {
+
+/** The time to wait for the running editor, in milliseconds. */
+const int Timeout = 1000;
+
+/** The maximum size of a message, larger ones are dropped. */
+const quint32 MaxMessageSize = 1024 * 1024;
+
+}
+
+SingleInstance::SingleInstance(QObject *parent) : QObject(parent), server(new QLocalServer(this)) {
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+bool SingleInstance::enabledInSettings() {
+    QSettings settings(ORGANIZATION_NAME, APPLICATION_NAME);
+
+    return settings.value("single.instance", false).toBool();
+}
+
+bool SingleInstance::forward(const QStringList &fileNames, const QString &workingDir) {
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (!socket.waitForConnected(Timeout)) {
+        return false;
+    }
+
+    QByteArray message;
+    QDataStream out(&message, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(0) << workingDir << fileNames;
+    out.device()->seek(0);
+    out << quint32(message.size() - sizeof(quint32));
+    socket.write(message);
+    if (!socket.waitForBytesWritten(Timeout)) {
+        return false;
+    }
+
+    // Wait for the acknowledgement, so that the files are not lost if the
+    // running editor is exiting
+    return socket.waitForReadyRead(Timeout) && socket.read(1) == "1";
+}
+
+bool SingleInstance::listen() {
+    if (server->listen(serverName())) {
+        return true;
+    }
+    if (server->serverError() != QAbstractSocket::AddressInUseError) {
+        return false;
+    }
+
+    // The running editor may only be slow to answer, or another launch may
+    // have just started listening. The socket is only removed if nobody is
+    // listening on it, when it was left behind by an editor that did not
+    // exit cleanly.
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (socket.waitForConnected(Timeout)) {
+        socket.abort();
+        return false;
+    }
+    if (socket.error() != QLocalSocket::ConnectionRefusedError &&
+            socket.error() != QLocalSocket::ServerNotFoundError) {
+        return false;
+    }
+    QLocalServer::removeServer(serverName());
+
+    return server->listen(serverName());
+}
+
+void SingleInstance::onNewConnection() {
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        if (socket->bytesAvailable() > 0) {
+            readMessage(socket);
+        }
+    }
+}
+
+void SingleInstance::onReadyRead() {
+    QLocalSocket *socket = qobject_cast<QLocalSocket*>(sender());
+    if (socket) {
+        readMessage(socket);
+    }
+}
+
+void SingleInstance::readMessage(QLocalSocket *socket) {
+    // Wait until the whole message has arrived
+    if (socket->bytesAvailable() < qint64(sizeof(quint32))) {
+        return;
+    }
+    QDataStream in(socket);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 size;
+    socket->peek(reinterpret_cast<char*>(&size), sizeof(quint32));
+    size = qFromBigEndian(size);
+    if (size > MaxMessageSize) {
+        socket->abort();
+        return;
+    }
+    if (socket->bytesAvailable() < qint64(sizeof(quint32) + size)) {
+        return;
+    }
+
+    QString workingDir;
+    QStringList fileNames;
+    in >> size >> workingDir >> fileNames;
+    if (in.status() != QDataStream::Ok) {
+        socket->abort();
+        return;
+    }
+    socket->write("1");
+    socket->flush();
+    socket->disconnectFromServer();
+
+    emit filesReceived(fileNames, workingDir);
+}
+
+QString SingleInstance::serverName() {
+    // The home directory tells the users apart, also on systems where local
+    // sockets are shared between the users
+    QByteArray hash = QCryptographicHash::hash(QDir::homePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+
+    return QString(ORGANIZATION_NAME "-" APPLICATION_NAME "-%1").arg(QString::fromLatin1(hash.left(16)));
+}
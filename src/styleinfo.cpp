@@ -63,3 +63,13 @@ bool StyleInfo::eolFilled() const {
 void StyleInfo::setEolFilled(bool eolFilled) {
     m_eolFilled = eolFilled;
 }
+
+bool StyleInfo::operator==(const StyleInfo &other) const {
+    return m_foregroundColor == other.m_foregroundColor && m_backgroundColor == other.m_backgroundColor &&
+            m_bold == other.m_bold && m_italic == other.m_italic && m_underline == other.m_underline &&
+            m_eolFilled == other.m_eolFilled;
+}
+
+bool StyleInfo::operator!=(const StyleInfo &other) const {
+    return !(*this == other);
+}
@@ -0,0 +1,462 @@
+#include "textsearch.h"
+
+#include <Scintilla.h>
+
+#include <QFuture>
+#include <QList>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+namespace {
+
+/**
+ * The character classes used by Scintilla in order to find word boundaries.
+ */
+enum CharClass {
+    Space, Newline, Word, Punctuation
+};
+
+/**
+ * Returns the class of a character, the same way the default Scintilla
+ * character classification does.
+ */
+CharClass charClass(unsigned char c) {
+    if (c == '\r' || c == '\n') {
+        return Newline;
+    } else if (c < 0x20 || c == ' ') {
+        return Space;
+    } else if (c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+            (c >= 'A' && c <= 'Z') || c == '_') {
+        return Word;
+    }
+
+    return Punctuation;
+}
+
+/**
+ * Returns true if a word starts at the position.
+ */
+bool isWordStartAt(const char *text, qint64 length, qint64 pos) {
+    if (pos >= length) {
+        return false;
+    }
+    if (pos > 0) {
+        CharClass ccPos = charClass(text[pos]);
+        CharClass ccPrev = charClass(text[pos - 1]);
+        return (ccPos == Word || ccPos == Punctuation) && ccPos != ccPrev;
+    }
+
+    return true;
+}
+
+/**
+ * Returns true if a word ends at the position.
+ */
+bool isWordEndAt(const char *text, qint64 length, qint64 pos) {
+    if (pos <= 0) {
+        return false;
+    }
+    if (pos < length) {
+        CharClass ccPos = charClass(text[pos]);
+        CharClass ccPrev = charClass(text[pos - 1]);
+        return (ccPrev == Word || ccPrev == Punctuation) && ccPos != ccPrev;
+    }
+
+    return true;
+}
+
+/**
+ * Returns the position of the first line end character in a range, or the end
+ * of the range if there is none.
+ */
+qint64 findLineEnd(const char *text, qint64 from, qint64 end) {
+    for (qint64 i = from; i < end; ++i) {
+        if (text[i] == '\n' || text[i] == '\r') {
+            return i;
+        }
+    }
+
+    return end;
+}
+
+/**
+ * Returns the start of the first line that starts at or after a position.
+ */
+qint64 findNextLineStart(const char *text, qint64 length, qint64 from) {
+    qint64 lineEnd = findLineEnd(text, from, length);
+    if (lineEnd < length - 1 && text[lineEnd] == '\r' && text[lineEnd + 1] == '\n') {
+        return lineEnd + 2;
+    }
+
+    return std::min(lineEnd + 1, length);
+}
+
+/** The minimum size of a slice of text searched by a single thread. */
+const qint64 MinSliceLength = 1024 * 1024;
+
+}
+
+TextSearch::TextSearch(const QString &findText, int flags) :
+        m_findText(findText), m_flags(flags), m_valid(!findText.isEmpty()),
+        m_lineBounded(true), m_exact(true) {
+    bool matchCase = flags & SCFIND_MATCHCASE;
+    for (int c = 0; c < 256; ++c) {
+        m_fold[c] = (!matchCase && c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    }
+    m_pattern = findText.toUtf8();
+    for (int i = 0; i < m_pattern.size(); ++i) {
+        if (static_cast<unsigned char>(m_pattern.at(i)) >= 0x80) {
+            // Only ASCII is folded, Scintilla folds all of Unicode.
+            m_exact = matchCase;
+            break;
+        }
+    }
+
+    if (flags & SCFIND_REGEXP) {
+        QByteArray pattern = (flags & SCFIND_CXX11REGEX) ?
+                m_pattern : toEcmaScript(m_pattern, flags);
+        if (flags & SCFIND_CXX11REGEX) {
+            // The C++11 engine of Scintilla can match across lines
+            m_lineBounded = !pattern.contains("\\n") && !pattern.contains("\\r") &&
+                    !pattern.contains("\\s") && !pattern.contains("\\S") &&
+                    !pattern.contains("\\W") && !pattern.contains("\\D") &&
+                    !pattern.contains("[^");
+            m_exact = m_exact && m_lineBounded;
+        }
+        std::regex::flag_type regexFlags = std::regex::ECMAScript;
+        if (!matchCase) {
+            regexFlags |= std::regex::icase;
+        }
+        try {
+            m_regex = std::regex(pattern.constData(), pattern.size(), regexFlags);
+        } catch (const std::regex_error &) {
+            m_valid = false;
+        }
+    } else {
+        // Prepare the Horspool skip table for the literal search
+        for (int i = 0; i < m_pattern.size(); ++i) {
+            m_pattern[i] = m_fold[static_cast<unsigned char>(m_pattern.at(i))];
+        }
+        qint64 patternLength = m_pattern.size();
+        for (int c = 0; c < 256; ++c) {
+            m_skip[c] = patternLength;
+        }
+        for (qint64 i = 0; i < patternLength - 1; ++i) {
+            m_skip[static_cast<unsigned char>(m_pattern.at(i))] = patternLength - 1 - i;
+        }
+        m_lineBounded = !m_pattern.contains('\n') && !m_pattern.contains('\r');
+    }
+}
+
+QString TextSearch::findText() const {
+    return m_findText;
+}
+
+int TextSearch::flags() const {
+    return m_flags;
+}
+
+bool TextSearch::isValid() const {
+    return m_valid;
+}
+
+bool TextSearch::isLineBounded() const {
+    return m_lineBounded;
+}
+
+bool TextSearch::isExact() const {
+    return m_exact;
+}
+
+QVector<TextSearch::Match> TextSearch::findAll(const char *text, qint64 length,
+        qint64 begin, qint64 end) const {
+    QVector<Match> matches;
+    if (!m_valid) {
+        return matches;
+    }
+    if (!(m_flags & SCFIND_REGEXP)) {
+        findLiteral(text, length, begin, end, &matches);
+        return matches;
+    }
+
+    // Regular expressions are matched line by line, the last line of the
+    // document is searched even if it is empty.
+    qint64 lineStart = begin;
+    while (lineStart < end || (lineStart == end && end == length)) {
+        qint64 lineEnd = findLineEnd(text, lineStart, end);
+        findInLine(text, lineStart, lineEnd, &matches);
+        if (lineEnd >= end) {
+            break;
+        }
+        lineStart = lineEnd + 1;
+        if (text[lineEnd] == '\r' && lineStart < end && text[lineStart] == '\n') {
+            ++lineStart;
+        }
+    }
+
+    return matches;
+}
+
+QVector<TextSearch::Match> TextSearch::findAllParallel(const char *text, qint64 length,
+        int threadCount) const {
+    if (threadCount <= 0) {
+        threadCount = QThread::idealThreadCount();
+    }
+    qint64 sliceCount = std::min<qint64>(threadCount, length / MinSliceLength);
+    if (!m_lineBounded || sliceCount <= 1) {
+        return findAll(text, length, 0, length);
+    }
+
+    // Split the text at line boundaries, slices may be empty if the lines are
+    // longer than the slices.
+    QVector<qint64> bounds;
+    bounds << 0;
+    for (qint64 i = 1; i < sliceCount; ++i) {
+        qint64 bound = std::max(bounds.last(), i * (length / sliceCount));
+        if (bound > 0) {
+            bound = findNextLineStart(text, length, bound - 1);
+        }
+        bounds << std::max(bound, bounds.last());
+    }
+    bounds << length;
+
+    // Search the slices in parallel and merge the results in order
+    QThreadPool localPool;
+    QThreadPool *pool = QThreadPool::globalInstance();
+    if (threadCount != pool->maxThreadCount()) {
+        localPool.setMaxThreadCount(threadCount);
+        pool = &localPool;
+    }
+    QList<QFuture<QVector<Match> > > futures;
+    for (int i = 0; i < bounds.size() - 1; ++i) {
+        if (bounds.at(i) < bounds.at(i + 1)) {
+            futures << QtConcurrent::run(pool, this, &TextSearch::findAll, text, length,
+                    bounds.at(i), bounds.at(i + 1));
+        }
+    }
+    QVector<Match> matches;
+    for (int i = 0; i < futures.size(); ++i) {
+        matches << futures[i].result();
+    }
+
+    return matches;
+}
+
+bool TextSearch::matchAt(const char *text, qint64 length, qint64 position, Match *match) const {
+    if (!m_valid || position < 0 || position > length) {
+        return false;
+    }
+    if (!(m_flags & SCFIND_REGEXP)) {
+        qint64 end = position + m_pattern.size();
+        if (end > length) {
+            return false;
+        }
+        const unsigned char *data = reinterpret_cast<const unsigned char *>(text) + position;
+        const unsigned char *pattern = reinterpret_cast<const unsigned char *>(m_pattern.constData());
+        for (qint64 j = 0; j < end - position; ++j) {
+            if (m_fold[data[j]] != pattern[j]) {
+                return false;
+            }
+        }
+        if (!acceptMatch(text, length, position, end)) {
+            return false;
+        }
+        match->start = position;
+        match->end = end;
+        return true;
+    }
+
+    std::cmatch found;
+    std::regex_constants::match_flag_type flags = std::regex_constants::match_continuous;
+    if (position > 0 && text[position - 1] != '\n' && text[position - 1] != '\r') {
+        flags |= std::regex_constants::match_prev_avail;
+    }
+    if (!std::regex_search(text + position, text + findLineEnd(text, position, length), found, m_regex, flags)) {
+        return false;
+    }
+    match->start = position;
+    match->end = position + found.length(0);
+
+    return true;
+}
+
+QByteArray TextSearch::expandReplacement(const char *text, qint64 length, const Match &match,
+        const QByteArray &replaceText) const {
+    if (!(m_flags & SCFIND_REGEXP)) {
+        return replaceText;
+    }
+
+    // Match the regular expression again, in order to find the tagged regions
+    std::cmatch groups;
+    std::regex_constants::match_flag_type flags = std::regex_constants::match_default;
+    if (match.start > 0 && text[match.start - 1] != '\n' && text[match.start - 1] != '\r') {
+        flags = std::regex_constants::match_prev_avail;
+    }
+    if (match.end < length && text[match.end] != '\n' && text[match.end] != '\r') {
+        flags |= std::regex_constants::match_not_eol;
+    }
+    if (!std::regex_match(text + match.start, text + match.end, groups, m_regex, flags)) {
+        // The match depends on the text after its end, as with a lookahead,
+        // search again from its start up to the end of its line.
+        flags &= ~std::regex_constants::match_not_eol;
+        flags |= std::regex_constants::match_continuous;
+        std::regex_search(text + match.start, text + findLineEnd(text, match.start, length), groups,
+                m_regex, flags);
+    }
+
+    QByteArray result;
+    for (int i = 0; i < replaceText.size(); ++i) {
+        char c = replaceText.at(i);
+        if (c != '\\' || i + 1 == replaceText.size()) {
+            result.append(c);
+            continue;
+        }
+        char next = replaceText.at(++i);
+        if (next >= '0' && next <= '9') {
+            size_t group = next - '0';
+            if (group == 0) {
+                result.append(text + match.start, match.end - match.start);
+            } else if (group < groups.size() && groups[group].matched) {
+                result.append(groups[group].first, groups[group].length());
+            }
+            continue;
+        }
+        switch (next) {
+        case 'a':
+            result.append('\a');
+            break;
+        case 'b':
+            result.append('\b');
+            break;
+        case 'f':
+            result.append('\f');
+            break;
+        case 'n':
+            result.append('\n');
+            break;
+        case 'r':
+            result.append('\r');
+            break;
+        case 't':
+            result.append('\t');
+            break;
+        case 'v':
+            result.append('\v');
+            break;
+        case '\\':
+            result.append('\\');
+            break;
+        default:
+            result.append('\\').append(next);
+            break;
+        }
+    }
+
+    return result;
+}
+
+QByteArray TextSearch::toEcmaScript(const QByteArray &pattern, int flags) {
+    bool posix = flags & SCFIND_POSIX;
+    QByteArray result;
+    result.reserve(pattern.size() * 2);
+    for (int i = 0; i < pattern.size(); ++i) {
+        char c = pattern.at(i);
+        if (c == '\\' && i + 1 < pattern.size()) {
+            char next = pattern.at(++i);
+            if (next == '(' || next == ')') {
+                // Groups are written as \( and \) unless the POSIX flag is set
+                result.append(posix ? "\\" : "").append(next);
+            } else if (next == '<' || next == '>') {
+                result.append("\\b");
+            } else if (next == 'e') {
+                result.append("\\x1B");
+            } else {
+                result.append('\\').append(next);
+            }
+        } else if (c == '[') {
+            // Copy the character class verbatim
+            int classEnd = i + 1;
+            if (classEnd < pattern.size() && pattern.at(classEnd) == '^') {
+                ++classEnd;
+            }
+            if (classEnd < pattern.size() && pattern.at(classEnd) == ']') {
+                ++classEnd;
+            }
+            while (classEnd < pattern.size() && pattern.at(classEnd) != ']') {
+                if (pattern.at(classEnd) == '\\') {
+                    ++classEnd;
+                }
+                ++classEnd;
+            }
+            result.append(pattern.mid(i, classEnd - i + 1));
+            i = classEnd;
+        } else if ((c == '(' || c == ')') && !posix) {
+            result.append('\\').append(c);
+        } else if (c == '?' || c == '|' || c == '{' || c == '}') {
+            // Not operators in the Scintilla syntax
+            result.append('\\').append(c);
+        } else {
+            result.append(c);
+        }
+    }
+
+    return result;
+}
+
+void TextSearch::findLiteral(const char *text, qint64 length, qint64 begin,
+        qint64 end, QVector<Match> *matches) const {
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(text);
+    const unsigned char *pattern = reinterpret_cast<const unsigned char *>(m_pattern.constData());
+    qint64 patternLength = m_pattern.size();
+    qint64 last = patternLength - 1;
+    // A match may start before the end of the range but finish after it
+    qint64 limit = qMin(end + last, length);
+    qint64 pos = begin;
+    while (pos + patternLength <= limit) {
+        qint64 j = last;
+        while (j >= 0 && m_fold[data[pos + j]] == pattern[j]) {
+            --j;
+        }
+        if (j < 0 && acceptMatch(text, length, pos, pos + patternLength)) {
+            Match match = { pos, pos + patternLength };
+            matches->append(match);
+            pos += patternLength;
+        } else {
+            pos += m_skip[m_fold[data[pos + last]]];
+        }
+    }
+}
+
+void TextSearch::findInLine(const char *text, qint64 lineStart, qint64 lineEnd,
+        QVector<Match> *matches) const {
+    const char *first = text + lineStart;
+    const char *last = text + lineEnd;
+    std::cmatch match;
+    std::regex_constants::match_flag_type flags = std::regex_constants::match_default;
+    if (lineStart > 0 && text[lineStart - 1] != '\n' && text[lineStart - 1] != '\r') {
+        // The search starts inside the line
+        flags = std::regex_constants::match_prev_avail;
+    }
+    while (first <= last && std::regex_search(first, last, match, m_regex, flags)) {
+        qint64 start = match[0].first - text;
+        qint64 end = match[0].second - text;
+        Match found = { start, end };
+        matches->append(found);
+        // Continue after the match, and never match an empty string twice
+        first = text + (end > start ? end : end + 1);
+        flags = std::regex_constants::match_prev_avail;
+    }
+}
+
+bool TextSearch::acceptMatch(const char *text, qint64 length, qint64 start, qint64 end) const {
+    if (m_flags & SCFIND_WHOLEWORD) {
+        return isWordStartAt(text, length, start) && isWordEndAt(text, length, end);
+    } else if (m_flags & SCFIND_WORDSTART) {
+        return isWordStartAt(text, length, start);
+    }
+
+    return true;
+}
@@ -0,0 +1,329 @@
+#include "trace.h"
+
+#ifdef ENABLE_STARTUP_TRACING
+
+#include <QAbstractScrollArea>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#elif defined(Q_OS_MACOS)
+#include <sys/sysctl.h>
+#include <sys/time.h>
+#include <unistd.h>
+#elif defined(Q_OS_LINUX)
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/**
+ * The default name of the trace file.
+ */
+const char *const DefaultFileName = "editor-startup-trace.json";
+
+/**
+ * A recorded event.
+ */
+struct Event {
+    /** The name of the event. */
+    const char *name;
+
+    /** The phase of the event, as in the trace event format. */
+    char phase;
+
+    /** The time of the event, in microseconds. */
+    qint64 start;
+
+    /** The duration of complete events, in microseconds. */
+    qint64 duration;
+
+    /** The thread that recorded the event. */
+    Qt::HANDLE thread;
+};
+
+/**
+ * Returns the time since the process was created, in microseconds, or 0 if it
+ * is not known. It only uses the C library and the system, since it runs
+ * during static initialization.
+ */
+qint64 processAge() {
+    qint64 age = 0;
+#ifdef Q_OS_WIN
+    FILETIME creation, exit, kernel, user, current;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    GetSystemTimeAsFileTime(&current);
+    ULARGE_INTEGER start, end;
+    start.LowPart = creation.dwLowDateTime;
+    start.HighPart = creation.dwHighDateTime;
+    end.LowPart = current.dwLowDateTime;
+    end.HighPart = current.dwHighDateTime;
+    // In units of 100 nanoseconds
+    age = qint64(end.QuadPart - start.QuadPart) / 10;
+#elif defined(Q_OS_MACOS)
+    struct kinfo_proc info;
+    size_t size = sizeof(info);
+    int mib[] = {CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid()};
+    struct timeval current;
+    if (sysctl(mib, 4, &info, &size, 0, 0) != 0 || gettimeofday(&current, 0) != 0) {
+        return 0;
+    }
+    const struct timeval &start = info.kp_proc.p_starttime;
+    age = qint64(current.tv_sec - start.tv_sec) * 1000000 + (current.tv_usec - start.tv_usec);
+#elif defined(Q_OS_LINUX)
+    // The start time is the 22nd field, in clock ticks since the boot. The
+    // command name, the 2nd field, is in parentheses and may contain spaces.
+    char stat[1024];
+    FILE *file = std::fopen("/proc/self/stat", "r");
+    if (!file) {
+        return 0;
+    }
+    size_t length = std::fread(stat, 1, sizeof(stat) - 1, file);
+    std::fclose(file);
+    stat[length] = 0;
+    const char *fields = std::strrchr(stat, ')');
+    unsigned long long startTicks;
+    struct timespec uptime;
+    if (!fields || std::sscanf(fields + 1, "%*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s "
+            "%*s %*s %llu", &startTicks) != 1 || clock_gettime(CLOCK_BOOTTIME, &uptime) != 0) {
+        return 0;
+    }
+    age = qint64(uptime.tv_sec) * 1000000 + uptime.tv_nsec / 1000 -
+            qint64(startTicks) * 1000000 / sysconf(_SC_CLK_TCK);
+#endif
+
+    return qMax<qint64>(age, 0);
+}
+
+/**
+ * The state of the tracing.
+ */
+struct State {
+    State() : active(false), origin(processAge()) {
+        clock.start();
+    }
+
+    /** Protects the other members, events are recorded from any thread. */
+    QMutex mutex;
+
+    /** Started when the program is loaded. */
+    QElapsedTimer clock;
+
+    /** The time from the creation of the process to the start of the clock, in microseconds. */
+    qint64 origin;
+
+    /** true while events are recorded. */
+    bool active;
+
+    /** The name of the trace file. */
+    QString fileName;
+
+    /** The events recorded so far. */
+    QVector<Event> events;
+};
+
+/**
+ * Returns the state of the tracing.
+ */
+State &state() {
+    static State state;
+
+    return state;
+}
+
+/**
+ * Makes sure that the clock starts during static initialization. The time
+ * spent before, loading the program and its libraries, is taken from the
+ * creation time of the process.
+ */
+const bool clockStarted = (state(), true);
+
+/**
+ * Returns the time since the process was created, in microseconds.
+ */
+qint64 now() {
+    return state().origin + state().clock.nsecsElapsed() / 1000;
+}
+
+/**
+ * Records an event.
+ */
+void record(const char *name, char phase, qint64 start, qint64 duration = 0) {
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    if (s.active) {
+        Event event = { name, phase, start, duration, QThread::currentThreadId() };
+        s.events << event;
+    }
+}
+
+/**
+ * Escapes a string for a JSON document.
+ */
+QByteArray jsonString(const QByteArray &value) {
+    QByteArray result("\"");
+    for (int i = 0; i < value.size(); ++i) {
+        char c = value.at(i);
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (static_cast<uchar>(c) < 0x20) {
+            result += QByteArray("\\u") + QByteArray::number(c, 16).rightJustified(4, '0');
+        } else {
+            result += c;
+        }
+    }
+    result += '"';
+
+    return result;
+}
+
+/**
+ * Waits for the first paint event of a widget.
+ */
+class FirstPaintFilter : public QObject {
+public:
+    explicit FirstPaintFilter(QObject *parent) : QObject(parent) {
+    }
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override {
+        if (event->type() == QEvent::Paint) {
+            Trace::instant("firstPaint");
+            obj->removeEventFilter(this);
+            // The paint is done when the event loop runs again
+            QTimer::singleShot(0, []() {
+                Trace::instant("firstPaintDone");
+                Trace::finish();
+            });
+            deleteLater();
+        }
+
+        return false;
+    }
+};
+
+}
+
+Trace::Scope::Scope(const char *name) : m_name(name), m_start(now()) {
+}
+
+Trace::Scope::~Scope() {
+    record(m_name, 'X', m_start, now() - m_start);
+}
+
+void Trace::start(int &argc, char *argv[]) {
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+
+    QByteArray variable = qgetenv("EDITOR_TRACE_STARTUP");
+    if (!variable.isEmpty() && variable != "0") {
+        s.active = true;
+        s.fileName = variable == "1" ? QString(DefaultFileName) : QString::fromLocal8Bit(variable);
+    }
+
+    // Look for the command line argument and remove it
+    int count = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--trace-startup") == 0) {
+            s.active = true;
+            s.fileName = DefaultFileName;
+        } else if (std::strncmp(argv[i], "--trace-startup=", 16) == 0) {
+            s.active = true;
+            s.fileName = QString::fromLocal8Bit(argv[i] + 16);
+        } else {
+            argv[count++] = argv[i];
+        }
+    }
+    argc = count;
+    argv[argc] = nullptr;
+
+    if (s.active) {
+        // The time to main() and to the first paint are measured from the
+        // creation of the process
+        Event processStart = { "processStart", 'i', 0, 0, QThread::currentThreadId() };
+        Event staticInitialization = { "staticInitialization", 'i', s.origin, 0, QThread::currentThreadId() };
+        Event main = { "main", 'i', now(), 0, QThread::currentThreadId() };
+        s.events << processStart << staticInitialization << main;
+    }
+}
+
+void Trace::begin(const char *name) {
+    record(name, 'B', now());
+}
+
+void Trace::end(const char *name) {
+    record(name, 'E', now());
+}
+
+void Trace::instant(const char *name) {
+    record(name, 'i', now());
+}
+
+void Trace::watchFirstPaint(QWidget *widget) {
+    if (!state().active) {
+        return;
+    }
+    // Scroll areas, like the editor, paint in their viewport
+    QAbstractScrollArea *scrollArea = qobject_cast<QAbstractScrollArea*>(widget);
+    QWidget *target = scrollArea ? scrollArea->viewport() : widget;
+    target->installEventFilter(new FirstPaintFilter(target));
+}
+
+void Trace::finish() {
+    State &s = state();
+    QMutexLocker locker(&s.mutex);
+    if (!s.active) {
+        return;
+    }
+    s.active = false;
+
+    // Number the threads in the order of their first event, the first one is
+    // the main thread.
+    QHash<Qt::HANDLE, int> threads;
+    QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+    QByteArray json("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (int i = 0; i < s.events.size(); ++i) {
+        const Event &event = s.events.at(i);
+        if (!threads.contains(event.thread)) {
+            int tid = threads.size();
+            threads.insert(event.thread, tid);
+            QByteArray threadName = tid == 0 ? "main" : "worker " + QByteArray::number(tid);
+            json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" +
+                    QByteArray::number(tid) + ",\"args\":{\"name\":" + jsonString(threadName) + "}},\n";
+        }
+        json += "{\"name\":" + jsonString(event.name) + ",\"cat\":\"startup\",\"ph\":\"" + event.phase + '"';
+        if (event.phase == 'X') {
+            json += ",\"dur\":" + QByteArray::number(event.duration);
+        } else if (event.phase == 'i') {
+            json += ",\"s\":\"p\"";
+        }
+        json += ",\"ts\":" + QByteArray::number(event.start) + ",\"pid\":" + pid + ",\"tid\":" +
+                QByteArray::number(threads.value(event.thread)) + "}";
+        json += i == s.events.size() - 1 ? "\n" : ",\n";
+    }
+    json += "]}\n";
+    s.events.clear();
+
+    QSaveFile file(s.fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        qWarning("Cannot write the startup trace to %s.", qPrintable(s.fileName));
+    }
+}
+
+#endif // ENABLE_STARTUP_TRACING
@@ -0,0 +1,281 @@
+#include "undohistory.h"
+
+#include <Scintilla.h>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTemporaryFile>
+
+namespace {
+
+/** Identifies the files written by UndoHistory::save(). */
+const quint32 HistoryMagic = 0x554e444f;
+
+/** The version of the format of the files. */
+const qint32 HistoryVersion = 1;
+
+}
+
+// In the global namespace, so that the stream operators of the Qt containers find them
+/**
+ * Writes an action to a stream.
+ */
+QDataStream &operator<<(QDataStream &out, const UndoHistory::Action &action) {
+    return out << action.insert << action.position << action.length << action.text;
+}
+
+/**
+ * Reads an action from a stream.
+ */
+QDataStream &operator>>(QDataStream &in, UndoHistory::Action &action) {
+    return in >> action.insert >> action.position >> action.length >> action.text;
+}
+
+UndoHistory::UndoHistory() :
+        m_recentBytes(0), m_blockBytes(0), m_loadedBytes(0), m_spilledBytes(0), m_file(0) {
+}
+
+UndoHistory::~UndoHistory() {
+    delete m_file;
+}
+
+void UndoHistory::record(int type, qint64 position, qint64 length, const QByteArray &text) {
+    if (type & SC_PERFORMED_USER) {
+        if ((type & SC_STARTACTION) || m_recent.isEmpty()) {
+            // A new step drops the ones that could be redone
+            m_redo.clear();
+            m_recent << Step();
+        }
+        Step &step = m_recent.last();
+        bool insert = type & SC_MOD_INSERTTEXT;
+        if (!step.isEmpty() && step.last().insert == insert) {
+            // Coalesce typing, backspacing and deleting forward
+            Action &last = step.last();
+            if (insert && position == last.position + last.length) {
+                last.length += length;
+                return;
+            } else if (!insert && position == last.position) {
+                last.length += length;
+                last.text.append(text);
+                m_recentBytes += text.size();
+                return;
+            } else if (!insert && position + length == last.position) {
+                last.position = position;
+                last.length += length;
+                last.text.prepend(text);
+                m_recentBytes += text.size();
+                return;
+            }
+        }
+        Action action;
+        action.insert = insert;
+        action.position = position;
+        action.length = length;
+        if (!insert) {
+            action.text = text;
+        }
+        step << action;
+        m_recentBytes += actionBytes(action);
+    } else if (type & SC_LASTSTEPINUNDOREDO) {
+        // A whole step has been undone or redone
+        if ((type & SC_PERFORMED_UNDO) && !m_recent.isEmpty()) {
+            m_redo << m_recent.takeLast();
+        } else if ((type & SC_PERFORMED_REDO) && !m_redo.isEmpty()) {
+            m_recent << m_redo.takeLast();
+        }
+    }
+}
+
+void UndoHistory::discardRecent() {
+    m_recent.clear();
+    m_redo.clear();
+    m_recentBytes = 0;
+}
+
+void UndoHistory::clear() {
+    discardRecent();
+    m_blocks.clear();
+    m_blockBytes = 0;
+    m_loaded.clear();
+    m_loadedBytes = 0;
+    m_spilledBytes = 0;
+    delete m_file;
+    m_file = 0;
+}
+
+void UndoHistory::compact(qint64 budget) {
+    if (!m_loaded.isEmpty()) {
+        // Put back what is left of the block being undone, before the new steps
+        m_recent = m_loaded + m_recent;
+        m_loaded.clear();
+        m_loadedBytes = 0;
+    }
+    if (!m_recent.isEmpty()) {
+        QByteArray steps;
+        QDataStream out(&steps, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << m_recent;
+
+        Block block;
+        block.data = qCompress(steps);
+        block.offset = -1;
+        block.size = block.data.size();
+        m_blocks << block;
+        m_blockBytes += block.size;
+    }
+    discardRecent();
+
+    spill(budget);
+}
+
+bool UndoHistory::canUndo() const {
+    return !m_loaded.isEmpty() || !m_blocks.isEmpty();
+}
+
+UndoHistory::Step UndoHistory::takeStep() {
+    if (m_loaded.isEmpty() && !m_blocks.isEmpty()) {
+        Block block = m_blocks.takeLast();
+        m_loaded = readBlock(block);
+        if (block.offset < 0) {
+            m_blockBytes -= block.size;
+        } else {
+            // The blocks loaded from a saved history are spilled after the
+            // newer ones, only the end of the file can be reclaimed
+            m_spilledBytes -= block.size;
+            if (block.offset + block.size == m_file->size()) {
+                m_file->resize(block.offset);
+            }
+        }
+        for (int i = 0; i < m_loaded.size(); ++i) {
+            const Step &step = m_loaded.at(i);
+            for (int j = 0; j < step.size(); ++j) {
+                m_loadedBytes += actionBytes(step.at(j));
+            }
+        }
+    }
+    if (m_loaded.isEmpty()) {
+        return Step();
+    }
+
+    Step step = m_loaded.takeLast();
+    for (int i = 0; i < step.size(); ++i) {
+        m_loadedBytes -= actionBytes(step.at(i));
+    }
+
+    return step;
+}
+
+bool UndoHistory::save(const QString &fileName, const QString &path, const QByteArray &contentHash) {
+    QList<Step> steps;
+    for (int i = 0; i < m_blocks.size(); ++i) {
+        steps += readBlock(m_blocks.at(i));
+    }
+    steps += m_loaded;
+    steps += m_recent;
+    if (steps.isEmpty()) {
+        return false;
+    }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << steps;
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << HistoryMagic << HistoryVersion << path << contentHash << qCompress(data);
+
+    return file.commit();
+}
+
+bool UndoHistory::load(const QString &fileName, const QString &path, const QByteArray &contentHash) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic;
+    qint32 version;
+    in >> magic >> version;
+    if (magic != HistoryMagic || version != HistoryVersion) {
+        return false;
+    }
+    QString savedPath;
+    QByteArray savedHash;
+    QByteArray data;
+    in >> savedPath >> savedHash >> data;
+    if (in.status() != QDataStream::Ok || savedPath != path || savedHash != contentHash) {
+        return false;
+    }
+
+    // The block is kept compressed until the steps are undone
+    Block block;
+    block.data = data;
+    block.offset = -1;
+    block.size = data.size();
+    m_blocks.prepend(block);
+    m_blockBytes += block.size;
+
+    return true;
+}
+
+qint64 UndoHistory::memoryBytes() const {
+    return m_recentBytes + m_blockBytes + m_loadedBytes;
+}
+
+qint64 UndoHistory::spilledBytes() const {
+    return m_spilledBytes;
+}
+
+qint64 UndoHistory::actionBytes(const Action &action) {
+    return sizeof(Action) + action.text.size();
+}
+
+QList<UndoHistory::Step> UndoHistory::readBlock(const Block &block) const {
+    QByteArray data = block.data;
+    if (block.offset >= 0 && m_file->seek(block.offset)) {
+        data = m_file->read(block.size);
+    }
+
+    QList<Step> steps;
+    QDataStream in(qUncompress(data));
+    in.setVersion(QDataStream::Qt_5_0);
+    in >> steps;
+
+    return steps;
+}
+
+void UndoHistory::spill(qint64 budget) {
+    for (int i = 0; i < m_blocks.size() && m_blockBytes > budget; ++i) {
+        Block &block = m_blocks[i];
+        if (block.offset >= 0) {
+            continue;
+        }
+        if (!m_file) {
+            m_file = new QTemporaryFile();
+            if (!m_file->open()) {
+                // Keep the history in memory rather than losing it
+                delete m_file;
+                m_file = 0;
+                return;
+            }
+        }
+        qint64 offset = m_file->size();
+        if (!m_file->seek(offset) || m_file->write(block.data) != block.size) {
+            m_file->resize(offset);
+            return;
+        }
+        block.offset = offset;
+        block.data.clear();
+        m_blockBytes -= block.size;
+        m_spilledBytes += block.size;
+    }
+}
@@ -1,4 +1,36 @@
 #include "util.h"
+#include "version.h"
+
+#include <QStandardPaths>
+
+Q_LOGGING_CATEGORY(editorUi, "editor.ui", QtWarningMsg)
+
+namespace {
+
+/**
+ * Returns the directory set by setUserConfigDir(), null if none has been.
+ */
+QString &userConfigDirOverride() {
+    static QString dir;
+
+    return dir;
+}
+
+}
+
+QString userConfigDir() {
+    if (!userConfigDirOverride().isNull()) {
+        return userConfigDirOverride();
+    }
+
+    // Not the application location, the application name is not set yet
+    return QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation) +
+            "/" ORGANIZATION_NAME "/" APPLICATION_NAME;
+}
+
+void setUserConfigDir(const QString &dir) {
+    userConfigDirOverride() = dir;
+}
 
 int convertColor(const QString& colorStr) {
     bool ok;
@@ -0,0 +1,665 @@
+#include "buffer.h"
+#include "colorscheme.h"
+#include "configuration.h"
+#include "filesearch.h"
+#include "language.h"
+#include "memoryusage.h"
+#include "qscintillaeditor.h"
+#include "registries.h"
+#include "textsearch.h"
+#include "util.h"
+
+#include <Scintilla.h>
+
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegExp>
+#include <QSettings>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/**
+ * Times the core operations of the editor over synthetic corpora, without
+ * showing any window, and writes the median, the 95th percentile and the peak
+ * resident memory of each benchmark as JSON.
+ *
+ * Usage: qt-scintilla-editor-bench [--size <MB>] [--iterations <count>] [--filter <text>] [--output <file>]
+ */
+
+namespace {
+
+/**
+ * The options of the command line.
+ */
+struct Options {
+    Options() : size(8 * 1024 * 1024), iterations(10) {
+    }
+
+    /** The size of the corpus, in bytes. */
+    qint64 size;
+
+    /** The number of timed runs of each benchmark. */
+    int iterations;
+
+    /** Only the benchmarks whose name contains it are run, if it is not empty. */
+    QString filter;
+
+    /** The file the results are written to, or empty for the standard output. */
+    QString output;
+};
+
+/** The settings that a buffer reads when it is created. */
+const char *const BufferSettings[] = {
+    "view.whitespace", "view.indentation.whitespace", "view.indentation.guides", "view.caret.line",
+    "braces.check", "braces.colorize", "view.indentation.examine", "long.line.indicator",
+    "long.line.indicator.line", "long.line.indicator.column", "view.eol", "line.margin.visible",
+    "line.margin.width", "line.margin.track", "margin", "margin.width", "fold", "fold.width", "fold.symbols",
+    "fold.lines", "wrap", "tab.size", "indent.size", "use.tabs", "horizontal.scroll.width",
+    "horizontal.scroll.width.tracking", "font.default", "color.scheme"
+};
+
+/** The settings that an editor window reads for its actions when it is created, besides those of its buffer. */
+const char *const WindowSettings[] = {
+    "tabbed.interface", "full.screen", "toolbar.visible", "statusbar.visible", "view.whitespace",
+    "view.indentation.guides", "view.caret.line", "long.line.indicator", "braces.colorize", "view.eol",
+    "line.margin.visible", "margin", "fold", "wrap"
+};
+
+/** The number of windows built by each run of the window benchmarks. */
+const int WindowCount = 10;
+
+/**
+ * Returns the peak resident memory of the process so far.
+ *
+ * @return The peak resident memory, in bytes.
+ */
+qint64 peakRss() {
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef Q_OS_MACOS
+    return usage.ru_maxrss;
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+/**
+ * Generates C-like code, with nested blocks, comments and string literals.
+ * The same size gives the same text. The word "needle" only appears on the
+ * last line.
+ *
+ * @param size The size of the text, in bytes.
+ * @return The text.
+ */
+QByteArray generateCorpus(qint64 size) {
+    static const char *const words[] = {"value", "count", "index", "buffer", "result", "length", "offset", "node"};
+    const int wordCount = sizeof(words) / sizeof(words[0]);
+
+    QByteArray text;
+    text.reserve(size + 128);
+    quint32 state = 12345;
+    int depth = 0;
+    while (text.size() < size) {
+        state = state * 1664525u + 1013904223u;
+        QByteArray word = QByteArray(words[(state >> 8) % wordCount]) + '_' + QByteArray::number((state >> 12) % 1000);
+        QByteArray other = QByteArray(words[(state >> 16) % wordCount]) + '_' + QByteArray::number((state >> 4) % 100);
+        QByteArray indent(4 * (depth + 1), ' ');
+        switch (state >> 29) {
+        case 0:
+            text += indent + "// Updates " + word + " from " + other + "\n";
+            break;
+        case 1:
+            if (depth < 8) {
+                text += indent + "if (" + word + " < " + other + ") {\n";
+                ++depth;
+                break;
+            }
+            // Fall through
+        case 2:
+            if (depth > 0) {
+                --depth;
+                text += QByteArray(4 * (depth + 1), ' ') + "}\n";
+                break;
+            }
+            // Fall through
+        case 3:
+            text += indent + word + " = call(\"" + other + "\", " + QByteArray::number(state % 4096) + ");\n";
+            break;
+        default:
+            text += indent + "int " + word + " = " + other + " + " + QByteArray::number(state % 100) + ";\n";
+            break;
+        }
+    }
+    while (depth-- > 0) {
+        text += QByteArray(4 * (depth + 1), ' ') + "}\n";
+    }
+    text += "int needle = 0;\n";
+
+    return text;
+}
+
+/**
+ * The language lookup by file name before the filename index: a wildcard
+ * expression is built for each pattern of each language on every call. It is
+ * kept as the baseline of the index.
+ *
+ * @param fileName The file name.
+ * @return The language, or null.
+ */
+const Language *legacyFromFilename(const QString &fileName) {
+    QListIterator<Language*> languages = Language::allLanguages();
+    while (languages.hasNext()) {
+        const Language *language = languages.next();
+        QStringList extensions = language->patterns().split(' ');
+        for (int j = 0; j < extensions.size(); ++j) {
+            QRegExp re(extensions.at(j));
+            re.setPatternSyntax(QRegExp::Wildcard);
+            if (re.exactMatch(fileName)) {
+                return language;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Runs the benchmarks and collects their results.
+ */
+class Runner {
+public:
+    /**
+     * Creates the runner.
+     *
+     * @param options The options of the command line.
+     */
+    explicit Runner(const Options &options) : m_options(options) {
+    }
+
+    /**
+     * Runs a benchmark, unless it is filtered out.
+     *
+     * @param name The name of the benchmark.
+     * @param operation The timed operation.
+     * @param setup Called before each run of the operation, not timed. The
+     * events posted by the operation and the setup are processed before the
+     * next run, as the event loop of the editor would.
+     */
+    void run(const QString &name, const std::function<void()> &operation,
+            const std::function<void()> &setup = std::function<void()>()) {
+        if (!selected(name)) {
+            return;
+        }
+        fprintf(stderr, "%s\n", qPrintable(name));
+
+        QList<double> samples;
+        for (int i = 0; i < m_options.iterations; ++i) {
+            if (setup) {
+                setup();
+            }
+            QCoreApplication::processEvents();
+            QElapsedTimer timer;
+            timer.start();
+            operation();
+            samples << timer.nsecsElapsed() / 1e6;
+        }
+        QCoreApplication::processEvents();
+        record(name, samples);
+    }
+
+    /**
+     * Adds the result of a benchmark whose samples have been measured by the
+     * caller.
+     *
+     * @param name The name of the benchmark.
+     * @param samples The duration of each run, in milliseconds.
+     */
+    void record(const QString &name, QList<double> samples) {
+        std::sort(samples.begin(), samples.end());
+        int count = samples.size();
+        QJsonObject result;
+        result.insert("name", name);
+        result.insert("iterations", count);
+        result.insert("minMs", samples.first());
+        result.insert("medianMs", count % 2 ? samples.at(count / 2) :
+                (samples.at(count / 2 - 1) + samples.at(count / 2)) / 2);
+        result.insert("p95Ms", samples.at(int(std::ceil(0.95 * count)) - 1));
+        result.insert("maxMs", samples.last());
+        result.insert("peakRssBytes", double(peakRss()));
+        result.insert("documentBytes", double(MemoryUsage::sum(MemoryUsage::collect()).totalBytes()));
+        m_results << result;
+    }
+
+    /**
+     * Returns true if a benchmark is to be run.
+     *
+     * @param name The name of the benchmark.
+     * @return true if the benchmark is not filtered out.
+     */
+    bool selected(const QString &name) const {
+        return m_options.filter.isEmpty() || name.contains(m_options.filter);
+    }
+
+    /**
+     * Returns the results of the benchmarks run so far.
+     *
+     * @return The results.
+     */
+    QJsonArray results() const {
+        return m_results;
+    }
+
+private:
+    /** The options of the command line. */
+    Options m_options;
+
+    /** The results of the benchmarks. */
+    QJsonArray m_results;
+};
+
+/**
+ * Reads the options of the command line.
+ *
+ * @param arguments The arguments.
+ * @param options Output parameter, the options.
+ * @return true if the arguments are valid.
+ */
+bool parseOptions(const QStringList &arguments, Options &options) {
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString &argument = arguments.at(i);
+        if (i + 1 == arguments.size()) {
+            return false;
+        }
+        QString value = arguments.at(++i);
+        bool ok = true;
+        if (argument == "--size") {
+            options.size = qint64(value.toDouble(&ok) * 1024 * 1024);
+        } else if (argument == "--iterations") {
+            options.iterations = value.toInt(&ok);
+        } else if (argument == "--filter") {
+            options.filter = value;
+        } else if (argument == "--output") {
+            options.output = value;
+        } else {
+            return false;
+        }
+        if (!ok || options.size <= 0 || options.iterations <= 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Times reading the definitions: once through the built-in tables, as at
+ * startup, and repeatedly from the XML files, as before the tables.
+ *
+ * @param runner The runner.
+ */
+void benchmarkRegistries(Runner &runner) {
+    if (runner.selected("registries.builtin")) {
+        // The registries are initialized once per process
+        QElapsedTimer timer;
+        timer.start();
+        initializeRegistries();
+        runner.record("registries.builtin", QList<double>() << timer.nsecsElapsed() / 1e6);
+    }
+
+    runner.run("registries.xml", [&]() {
+        qDeleteAll(Language::readLanguages(BENCH_RESOURCES_DIR "/conf/languages.xml"));
+        qDeleteAll(ColorScheme::readColorSchemes(BENCH_RESOURCES_DIR "/colorschemes/default.xml"));
+        qDeleteAll(ColorScheme::readColorSchemes(BENCH_RESOURCES_DIR "/colorschemes/monokai.xml"));
+    });
+}
+
+/**
+ * Times the operations on a buffer with the corpus.
+ *
+ * @param runner The runner.
+ * @param corpus The text of the buffer.
+ * @param fileName The file with the corpus.
+ * @param dir The directory of the saved files.
+ */
+void benchmarkBuffer(Runner &runner, const QByteArray &corpus, const QString &fileName, const QTemporaryDir &dir) {
+    Buffer buffer;
+    buffer.open(fileName);
+    std::function<void()> reset = [&]() {
+        buffer.setText(corpus.constData());
+        buffer.emptyUndoHistory();
+    };
+
+    runner.run("open", [&]() {
+        buffer.open(fileName);
+    });
+    runner.run("save", [&]() {
+        buffer.save(dir.filePath("saved.cpp"));
+    });
+    runner.run("find", [&]() {
+        bool wrapped;
+        buffer.find("needle", SCFIND_MATCHCASE, true, false, &wrapped);
+    }, [&]() {
+        buffer.gotoPos(0);
+    });
+    runner.run("findAll", [&]() {
+        buffer.findAll("value", SCFIND_MATCHCASE | SCFIND_WHOLEWORD);
+    });
+    runner.run("findAll.regex", [&]() {
+        buffer.findAll("[a-z]+_[0-9]+", SCFIND_REGEXP | SCFIND_CXX11REGEX);
+    });
+    runner.run("replaceAll", [&]() {
+        buffer.replaceAll("value", "result", SCFIND_MATCHCASE);
+    }, reset);
+
+    // Alternate between two values, so that every run changes something. The
+    // text is lexed too, which a window would do when it paints.
+    const Language *languages[] = {Language::fromLanguageId("cpp"), Language::fromLanguageId("python")};
+    int run = 0;
+    runner.run("setLanguage", [&]() {
+        buffer.setLanguage(languages[run++ % 2]);
+        buffer.colourise(0, -1);
+    });
+    const ColorScheme *colorSchemes[] = {ColorScheme::getColorScheme("Monokai"), ColorScheme::getColorScheme("Default")};
+    run = 0;
+    runner.run("setColorScheme", [&]() {
+        buffer.setColorScheme(colorSchemes[run++ % 2]);
+    });
+    run = 0;
+    runner.run("convertEOLs", [&]() {
+        buffer.convertEOLs(run++ % 2 ? SC_EOL_LF : SC_EOL_CRLF);
+    });
+    runner.run("upperCase", [&]() {
+        buffer.upperCase();
+    }, [&]() {
+        buffer.selectAll();
+    });
+    runner.run("lowerCase", [&]() {
+        buffer.lowerCase();
+    }, [&]() {
+        buffer.selectAll();
+    });
+}
+
+/**
+ * Times the search of a file that is not loaded into a buffer.
+ *
+ * @param runner The runner.
+ * @param fileName The file with the corpus.
+ */
+void benchmarkFileSearch(Runner &runner, const QString &fileName) {
+    runner.run("fileSearch.open", [&]() {
+        FileSearch(fileName).open();
+    });
+
+    FileSearch fileSearch(fileName);
+    if (!fileSearch.open()) {
+        fprintf(stderr, "Cannot map %s\n", qPrintable(fileName));
+        return;
+    }
+    TextSearch literal("needle", SCFIND_MATCHCASE);
+    TextSearch regex("[a-z]+_[0-9]+", SCFIND_REGEXP | SCFIND_CXX11REGEX);
+    runner.run("fileSearch.findNext", [&]() {
+        TextSearch::Match match;
+        fileSearch.findNext(literal, 0, &match);
+    });
+    runner.run("fileSearch.findPrevious", [&]() {
+        TextSearch::Match match;
+        fileSearch.findPrevious(regex, fileSearch.size() / 2, &match);
+    });
+    runner.run("fileSearch.findAll.regex", [&]() {
+        fileSearch.findAll(regex);
+    });
+}
+
+/**
+ * Times the parallel search with an increasing number of threads.
+ *
+ * @param runner The runner.
+ * @param corpus The searched text.
+ */
+void benchmarkParallelSearch(Runner &runner, const QByteArray &corpus) {
+    TextSearch search("[a-z]+_[0-9]+", SCFIND_REGEXP | SCFIND_CXX11REGEX);
+    for (int threads = 1; threads <= 16; threads *= 2) {
+        runner.run(QString("findAllParallel.threads%1").arg(threads), [&]() {
+            search.findAllParallel(corpus.constData(), corpus.size(), threads);
+        });
+    }
+}
+
+/**
+ * Times reading the settings of a buffer from the configuration snapshot,
+ * along with reading the same settings from QSettings, as each buffer did
+ * before the snapshot.
+ *
+ * @param runner The runner.
+ */
+void benchmarkConfiguration(Runner &runner) {
+    Configuration *config = Configuration::instance();
+    runner.run("configuration.snapshot", [&]() {
+        config->viewWhitespace();
+        config->viewIndentationWhitespace();
+        config->viewIndentationGuides();
+        config->caretLineVisible();
+        config->braceHighlight();
+        config->bracePairColorization();
+        config->indentationGuidesMode();
+        config->longLineIndicator();
+        config->longLineIndicatorLine();
+        config->longLineIndicatorColumn();
+        config->viewEndOfLine();
+        config->showLineMargin();
+        config->lineMarginWidth();
+        config->trackLineMarginWidth();
+        config->showIconMargin();
+        config->iconMarginWidth();
+        config->showFoldMargin();
+        config->foldMarginWidth();
+        config->foldSymbols();
+        config->foldLines();
+        config->wrap();
+        config->tabWidth();
+        config->indentationWidth();
+        config->useTabs();
+        config->scrollWidth();
+        config->scrollWidthTracking();
+        config->font();
+        config->colorScheme();
+    });
+
+    runner.run("configuration.qsettings", [&]() {
+        QSettings settings;
+        for (size_t i = 0; i < sizeof(BufferSettings) / sizeof(BufferSettings[0]); ++i) {
+            settings.value(BufferSettings[i]);
+        }
+    });
+}
+
+/**
+ * Times building editor windows, which read the configuration snapshot,
+ * along with building them while reading each of their settings from
+ * QSettings, as the configuration did before the snapshot.
+ *
+ * @param runner The runner.
+ */
+void benchmarkWindows(Runner &runner) {
+    QList<QScintillaEditor*> windows;
+    std::function<void()> reset = [&]() {
+        qDeleteAll(windows);
+        windows.clear();
+    };
+
+    runner.run(QString("windows.snapshot%1").arg(WindowCount), [&]() {
+        for (int i = 0; i < WindowCount; ++i) {
+            windows << new QScintillaEditor();
+        }
+    }, reset);
+    QSettings settings;
+    runner.run(QString("windows.qsettings%1").arg(WindowCount), [&]() {
+        for (int i = 0; i < WindowCount; ++i) {
+            for (size_t j = 0; j < sizeof(WindowSettings) / sizeof(WindowSettings[0]); ++j) {
+                settings.value(WindowSettings[j]);
+            }
+            for (size_t j = 0; j < sizeof(BufferSettings) / sizeof(BufferSettings[0]); ++j) {
+                settings.value(BufferSettings[j]);
+            }
+            windows << new QScintillaEditor();
+        }
+    }, reset);
+    reset();
+}
+
+/**
+ * Times switching the color scheme of many buffers.
+ *
+ * @param runner The runner.
+ * @param corpus The text of the buffers, only its start is used.
+ */
+void benchmarkSchemeSwitching(Runner &runner, const QByteArray &corpus) {
+    if (!runner.selected("schemeSwitching.buffers50")) {
+        return;
+    }
+
+    QList<Buffer*> buffers;
+    for (int i = 0; i < 50; ++i) {
+        Buffer *buffer = new Buffer();
+        buffer->setText(corpus.left(64 * 1024).constData());
+        buffer->setLanguage(Language::fromLanguageId("cpp"));
+        buffers << buffer;
+    }
+    const ColorScheme *colorSchemes[] = {ColorScheme::getColorScheme("Monokai"), ColorScheme::getColorScheme("Default")};
+    int run = 0;
+    runner.run("schemeSwitching.buffers50", [&]() {
+        const ColorScheme *colorScheme = colorSchemes[run++ % 2];
+        for (int i = 0; i < buffers.size(); ++i) {
+            buffers.at(i)->setColorScheme(colorScheme);
+        }
+    });
+    qDeleteAll(buffers);
+}
+
+/**
+ * Times looking up the language of file names, with the filename index and
+ * with the former implementation.
+ *
+ * @param runner The runner.
+ */
+void benchmarkLanguageLookup(Runner &runner) {
+    static const char *const extensions[] = {"cpp", "h", "java", "py", "txt", "hpp", "c", "md", "xml", "cc"};
+    QStringList fileNames;
+    for (int i = 0; i < 1000; ++i) {
+        fileNames << QString("file%1.%2").arg(i).arg(extensions[i % 10]);
+    }
+
+    runner.run("fromFilename.index", [&]() {
+        for (int i = 0; i < fileNames.size(); ++i) {
+            Language::fromFilename(fileNames.at(i));
+        }
+    });
+    runner.run("fromFilename.legacy", [&]() {
+        for (int i = 0; i < fileNames.size(); ++i) {
+            legacyFromFilename(fileNames.at(i));
+        }
+    });
+}
+
+}
+
+/**
+ * The benchmark entry point.
+ *
+ * @param argc The argument count.
+ * @param argv The arguments.
+ * @return The exit code.
+ */
+int main(int argc, char *argv[]) {
+    // The resources are in the core library, which is static
+    Q_INIT_RESOURCE(qtscitntillaeditor);
+
+    // No display is needed, the buffers are never shown
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    // Keep the settings of the editor out of the measurements
+    QApplication::setOrganizationName("qt-scintilla-editor-bench");
+    QApplication::setApplicationName("qt-scintilla-editor-bench");
+
+    Options options;
+    QApplication a(argc, argv);
+    if (!parseOptions(a.arguments(), options)) {
+        fprintf(stderr, "Usage: %s [--size <MB>] [--iterations <count>] [--filter <text>] [--output <file>]\n",
+                argv[0]);
+        return 1;
+    }
+
+    // The built-in definitions only, whatever the user has configured
+    QTemporaryDir dir;
+    setUserConfigDir(dir.path());
+    Runner runner(options);
+    benchmarkRegistries(runner);
+
+    QByteArray corpus = generateCorpus(options.size);
+    QString corpusFileName = dir.filePath("corpus.cpp");
+    QFile corpusFile(corpusFileName);
+    if (!corpusFile.open(QIODevice::WriteOnly) || corpusFile.write(corpus) != corpus.size()) {
+        fprintf(stderr, "Cannot write the corpus to %s\n", qPrintable(corpusFileName));
+        return 1;
+    }
+    corpusFile.close();
+
+    benchmarkBuffer(runner, corpus, corpusFileName, dir);
+    benchmarkFileSearch(runner, corpusFileName);
+    benchmarkParallelSearch(runner, corpus);
+    benchmarkConfiguration(runner);
+    benchmarkWindows(runner);
+    benchmarkSchemeSwitching(runner, corpus);
+    benchmarkLanguageLookup(runner);
+
+    QJsonObject report;
+    report.insert("corpusBytes", double(corpus.size()));
+    report.insert("iterations", options.iterations);
+    report.insert("qtVersion", QString(qVersion()));
+    report.insert("peakRssBytes", double(peakRss()));
+    report.insert("results", runner.results());
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (options.output.isEmpty()) {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    } else {
+        QFile file(options.output);
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+            fprintf(stderr, "Cannot write %s\n", qPrintable(options.output));
+            return 1;
+        }
+    }
+
+    cleanupRegistries();
+
+    return 0;
+}
@@ -0,0 +1,647 @@
+#include "encoding.h"
+#include "language.h"
+#include "util.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QRegExp>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextCodec>
+#include <QTextEncoder>
+
+#include <cstdio>
+
+/**
+ * Generates files to benchmark the editor with: code-like text in any of the
+ * languages, written in any of the encodings, with a chosen size, line length
+ * distribution and line endings, or one of the pathological cases. The same
+ * options and seed always give the same file.
+ *
+ * Usage: qt-scintilla-editor-corpusgen [options] <output>
+ */
+
+namespace {
+
+/** The size of the pending text written to the file at once, in bytes. */
+const int FlushSize = 1024 * 1024;
+
+/** The nesting levels that are indented, the deeper ones are not. */
+const int MaxIndentDepth = 32;
+
+/**
+ * The options of the command line.
+ */
+struct Options {
+    Options() : seed(1), size(8 * 1024 * 1024), minLineLength(0), maxLineLength(120), distribution("normal"),
+            eol("lf"), encoding("UTF-8"), language("cpp"), depth(10000) {
+    }
+
+    /** The seed of the generator. */
+    quint64 seed;
+
+    /** The size of the file, in bytes. */
+    qint64 size;
+
+    /** The shortest line, in characters, without its indentation. */
+    int minLineLength;
+
+    /** The longest line, in characters, without its indentation. */
+    int maxLineLength;
+
+    /** The distribution of the line lengths: uniform, normal or exponential. */
+    QString distribution;
+
+    /** The line endings: lf, crlf, cr or mixed. */
+    QString eol;
+
+    /** The name of the encoding, as in encodings.xml. */
+    QByteArray encoding;
+
+    /** The identifier of the language, as in languages.xml. */
+    QString language;
+
+    /** The pathological case, long-line, deep-nesting or mixed-eols, or empty for none. */
+    QString pathological;
+
+    /** The nesting depth of the deep-nesting case. */
+    int depth;
+
+    /** The name of the file to write. */
+    QString output;
+};
+
+/**
+ * A pseudo-random number generator, SplitMix64. Unlike the distributions of
+ * the standard library, it gives the same numbers on every platform.
+ */
+class Random {
+public:
+    /**
+     * Creates the generator.
+     *
+     * @param seed The seed.
+     */
+    explicit Random(quint64 seed) : m_state(seed) {
+    }
+
+    /**
+     * Returns the next number.
+     *
+     * @return The number.
+     */
+    quint64 next() {
+        quint64 z = (m_state += Q_UINT64_C(0x9e3779b97f4a7c15));
+        z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+
+        return z ^ (z >> 31);
+    }
+
+    /**
+     * Returns a number in a range.
+     *
+     * @param count The size of the range.
+     * @return A number from 0 to count - 1, 0 if count is not positive.
+     */
+    int below(int count) {
+        return count > 0 ? int(next() % quint64(count)) : 0;
+    }
+
+    /**
+     * Returns a number in a range, with a distribution.
+     *
+     * @param min The smallest number.
+     * @param max The largest number.
+     * @param distribution uniform, normal for a bell curve around the middle
+     * of the range, or exponential for mostly small numbers and a long tail.
+     * @return The number.
+     */
+    int between(int min, int max, const QString &distribution) {
+        int range = max - min + 1;
+        if (distribution == "normal") {
+            // The sum of uniform numbers, in integers so that it is exact
+            int sum = 0;
+            for (int i = 0; i < 4; ++i) {
+                sum += below(range);
+            }
+            return min + sum / 4;
+        } else if (distribution == "exponential") {
+            // Each doubling of the span is half as likely
+            int span = 1;
+            while (span < range && below(2)) {
+                span *= 2;
+            }
+            return min + below(qMin(span, range));
+        }
+
+        return min + below(range);
+    }
+
+private:
+    /** The state of the generator. */
+    quint64 m_state;
+};
+
+/**
+ * How the code of a lexer looks.
+ */
+struct Syntax {
+    /** The start of the line comments. */
+    const char *lineComment;
+
+    /** true if the blocks are delimited by braces, false if they are indented after a colon. */
+    bool braces;
+};
+
+/**
+ * Returns the syntax of the code of a lexer.
+ *
+ * @param lexer The lexer name.
+ * @return The syntax.
+ */
+Syntax syntaxForLexer(const QString &lexer) {
+    Syntax syntax;
+    if (lexer == "cpp") {
+        syntax.lineComment = "//";
+        syntax.braces = true;
+    } else if (lexer == "python") {
+        syntax.lineComment = "#";
+        syntax.braces = false;
+    } else {
+        syntax.lineComment = "#";
+        syntax.braces = true;
+    }
+
+    return syntax;
+}
+
+/**
+ * Writes the generated text to the output file, converted to the encoding.
+ */
+class Writer {
+public:
+    /**
+     * Creates the writer.
+     *
+     * @param file The output file, open for writing.
+     * @param codec The codec of the encoding.
+     */
+    Writer(QFile &file, QTextCodec *codec) : m_file(file), m_encoder(codec->makeEncoder()), m_written(0),
+            m_ok(true) {
+    }
+
+    /**
+     * Converts text and adds it to the output.
+     *
+     * @param text The text.
+     */
+    void write(const QString &text) {
+        m_pending += m_encoder->fromUnicode(text);
+        if (m_pending.size() >= FlushSize) {
+            flush();
+        }
+    }
+
+    /**
+     * Writes the pending text to the file.
+     */
+    void flush() {
+        if (m_file.write(m_pending) != m_pending.size()) {
+            m_ok = false;
+        }
+        m_written += m_pending.size();
+        m_pending.clear();
+    }
+
+    /**
+     * Returns the bytes of the output so far.
+     *
+     * @return The bytes of the output.
+     */
+    qint64 size() const {
+        return m_written + m_pending.size();
+    }
+
+    /**
+     * Returns false if the file could not be written.
+     *
+     * @return true if all the output has been written.
+     */
+    bool ok() const {
+        return m_ok;
+    }
+
+private:
+    /** The output file. */
+    QFile &m_file;
+
+    /** Converts the text to the encoding. */
+    QScopedPointer<QTextEncoder> m_encoder;
+
+    /** The converted text not yet written. */
+    QByteArray m_pending;
+
+    /** The bytes written to the file. */
+    qint64 m_written;
+
+    /** false if a write has failed. */
+    bool m_ok;
+};
+
+/**
+ * Generates the code.
+ */
+class Generator {
+public:
+    /**
+     * Creates the generator.
+     *
+     * @param options The options of the command line.
+     * @param language The language of the code.
+     * @param codec The codec of the encoding, which decides the characters
+     * used besides ASCII.
+     */
+    Generator(const Options &options, const Language *language, QTextCodec *codec) :
+            m_options(options), m_random(options.seed), m_syntax(syntaxForLexer(language->lexer())),
+            m_depth(0) {
+        QStringList keywordSets = language->keywords();
+        if (!keywordSets.isEmpty()) {
+            m_keywords = keywordSets.first().split(QRegExp("\\s+"), QString::SkipEmptyParts);
+        }
+        if (m_keywords.isEmpty()) {
+            m_keywords << "if" << "else" << "return" << "while";
+        }
+
+        // Accents, Greek, Cyrillic, Hebrew, Arabic, Devanagari, Thai, kana and ideographs
+        static const ushort ranges[][2] = {
+            {0x00c0, 0x00ff}, {0x0391, 0x03c9}, {0x0410, 0x044f}, {0x05d0, 0x05ea}, {0x0627, 0x064a},
+            {0x0905, 0x0939}, {0x0e01, 0x0e2e}, {0x3041, 0x3093}, {0x4e00, 0x4e80}
+        };
+        for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); ++i) {
+            for (ushort c = ranges[i][0]; c <= ranges[i][1]; ++c) {
+                if (codec->canEncode(QChar(c))) {
+                    m_letters += QChar(c);
+                }
+            }
+        }
+    }
+
+    /**
+     * Writes the text.
+     *
+     * @param writer The writer.
+     */
+    void generate(Writer &writer) {
+        if (m_options.pathological == "long-line") {
+            generateLongLine(writer);
+        } else if (m_options.pathological == "deep-nesting") {
+            generateDeepNesting(writer);
+        } else {
+            generateCode(writer);
+        }
+    }
+
+private:
+    /**
+     * Writes lines of code, with comments and nested blocks.
+     */
+    void generateCode(Writer &writer) {
+        while (writer.size() < m_options.size) {
+            int kind = m_random.below(100);
+            QString line;
+            if (kind < 10) {
+                line = indent() + m_syntax.lineComment + ' ' + words(lineLength());
+            } else if (kind < 18 && m_depth < MaxIndentDepth) {
+                line = indent() + m_keywords.at(m_random.below(m_keywords.size())) + ' ' + statement(lineLength() / 2) +
+                        (m_syntax.braces ? " {" : ":");
+                ++m_depth;
+            } else if (kind < 26 && m_depth > 0) {
+                --m_depth;
+                if (!m_syntax.braces) {
+                    // Dedenting the next line closes the block
+                    continue;
+                }
+                line = indent() + '}';
+            } else if (kind < 28) {
+                line = QString();
+            } else {
+                line = indent() + statement(lineLength()) + (m_syntax.braces ? ";" : "");
+            }
+            writer.write(line + eol());
+        }
+        closeBlocks(writer);
+    }
+
+    /**
+     * Writes statements on a single line, without any line ending.
+     */
+    void generateLongLine(Writer &writer) {
+        while (writer.size() < m_options.size) {
+            writer.write(statement(4096) + (m_syntax.braces ? "; " : " "));
+        }
+    }
+
+    /**
+     * Writes nests of brackets, one opening bracket per line, as deep as the
+     * depth option.
+     */
+    void generateDeepNesting(Writer &writer) {
+        static const char *const openers = "({[";
+        static const char *const closers = ")}]";
+        while (writer.size() < m_options.size) {
+            for (m_depth = 0; m_depth < m_options.depth; ++m_depth) {
+                int bracket = m_depth % 3;
+                writer.write(indent() + identifier() + ' ' + openers[bracket] + eol());
+            }
+            while (m_depth > 0) {
+                --m_depth;
+                writer.write(indent() + closers[m_depth % 3] + eol());
+            }
+        }
+    }
+
+    /**
+     * Writes the closing braces of the open blocks.
+     */
+    void closeBlocks(Writer &writer) {
+        while (m_syntax.braces && m_depth > 0) {
+            --m_depth;
+            writer.write(indent() + '}' + eol());
+        }
+    }
+
+    /**
+     * Returns the indentation of the current nesting depth.
+     */
+    QString indent() const {
+        return QString(4 * qMin(m_depth, MaxIndentDepth), ' ');
+    }
+
+    /**
+     * Returns the length of the next line, from the distribution.
+     */
+    int lineLength() {
+        return m_random.between(m_options.minLineLength, m_options.maxLineLength, m_options.distribution);
+    }
+
+    /**
+     * Returns the next line ending.
+     */
+    QString eol() {
+        QString eol = m_options.eol;
+        if (eol == "mixed") {
+            static const char *const eols[] = {"lf", "crlf", "cr"};
+            eol = eols[m_random.below(3)];
+        }
+        if (eol == "crlf") {
+            return "\r\n";
+        } else if (eol == "cr") {
+            return "\r";
+        }
+
+        return "\n";
+    }
+
+    /**
+     * Returns an identifier.
+     */
+    QString identifier() {
+        static const char *const names[] = {"value", "count", "index", "buffer", "result", "length", "offset", "node"};
+
+        return QString("%1_%2").arg(names[m_random.below(8)]).arg(m_random.below(1000));
+    }
+
+    /**
+     * Returns a word of comments and strings, in the characters of the
+     * encoding besides ASCII now and then.
+     */
+    QString word() {
+        if (m_letters.isEmpty() || m_random.below(4)) {
+            return identifier();
+        }
+        QString word;
+        for (int length = 2 + m_random.below(6); length > 0; --length) {
+            word += m_letters.at(m_random.below(m_letters.size()));
+        }
+
+        return word;
+    }
+
+    /**
+     * Returns the words of a comment.
+     *
+     * @param length The length of the comment, it is exceeded by a word at most.
+     */
+    QString words(int length) {
+        QString text = word();
+        while (text.size() < length) {
+            text += ' ' + word();
+        }
+
+        return text;
+    }
+
+    /**
+     * Returns a statement, made of keywords, identifiers, numbers, operators
+     * and string literals.
+     *
+     * @param length The length of the statement, it is exceeded by a token at most.
+     */
+    QString statement(int length) {
+        static const char *const operators[] = {" = ", " + ", " - ", " * ", " / ", " < ", " == ", " && ", ", "};
+        QString text = identifier();
+        while (text.size() < length) {
+            text += operators[m_random.below(9)];
+            switch (m_random.below(5)) {
+            case 0:
+                text += m_keywords.at(m_random.below(m_keywords.size()));
+                break;
+            case 1:
+                text += QString::number(m_random.below(100000));
+                break;
+            case 2:
+                text += '"' + words(m_random.below(24)) + '"';
+                break;
+            case 3:
+                text += "call(" + identifier() + ')';
+                break;
+            default:
+                text += identifier();
+                break;
+            }
+        }
+
+        return text;
+    }
+
+    /** The options of the command line. */
+    Options m_options;
+
+    /** The generator of the choices. */
+    Random m_random;
+
+    /** How the code looks. */
+    Syntax m_syntax;
+
+    /** The keywords of the language. */
+    QStringList m_keywords;
+
+    /** The letters besides ASCII that the encoding can represent. */
+    QString m_letters;
+
+    /** The current nesting depth. */
+    int m_depth;
+};
+
+/**
+ * Prints the usage, with the available languages and encodings.
+ *
+ * @param program The name of the program.
+ */
+void printUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [options] <output>\n"
+            "  --seed <number>             The seed, 1 by default\n"
+            "  --size <MB>                 The size of the file, 8 by default\n"
+            "  --line-length <min>,<max>   The length of the lines, 0,120 by default\n"
+            "  --distribution <name>       uniform, normal (default) or exponential\n"
+            "  --eol <name>                lf (default), crlf, cr or mixed\n"
+            "  --encoding <name>           UTF-8 by default\n"
+            "  --language <id>             cpp by default\n"
+            "  --pathological <name>       long-line, deep-nesting or mixed-eols\n"
+            "  --depth <number>            The depth of deep-nesting, 10000 by default\n", program);
+
+    QStringList languages;
+    QListIterator<Language*> languageIterator = Language::allLanguages();
+    while (languageIterator.hasNext()) {
+        languages << languageIterator.next()->langId();
+    }
+    fprintf(stderr, "Languages: %s\n", qPrintable(languages.join(' ')));
+
+    QStringList encodings;
+    QListIterator<Encoding*> encodingIterator = Encoding::allEncodings();
+    while (encodingIterator.hasNext()) {
+        encodings << '"' + QString::fromLatin1(encodingIterator.next()->name()) + '"';
+    }
+    fprintf(stderr, "Encodings: %s\n", qPrintable(encodings.join(' ')));
+}
+
+/**
+ * Reads the options of the command line.
+ *
+ * @param arguments The arguments.
+ * @param options Output parameter, the options.
+ * @return true if the arguments are valid.
+ */
+bool parseOptions(const QStringList &arguments, Options &options) {
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString &argument = arguments.at(i);
+        if (!argument.startsWith("--")) {
+            if (!options.output.isEmpty()) {
+                return false;
+            }
+            options.output = argument;
+            continue;
+        }
+        if (i + 1 == arguments.size()) {
+            return false;
+        }
+        QString value = arguments.at(++i);
+        bool ok = true;
+        if (argument == "--seed") {
+            options.seed = value.toULongLong(&ok);
+        } else if (argument == "--size") {
+            options.size = qint64(value.toDouble(&ok) * 1024 * 1024);
+        } else if (argument == "--line-length") {
+            QStringList range = value.split(',');
+            bool maxOk = false;
+            options.minLineLength = range.first().toInt(&ok);
+            options.maxLineLength = range.last().toInt(&maxOk);
+            ok = ok && maxOk && range.size() == 2 && options.minLineLength >= 0 &&
+                    options.minLineLength <= options.maxLineLength;
+        } else if (argument == "--distribution") {
+            options.distribution = value;
+            ok = value == "uniform" || value == "normal" || value == "exponential";
+        } else if (argument == "--eol") {
+            options.eol = value;
+            ok = value == "lf" || value == "crlf" || value == "cr" || value == "mixed";
+        } else if (argument == "--encoding") {
+            options.encoding = value.toLatin1();
+        } else if (argument == "--language") {
+            options.language = value;
+        } else if (argument == "--pathological") {
+            options.pathological = value;
+            ok = value == "long-line" || value == "deep-nesting" || value == "mixed-eols";
+        } else if (argument == "--depth") {
+            options.depth = value.toInt(&ok);
+            ok = ok && options.depth > 0;
+        } else {
+            return false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    if (options.pathological == "long-line" && !arguments.contains("--size")) {
+        options.size = 100 * 1024 * 1024;
+    } else if (options.pathological == "mixed-eols") {
+        options.eol = "mixed";
+    }
+
+    return !options.output.isEmpty() && options.size > 0;
+}
+
+}
+
+/**
+ * The generator entry point.
+ *
+ * @param argc The argument count.
+ * @param argv The arguments.
+ * @return The exit code.
+ */
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+
+    // The built-in definitions only, whatever the user has configured
+    QTemporaryDir dir;
+    setUserConfigDir(dir.path());
+
+    Options options;
+    if (!parseOptions(a.arguments(), options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const Language *language = Language::fromLanguageId(options.language);
+    if (!language) {
+        fprintf(stderr, "Unknown language %s\n", qPrintable(options.language));
+        printUsage(argv[0]);
+        return 1;
+    }
+    const Encoding *encoding = Encoding::fromName(options.encoding);
+    QTextCodec *codec = encoding ? QTextCodec::codecForName(encoding->name()) : 0;
+    if (!codec) {
+        fprintf(stderr, "Unknown encoding %s\n", options.encoding.constData());
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    QFile file(options.output);
+    if (!file.open(QIODevice::WriteOnly)) {
+        fprintf(stderr, "Cannot write %s\n", qPrintable(options.output));
+        return 1;
+    }
+    Writer writer(file, codec);
+    Generator(options, language, codec).generate(writer);
+    writer.flush();
+    if (!writer.ok()) {
+        fprintf(stderr, "Cannot write %s\n", qPrintable(options.output));
+        return 1;
+    }
+
+    Encoding::cleanup();
+    Language::cleanup();
+
+    return 0;
+}
@@ -0,0 +1,456 @@
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QXmlStreamReader>
+
+#include <cstdio>
+
+/**
+ * Compiles the XML definitions of the languages, encodings and color schemes
+ * into the C++ tables declared in builtintables.h.
+ *
+ * Usage: tablegen <output> <languages.xml> <encodings.xml> <colorscheme.xml>...
+ */
+
+namespace {
+
+/**
+ * A style of a language.
+ */
+struct StyleDescription {
+    int style;
+    QString description;
+    bool commentOrString;
+};
+
+/**
+ * A language.
+ */
+struct Language {
+    QString id;
+    QString name;
+    QString lexer;
+    QString patterns;
+    QString interpreters;
+    QStringList keywords;
+    QList<StyleDescription> styles;
+};
+
+/**
+ * The style information of a color scheme.
+ */
+struct Style {
+    Style() : foreground(-1), background(-1), bold(false), italic(false), underline(false), eolFilled(false) {
+    }
+
+    int foreground;
+    int background;
+    bool bold;
+    bool italic;
+    bool underline;
+    bool eolFilled;
+};
+
+/**
+ * A color scheme.
+ */
+struct ColorScheme {
+    ColorScheme() : foreground(-1), background(-1), caret(-1), caretLine(-1), selection(-1), whitespace(-1) {
+    }
+
+    QString name;
+    int foreground;
+    int background;
+    int caret;
+    int caretLine;
+    int selection;
+    int whitespace;
+    QList<int> bracePairColors;
+    QMap<QString, QMap<int, Style> > languages;
+};
+
+/**
+ * Converts a hexademical representation of a color to the color format
+ * understood by Scintilla, the same way as convertColor() does at runtime.
+ */
+int convertColor(const QString& colorStr) {
+    bool ok;
+    uint color = colorStr.right(6).toUInt(&ok, 16);
+    if (ok) {
+        return ((color << 16) & 0xFF0000) | (color & 0x00FF00) | ((color >> 16) & 0x0000FF);
+    } else {
+        return -1;
+    }
+}
+
+/**
+ * Returns a C++ string literal for a string, encoded in UTF-8.
+ */
+QString literal(const QString &string) {
+    QByteArray utf8 = string.toUtf8();
+    QString result("\"");
+    for (int i = 0; i < utf8.size(); ++i) {
+        uchar c = utf8.at(i);
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += QChar(c);
+        } else if (c < 0x20 || c >= 0x7F || c == '?') {
+            // Octal escapes cannot swallow the following characters, and
+            // question marks cannot form trigraphs
+            result += QString("\\%1").arg(c, 3, 8, QChar('0'));
+        } else {
+            result += QChar(c);
+        }
+    }
+    result += '"';
+
+    return result;
+}
+
+/**
+ * Returns a C++ boolean literal.
+ */
+QString boolean(bool value) {
+    return value ? "true" : "false";
+}
+
+/**
+ * Opens an XML file, printing an error if it cannot be opened.
+ */
+bool openFile(QFile &file) {
+    if (!file.open(QFile::ReadOnly | QIODevice::Text)) {
+        fprintf(stderr, "Cannot open %s\n", qPrintable(file.fileName()));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Prints the error of an XML file, if there is one.
+ */
+bool checkError(const QXmlStreamReader &xml, const QFile &file) {
+    if (xml.hasError()) {
+        fprintf(stderr, "%s:%lld: %s\n", qPrintable(file.fileName()), xml.lineNumber(),
+                qPrintable(xml.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Writes the table of the encodings.
+ */
+bool writeEncodings(const QString &fileName, QTextStream &out) {
+    QFile file(fileName);
+    if (!openFile(file)) {
+        return false;
+    }
+
+    out << "constexpr EncodingEntry encodings[] = {\n";
+    QXmlStreamReader xml(&file);
+    int category = 0;
+    while (!xml.atEnd() && !xml.hasError()) {
+        if (xml.readNext() == QXmlStreamReader::StartElement) {
+            QXmlStreamAttributes attrs = xml.attributes();
+            if (xml.name() == "category") {
+                category = attrs.value("id").toString().toInt();
+            } else if (xml.name() == "encoding") {
+                out << "    { " << literal(attrs.value("language").toString()) << ", "
+                    << literal(attrs.value("displayName").toString()) << ", "
+                    << literal(attrs.value("name").toString()) << ", " << category << " },\n";
+            }
+        }
+    }
+    out << "};\n\n";
+    out << "constexpr int encodingCount = sizeof(encodings) / sizeof(encodings[0]);\n\n";
+
+    return checkError(xml, file);
+}
+
+/**
+ * Reads the languages.
+ */
+bool readLanguages(const QString &fileName, QList<Language> &languages) {
+    QFile file(fileName);
+    if (!openFile(file)) {
+        return false;
+    }
+
+    QXmlStreamReader xml(&file);
+    while (!xml.atEnd() && !xml.hasError()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        QXmlStreamAttributes attrs = xml.attributes();
+        if (xml.name() == "language") {
+            Language language;
+            language.id = attrs.value("id").toString();
+            language.name = attrs.value("name").toString();
+            language.lexer = attrs.value("lexer").toString();
+            languages << language;
+        } else if (languages.isEmpty()) {
+            continue;
+        } else if (xml.name() == "patterns") {
+            languages.last().patterns = xml.readElementText(QXmlStreamReader::ErrorOnUnexpectedElement);
+        } else if (xml.name() == "interpreters") {
+            languages.last().interpreters =
+                    xml.readElementText(QXmlStreamReader::ErrorOnUnexpectedElement).simplified();
+        } else if (xml.name() == "keywordSet") {
+            QStringList &keywords = languages.last().keywords;
+            int id = attrs.value("id").toString().toInt();
+            while (keywords.size() <= id) {
+                keywords << QString();
+            }
+            keywords[id] = xml.readElementText(QXmlStreamReader::ErrorOnUnexpectedElement).simplified();
+        } else if (xml.name() == "styleDescription") {
+            QStringRef type = attrs.value("type");
+            StyleDescription style = { attrs.value("style").toString().toInt(),
+                    attrs.value("description").toString(), type == "comment" || type == "string" };
+            languages.last().styles << style;
+        }
+    }
+
+    return checkError(xml, file);
+}
+
+/**
+ * Writes the table of the languages.
+ */
+void writeLanguages(const QList<Language> &languages, QTextStream &helpers, QTextStream &out) {
+    for (int i = 0; i < languages.size(); ++i) {
+        const Language &language = languages.at(i);
+        if (!language.keywords.isEmpty()) {
+            helpers << "constexpr const char *keywords" << i << "[] = {\n";
+            for (int j = 0; j < language.keywords.size(); ++j) {
+                helpers << "    " << literal(language.keywords.at(j)) << ",\n";
+            }
+            helpers << "};\n\n";
+        }
+        if (!language.styles.isEmpty()) {
+            helpers << "constexpr StyleDescriptionEntry styleDescriptions" << i << "[] = {\n";
+            for (int j = 0; j < language.styles.size(); ++j) {
+                const StyleDescription &style = language.styles.at(j);
+                helpers << "    { " << style.style << ", " << literal(style.description) << ", "
+                    << boolean(style.commentOrString) << " },\n";
+            }
+            helpers << "};\n\n";
+        }
+    }
+
+    out << "constexpr LanguageEntry languages[] = {\n";
+    for (int i = 0; i < languages.size(); ++i) {
+        const Language &language = languages.at(i);
+        out << "    { " << literal(language.id) << ", " << literal(language.name) << ", "
+            << literal(language.lexer) << ", " << literal(language.patterns) << ", "
+            << literal(language.interpreters) << ",\n";
+        if (language.keywords.isEmpty()) {
+            out << "      nullptr, 0, ";
+        } else {
+            out << "      keywords" << i << ", " << language.keywords.size() << ", ";
+        }
+        if (language.styles.isEmpty()) {
+            out << "nullptr, 0 },\n";
+        } else {
+            out << "styleDescriptions" << i << ", " << language.styles.size() << " },\n";
+        }
+    }
+    out << "};\n\n";
+    out << "constexpr int languageCount = sizeof(languages) / sizeof(languages[0]);\n\n";
+}
+
+/**
+ * Reads a color scheme, resolving the style references.
+ */
+bool readColorScheme(const QString &fileName, ColorScheme &colorScheme) {
+    QFile file(fileName);
+    if (!openFile(file)) {
+        return false;
+    }
+
+    QXmlStreamReader xml(&file);
+    QMap<QString, Style> definedStyles;
+    QString langId;
+    while (!xml.atEnd() && !xml.hasError()) {
+        if (xml.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+        QXmlStreamAttributes attrs = xml.attributes();
+        if (xml.name() == "colorscheme") {
+            colorScheme.name = attrs.value("name").toString();
+        } else if (xml.name() == "color") {
+            QString type = attrs.value("type").toString();
+            int color = convertColor(xml.readElementText(QXmlStreamReader::ErrorOnUnexpectedElement));
+            if (type == "foreground") {
+                colorScheme.foreground = color;
+            } else if (type == "background") {
+                colorScheme.background = color;
+            } else if (type == "caret") {
+                colorScheme.caret = color;
+            } else if (type == "caretLine") {
+                colorScheme.caretLine = color;
+            } else if (type == "selection") {
+                colorScheme.selection = color;
+            } else if (type == "whitespace") {
+                colorScheme.whitespace = color;
+            } else if (type == "bracePair") {
+                colorScheme.bracePairColors << color;
+            }
+        } else if (xml.name() == "style") {
+            Style style;
+            if (attrs.hasAttribute("foreground")) {
+                style.foreground = convertColor(attrs.value("foreground").toString());
+            }
+            if (attrs.hasAttribute("background")) {
+                style.background = convertColor(attrs.value("background").toString());
+            }
+            style.bold = attrs.value("bold") == "true";
+            style.italic = attrs.value("italic") == "true";
+            style.underline = attrs.value("underline") == "true";
+            style.eolFilled = attrs.value("eolFilled") == "true";
+            definedStyles[attrs.value("name").toString()] = style;
+        } else if (xml.name() == "language") {
+            langId = attrs.value("id").toString();
+            colorScheme.languages[langId];
+        } else if (xml.name() == "styleInfo") {
+            bool ok;
+            int id = attrs.value("id").toString().toInt(&ok);
+            if (ok && attrs.hasAttribute("styleRef")) {
+                colorScheme.languages[langId][id] = definedStyles.value(attrs.value("styleRef").toString());
+            }
+        }
+    }
+
+    return checkError(xml, file);
+}
+
+/**
+ * Writes the table of the color schemes.
+ */
+void writeColorSchemes(const QList<ColorScheme> &colorSchemes, QTextStream &helpers, QTextStream &out) {
+    for (int i = 0; i < colorSchemes.size(); ++i) {
+        const ColorScheme &colorScheme = colorSchemes.at(i);
+        if (!colorScheme.bracePairColors.isEmpty()) {
+            helpers << "constexpr int bracePairColors" << i << "[] = {";
+            for (int j = 0; j < colorScheme.bracePairColors.size(); ++j) {
+                helpers << (j == 0 ? " " : ", ") << colorScheme.bracePairColors.at(j);
+            }
+            helpers << " };\n\n";
+        }
+        int languageIndex = 0;
+        for (QMap<QString, QMap<int, Style> >::const_iterator language = colorScheme.languages.constBegin();
+                language != colorScheme.languages.constEnd(); ++language, ++languageIndex) {
+            if (language.value().isEmpty()) {
+                continue;
+            }
+            helpers << "constexpr StyleEntry styles" << i << "_" << languageIndex << "[] = {\n";
+            for (QMap<int, Style>::const_iterator style = language.value().constBegin();
+                    style != language.value().constEnd(); ++style) {
+                helpers << "    { " << style.key() << ", " << style.value().foreground << ", "
+                    << style.value().background << ", " << boolean(style.value().bold) << ", "
+                    << boolean(style.value().italic) << ", " << boolean(style.value().underline) << ", "
+                    << boolean(style.value().eolFilled) << " },\n";
+            }
+            helpers << "};\n\n";
+        }
+        if (!colorScheme.languages.isEmpty()) {
+            helpers << "constexpr LanguageStylesEntry languageStyles" << i << "[] = {\n";
+            languageIndex = 0;
+            for (QMap<QString, QMap<int, Style> >::const_iterator language = colorScheme.languages.constBegin();
+                    language != colorScheme.languages.constEnd(); ++language, ++languageIndex) {
+                helpers << "    { " << literal(language.key()) << ", ";
+                if (language.value().isEmpty()) {
+                    helpers << "nullptr, 0 },\n";
+                } else {
+                    helpers << "styles" << i << "_" << languageIndex << ", " << language.value().size() << " },\n";
+                }
+            }
+            helpers << "};\n\n";
+        }
+    }
+
+    out << "constexpr ColorSchemeEntry colorSchemes[] = {\n";
+    for (int i = 0; i < colorSchemes.size(); ++i) {
+        const ColorScheme &colorScheme = colorSchemes.at(i);
+        out << "    { " << literal(colorScheme.name) << ", " << colorScheme.foreground << ", "
+            << colorScheme.background << ", " << colorScheme.caret << ", " << colorScheme.caretLine << ", "
+            << colorScheme.selection << ", " << colorScheme.whitespace << ",\n      ";
+        if (colorScheme.bracePairColors.isEmpty()) {
+            out << "nullptr, 0, ";
+        } else {
+            out << "bracePairColors" << i << ", " << colorScheme.bracePairColors.size() << ", ";
+        }
+        if (colorScheme.languages.isEmpty()) {
+            out << "nullptr, 0 },\n";
+        } else {
+            out << "languageStyles" << i << ", " << colorScheme.languages.size() << " },\n";
+        }
+    }
+    out << "};\n\n";
+    out << "constexpr int colorSchemeCount = sizeof(colorSchemes) / sizeof(colorSchemes[0]);\n\n";
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <output> <languages.xml> <encodings.xml> <colorscheme.xml>...\n", argv[0]);
+        return 1;
+    }
+
+    QList<Language> languages;
+    if (!readLanguages(QString::fromLocal8Bit(argv[2]), languages)) {
+        return 1;
+    }
+    QList<ColorScheme> colorSchemes;
+    for (int i = 4; i < argc; ++i) {
+        ColorScheme colorScheme;
+        if (!readColorScheme(QString::fromLocal8Bit(argv[i]), colorScheme)) {
+            return 1;
+        }
+        colorSchemes << colorScheme;
+    }
+
+    // The arrays referenced by the tables are private to the generated file
+    QString helperOutput;
+    QString tableOutput;
+    QTextStream helpers(&helperOutput);
+    QTextStream tables(&tableOutput);
+    writeLanguages(languages, helpers, tables);
+    writeColorSchemes(colorSchemes, helpers, tables);
+    if (!writeEncodings(QString::fromLocal8Bit(argv[3]), tables)) {
+        return 1;
+    }
+    helpers.flush();
+    tables.flush();
+
+    QString output;
+    QTextStream out(&output);
+    out << "// Generated by tablegen from the XML definitions, do not edit.\n\n";
+    out << "#include \"builtintables.h\"\n\n";
+    out << "namespace BuiltinTables {\n\n";
+    out << "namespace {\n\n";
+    out << helperOutput;
+    out << "}\n\n";
+    out << tableOutput;
+    out << "}\n";
+    out.flush();
+
+    // Write the output only if it has changed, in order to avoid rebuilding
+    QFile file(QString::fromLocal8Bit(argv[1]));
+    QByteArray content = output.toUtf8();
+    if (file.open(QFile::ReadOnly) && file.readAll() == content) {
+        return 0;
+    }
+    file.close();
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(content) != content.size()) {
+        fprintf(stderr, "Cannot write %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}